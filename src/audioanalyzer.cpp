@@ -0,0 +1,194 @@
+#include "audioanalyzer.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "jobsystem.h"
+#include "waveform.h"
+
+AudioAnalyzer::AudioAnalyzer()
+{
+}
+
+AudioAnalyzer::~AudioAnalyzer()
+{
+	Stop();
+
+	// load jobs point back at the analyzer
+	if (currentJob) currentJob->bCancelled = true;
+	std::unique_lock<std::mutex> lock(loadMutex);
+	loadCondition.wait(lock, [this] { return loadsInFlight == 0; });
+}
+
+void AudioAnalyzer::Start(unsigned threadCount)
+{
+	if (bRunning && !progress.bDone)
+	{
+		bRestart = true;
+		return;
+	}
+
+	// the previous batch finished, only its thread is left
+	Stop();
+
+	bRunning = true;
+	bCancel = false;
+	bRestart = true;
+	progress.filesQueued = 0;
+	progress.filesAnalyzed = 0;
+	progress.filesFailed = 0;
+	progress.bDone = false;
+	analyzedMilliseconds = 0;
+
+	// decoding is all cpu, leave the other half to the ui and the shared pool
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+	jobs = std::make_unique<JobSystem>(threadCount);
+	batchThread = std::thread(&AudioAnalyzer::BatchLoop, this);
+}
+
+void AudioAnalyzer::Stop()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bCancel = true;
+	batchThread.join();
+	jobs.reset();
+	bRunning = false;
+}
+
+void AudioAnalyzer::BatchLoop()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// files committed while a batch runs are picked up by another query
+	while (bRestart.exchange(false) && !bCancel)
+	{
+		const std::vector<db::AnalysisTarget> targets = db::GetFilesWithoutWaveform();
+		progress.filesQueued += (int)targets.size();
+
+		for (const db::AnalysisTarget& target : targets)
+		{
+			jobs->Submit([this, target] { AnalyzeTarget(target); });
+		}
+		jobs->WaitIdle();
+	}
+
+	const int analyzed = progress.filesAnalyzed.load();
+	if (analyzed > 0)
+	{
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const double audioSeconds = analyzedMilliseconds.load() / 1000.0;
+		printf("[analyzer]: %d files, %.1f min of audio in %.2f s (%.0fx realtime), %d failed\n",
+			analyzed, audioSeconds / 60.0, seconds, seconds > 0.0 ? audioSeconds / seconds : 0.0, progress.filesFailed.load());
+	}
+
+	progress.bDone = true;
+}
+
+void AudioAnalyzer::AnalyzeTarget(const db::AnalysisTarget& target)
+{
+	if (bCancel)
+	{
+		return;
+	}
+
+	db::Waveform waveform;
+	std::vector<float> fingerprint;
+	if (AnalyzeAudioFile(target.path, &bCancel, waveform, &fingerprint))
+	{
+		if (waveform.sampleRate > 0)
+		{
+			analyzedMilliseconds += waveform.lengthFrames * 1000 / waveform.sampleRate;
+		}
+	}
+	else if (bCancel)
+	{
+		return;
+	}
+	else
+	{
+		// stored without levels, so it isn't retried until the file changes
+		printf("[analyzer]: failed to decode [%s]\n", target.path.c_str());
+		progress.filesFailed++;
+	}
+
+	db::PutWaveform(target.id, target.mtime, waveform);
+	db::PutAudioFingerprint(target.id, target.mtime, fingerprint);
+	bDirty = true;
+	progress.filesAnalyzed++;
+}
+
+const db::Waveform* AudioAnalyzer::Request(int fileId, int64_t mtime, const std::string& path)
+{
+	if (currentJob && currentJob->fileId == fileId && currentJob->mtime == mtime)
+	{
+		return bHasWaveform ? &currentWaveform : nullptr;
+	}
+
+	if (currentJob) currentJob->bCancelled = true;
+	bHasWaveform = false;
+
+	currentJob = std::make_shared<RequestJob>();
+	currentJob->fileId = fileId;
+	currentJob->mtime = mtime;
+	currentJob->path = path;
+
+	{
+		std::lock_guard<std::mutex> lock(loadMutex);
+		loadsInFlight++;
+	}
+	std::shared_ptr<RequestJob> job = currentJob;
+	JobSystem::GetShared().Submit([this, job]() { Load(job); });
+
+	return nullptr;
+}
+
+void AudioAnalyzer::Load(std::shared_ptr<RequestJob> job)
+{
+	// usually already analyzed by a batch, then it's a single row read
+	if (!job->bCancelled && !db::GetWaveform(job->fileId, job->mtime, job->waveform))
+	{
+		std::vector<float> fingerprint;
+		if (AnalyzeAudioFile(job->path, &job->bCancelled, job->waveform, &fingerprint) || !job->bCancelled)
+		{
+			db::PutWaveform(job->fileId, job->mtime, job->waveform);
+			db::PutAudioFingerprint(job->fileId, job->mtime, fingerprint);
+			bDirty = true;
+		}
+	}
+
+	if (!job->bCancelled)
+	{
+		loadedQueue.Push(job);
+	}
+
+	// notify under the lock, the analyzer may be destroyed as soon as the count hits zero
+	std::lock_guard<std::mutex> lock(loadMutex);
+	loadsInFlight--;
+	loadCondition.notify_all();
+}
+
+void AudioAnalyzer::Update()
+{
+	// a restart that came in while the last batch was wrapping up
+	if (bRunning && progress.bDone && bRestart)
+	{
+		Start();
+	}
+
+	std::vector<std::shared_ptr<RequestJob>> loaded;
+	loadedQueue.PopAll(loaded);
+	for (auto& job : loaded)
+	{
+		if (job == currentJob)
+		{
+			currentWaveform = std::move(job->waveform);
+			bHasWaveform = true;
+		}
+	}
+}
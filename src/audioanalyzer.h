@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#include "db.h"
+#include "mpscqueue.h"
+
+class JobSystem;
+
+struct AnalysisProgress
+{
+	std::atomic<int> filesQueued{ 0 };
+	std::atomic<int> filesAnalyzed{ 0 };
+	std::atomic<int> filesFailed{ 0 };
+	std::atomic<bool> bDone{ true };
+};
+
+// decodes every audio file once in the background and stores its db::Waveform (peak pyramid,
+// duration and loudness) and its fingerprint for the file's mtime. a batch picks up every audio file whose waveform
+// is missing or stale, on a pool half the size of the machine so browsing stays responsive.
+// the selected sound doesn't wait for the batch: Request() loads or analyzes it on the shared
+// job system and Update() publishes it.
+class AudioAnalyzer
+{
+public:
+	AudioAnalyzer();
+	~AudioAnalyzer();
+
+	AudioAnalyzer(const AudioAnalyzer&) = delete;
+	AudioAnalyzer& operator=(const AudioAnalyzer&) = delete;
+
+	// starts a batch. if one is running it queries for new files again once it is done.
+	// threadCount 0 -> half the machine
+	void Start(unsigned threadCount = 0);
+
+	// cancels the running batch, files analyzed so far are kept
+	void Stop();
+
+	const AnalysisProgress& GetProgress() const { return progress; }
+
+	// true once after fingerprints were stored, the search index has to be reloaded to see them
+	bool ConsumeDirty() { return bDirty.exchange(false); }
+
+	// main thread. null until the waveform for this version of the file was loaded or analyzed,
+	// a waveform without levels if the file couldn't be decoded
+	const db::Waveform* Request(int fileId, int64_t mtime, const std::string& path);
+
+	// main thread, once per frame
+	void Update();
+
+private:
+	struct RequestJob
+	{
+		int fileId = -1;
+		int64_t mtime = 0;
+		std::string path;
+		db::Waveform waveform;
+		std::atomic<bool> bCancelled{ false };
+	};
+
+	void BatchLoop();
+	void AnalyzeTarget(const db::AnalysisTarget& target);
+	void Load(std::shared_ptr<RequestJob> job);
+
+	// batch
+	std::unique_ptr<JobSystem> jobs;
+	std::thread batchThread;
+	AnalysisProgress progress;
+	std::atomic<uint64_t> analyzedMilliseconds{ 0 };  // of audio, for the throughput log
+	std::atomic<bool> bCancel{ false };
+	std::atomic<bool> bRestart{ false };
+	std::atomic<bool> bDirty{ false };
+	bool bRunning = false;
+
+	// selection, main thread only
+	std::shared_ptr<RequestJob> currentJob;
+	db::Waveform currentWaveform;
+	bool bHasWaveform = false;
+
+	MpscQueue<std::shared_ptr<RequestJob>> loadedQueue;
+	std::mutex loadMutex;
+	std::condition_variable loadCondition;
+	int loadsInFlight = 0;
+};
@@ -0,0 +1,234 @@
+#include "audioengine.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "jobsystem.h"
+
+namespace AudioCallback
+{
+	void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
+	{
+		AudioEngine* engine = (AudioEngine*)pDevice->pUserData;
+		engine->Mix((float*)pOutput, frameCount);
+
+		(void)pInput;
+	}
+}
+
+AudioEngine::AudioEngine()
+{
+	// native rate and channel count, decoders convert to whatever the device wants
+	ma_device_config config = ma_device_config_init(ma_device_type_playback);
+	config.playback.format = ma_format_f32;
+	config.playback.channels = 0;
+	config.sampleRate = 0;
+	config.dataCallback = AudioCallback::data_callback;
+	config.pUserData = this;
+
+	if (ma_device_init(NULL, &config, &device) != MA_SUCCESS)
+	{
+		printf("[audio]: failed to open playback device\n");
+		return;
+	}
+
+	deviceSampleRate = device.sampleRate;
+	deviceChannels = device.playback.channels;
+
+	// runs for the lifetime of the app, paused playback is silence
+	if (ma_device_start(&device) != MA_SUCCESS)
+	{
+		printf("[audio]: failed to start playback device\n");
+		ma_device_uninit(&device);
+		return;
+	}
+
+	bDeviceReady = true;
+	printf("[audio]: playback device at %u Hz, %u channels\n", deviceSampleRate, deviceChannels);
+}
+
+AudioEngine::~AudioEngine()
+{
+	// open jobs point back at the engine
+	selectedGeneration++;
+	{
+		std::unique_lock<std::mutex> lock(openMutex);
+		openCondition.wait(lock, [this] { return opensInFlight == 0; });
+	}
+
+	// stops the callback, after this every track belongs to this thread
+	if (bDeviceReady)
+	{
+		ma_device_uninit(&device);
+	}
+
+	CloseTrack(currentTrack);
+	CloseTrack(pendingTrack.exchange(nullptr));
+	CloseTrack(retiredTrack.exchange(nullptr));
+
+	std::vector<Track*> opened;
+	openedTracks.PopAll(opened);
+	for (Track* track : opened)
+	{
+		CloseTrack(track);
+	}
+}
+
+void AudioEngine::Select(const std::string& path)
+{
+	if (path == trackInfo.path)
+	{
+		return;
+	}
+
+	trackInfo = AudioTrackInfo();
+	trackInfo.path = path;
+	const uint32_t generation = ++selectedGeneration;
+
+	{
+		std::lock_guard<std::mutex> lock(openMutex);
+		opensInFlight++;
+	}
+	JobSystem::GetShared().Submit([this, path, generation]() { Open(path, generation); });
+}
+
+void AudioEngine::Open(std::string path, uint32_t generation)
+{
+	// skimming through a list selects faster than files open, only the latest one matters
+	if (generation == selectedGeneration)
+	{
+		Track* track = new Track();
+		track->generation = generation;
+		track->info.path = path;
+
+		ma_decoder_config config = ma_decoder_config_init(ma_format_f32, deviceChannels, deviceSampleRate);
+		if (ma_decoder_init_file(path.c_str(), &config, &track->decoder) == MA_SUCCESS)
+		{
+			track->info.bValid = true;
+			track->info.sampleRate = track->decoder.internalSampleRate;
+			track->info.channels = track->decoder.internalChannels;
+			track->info.lengthFrames = ma_decoder_get_length_in_pcm_frames(&track->decoder);
+		}
+		else
+		{
+			printf("[audio]: failed to decode [%s]\n", path.c_str());
+		}
+
+		openedTracks.Push(track);
+	}
+
+	// notify under the lock, the engine may be destroyed as soon as the count hits zero
+	std::lock_guard<std::mutex> lock(openMutex);
+	opensInFlight--;
+	openCondition.notify_all();
+}
+
+void AudioEngine::Update()
+{
+	CloseTrack(retiredTrack.exchange(nullptr, std::memory_order_acquire));
+
+	std::vector<Track*> opened;
+	openedTracks.PopAll(opened);
+	for (Track* track : opened)
+	{
+		if (track->generation != selectedGeneration)
+		{
+			CloseTrack(track);
+			continue;
+		}
+
+		trackInfo = track->info;
+
+		// a file that failed to open is handed over too, the callback plays silence for it.
+		// a track the callback hasn't picked up yet is replaced
+		CloseTrack(pendingTrack.exchange(track, std::memory_order_acq_rel));
+	}
+}
+
+void AudioEngine::Stop()
+{
+	bPlaying = false;
+	bRewind = true;
+}
+
+void AudioEngine::CloseTrack(Track* track)
+{
+	if (!track)
+	{
+		return;
+	}
+
+	if (track->info.bValid)
+	{
+		ma_decoder_uninit(&track->decoder);
+	}
+	delete track;
+}
+
+void AudioEngine::Mix(float* output, uint32_t frameCount)
+{
+	// switch once the main thread has collected the previous retired track
+	if (retiredTrack.load(std::memory_order_acquire) == nullptr)
+	{
+		Track* next = pendingTrack.exchange(nullptr, std::memory_order_acq_rel);
+		if (next)
+		{
+			retiredTrack.store(currentTrack, std::memory_order_release);
+			currentTrack = next;
+			cursorFrames = 0;
+		}
+	}
+
+	const bool bHasTrack = currentTrack && currentTrack->info.bValid;
+	if (bRewind.exchange(false) && bHasTrack)
+	{
+		ma_decoder_seek_to_pcm_frame(&currentTrack->decoder, 0);
+		cursorFrames = 0;
+	}
+
+	ma_uint64 framesRead = 0;
+	if (bHasTrack && bPlaying)
+	{
+		framesRead = ma_decoder_read_pcm_frames(&currentTrack->decoder, output, frameCount);
+		cursorFrames += framesRead;
+		PublishVisualizerSamples(output, framesRead);
+
+		// reached the end, rewind so play starts over
+		if (framesRead < frameCount)
+		{
+			bPlaying = false;
+			ma_decoder_seek_to_pcm_frame(&currentTrack->decoder, 0);
+			cursorFrames = 0;
+		}
+	}
+
+	if (framesRead < frameCount)
+	{
+		memset(output + framesRead * deviceChannels, 0, (size_t)(frameCount - framesRead) * deviceChannels * sizeof(float));
+	}
+}
+
+void AudioEngine::PublishVisualizerSamples(const float* frames, uint64_t frameCount)
+{
+	// mixed down in stack sized pieces, nothing here may allocate
+	float mono[256];
+	const float scale = 1.0f / deviceChannels;
+	while (frameCount > 0)
+	{
+		const uint64_t count = frameCount < 256 ? frameCount : 256;
+		for (uint64_t frame = 0; frame < count; frame++)
+		{
+			float sum = 0.0f;
+			for (uint32_t channel = 0; channel < deviceChannels; channel++)
+			{
+				sum += frames[frame * deviceChannels + channel];
+			}
+			mono[frame] = sum * scale;
+		}
+
+		visualizerRing.Push(mono, (size_t)count);
+		frames += count * deviceChannels;
+		frameCount -= count;
+	}
+}
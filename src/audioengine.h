@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+#include "miniaudio.h"
+
+#include "mpscqueue.h"
+#include "spscring.h"
+
+// what the ui knows about the selected sound
+struct AudioTrackInfo
+{
+	std::string path;
+	bool bValid = false;        // false while opening or if the file couldn't be decoded
+	uint32_t sampleRate = 0;    // of the file, playback is resampled to the device
+	uint32_t channels = 0;
+	uint64_t lengthFrames = 0;  // in device frames
+};
+
+// one playback device for the whole app. selecting a sound opens its decoder on the shared
+// job system, configured to convert to the device format, and hands it to the audio callback
+// through an atomic pointer: the callback never locks, allocates or frees. the decoder it drops
+// goes back through a second pointer and is closed on the main thread.
+// playback state survives selection changes, a playing sound switches to the new one.
+class AudioEngine
+{
+public:
+	AudioEngine();
+	~AudioEngine();
+
+	AudioEngine(const AudioEngine&) = delete;
+	AudioEngine& operator=(const AudioEngine&) = delete;
+
+	bool IsValid() const { return bDeviceReady; }
+
+	// main thread. no op if path is already selected
+	void Select(const std::string& path);
+
+	// main thread, once per frame. publishes opened sounds and closes dropped ones
+	void Update();
+
+	void Play() { bPlaying = true; }
+	void Pause() { bPlaying = false; }
+	void Stop();
+	bool IsPlaying() const { return bPlaying; }
+
+	const AudioTrackInfo& GetTrackInfo() const { return trackInfo; }
+	uint64_t GetCursorFrames() const { return cursorFrames; }
+	uint32_t GetDeviceSampleRate() const { return deviceSampleRate; }
+	uint32_t GetDeviceChannels() const { return deviceChannels; }
+
+	// main thread. mono mix of what the device played since the last call, for visualizers
+	size_t ReadVisualizerSamples(float* outSamples, size_t maxCount) { return visualizerRing.Pop(outSamples, maxCount); }
+
+	// audio thread
+	void Mix(float* output, uint32_t frameCount);
+
+private:
+	struct Track
+	{
+		ma_decoder decoder;
+		uint32_t generation = 0;
+		AudioTrackInfo info;
+	};
+
+	void Open(std::string path, uint32_t generation);
+	void CloseTrack(Track* track);
+	void PublishVisualizerSamples(const float* frames, uint64_t frameCount);
+
+	ma_device device;
+	bool bDeviceReady = false;
+	uint32_t deviceSampleRate = 0;
+	uint32_t deviceChannels = 0;
+
+	// main -> audio thread, the next track to play
+	std::atomic<Track*> pendingTrack{ nullptr };
+	// audio thread -> main, the track the callback let go of
+	std::atomic<Track*> retiredTrack{ nullptr };
+	// audio thread only
+	Track* currentTrack = nullptr;
+
+	std::atomic<bool> bPlaying{ false };
+	std::atomic<bool> bRewind{ false };
+	std::atomic<uint64_t> cursorFrames{ 0 };
+
+	// audio thread -> main, about a third of a second at 48 kHz. full when the ui stalls, the newest samples are dropped
+	SpscRing<float> visualizerRing{ 16384 };
+
+	// main thread only
+	AudioTrackInfo trackInfo;
+
+	// open jobs compare against it to skip selections that were already replaced
+	std::atomic<uint32_t> selectedGeneration{ 0 };
+
+	MpscQueue<Track*> openedTracks;
+	std::mutex openMutex;
+	std::condition_variable openCondition;
+	int opensInFlight = 0;
+};
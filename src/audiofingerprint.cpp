@@ -0,0 +1,210 @@
+#include "audiofingerprint.h"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FINGERPRINT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static_assert(2 * FingerprintBuilder::COEFFICIENTS == db::AUDIO_FINGERPRINT_SIZE, "mean and deviation per coefficient");
+
+// mel bands cover this range. the top stays under the nyquist of 22 khz files so every rate sees the same bands
+static const float FINGERPRINT_MIN_HZ = 60.0f;
+static const float FINGERPRINT_MAX_HZ = 10000.0f;
+
+// windows quieter than -80 dBFS are skipped, silent tails would otherwise dominate the statistics
+static const float SILENT_WINDOW_POWER = 1e-8f;
+
+static const double PI = 3.14159265358979323846;
+
+static inline float HzToMel(float hz) { return 2595.0f * log10f(1.0f + hz / 700.0f); }
+static inline float MelToHz(float mel) { return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f); }
+
+FingerprintBuilder::FingerprintBuilder(uint32_t channels, uint32_t sampleRate)
+	: channels(channels), fft(FFT_SIZE)
+{
+	window.resize(FFT_SIZE);
+	for (int i = 0; i < FFT_SIZE; i++)
+	{
+		window[i] = (float)(0.5 - 0.5 * cos(2.0 * PI * i / (FFT_SIZE - 1)));
+	}
+	samples.reserve(FFT_SIZE);
+	windowed.resize(FFT_SIZE);
+	power.resize(FFT_SIZE / 2 + 1);
+
+	// edges evenly spaced in mel, each band rises from its left edge to the center and falls to the right one
+	const float binHz = (float)sampleRate / FFT_SIZE;
+	const float maxHz = std::min(FINGERPRINT_MAX_HZ, 0.5f * sampleRate);
+	const float minMel = HzToMel(FINGERPRINT_MIN_HZ);
+	const float maxMel = HzToMel(std::max(maxHz, 2.0f * FINGERPRINT_MIN_HZ));
+
+	float edges[MEL_BANDS + 2];
+	for (int i = 0; i < MEL_BANDS + 2; i++)
+	{
+		edges[i] = MelToHz(minMel + (maxMel - minMel) * i / (MEL_BANDS + 1));
+	}
+
+	melBands.resize(MEL_BANDS);
+	for (int band = 0; band < MEL_BANDS; band++)
+	{
+		const float left = edges[band];
+		const float center = edges[band + 1];
+		const float right = edges[band + 2];
+
+		MelBand& melBand = melBands[band];
+		melBand.firstBin = std::max(1, (int)ceilf(left / binHz));
+		const int lastBin = std::min(FFT_SIZE / 2, (int)floorf(right / binHz));
+		for (int bin = melBand.firstBin; bin <= lastBin; bin++)
+		{
+			const float hz = bin * binHz;
+			melBand.weights.push_back(hz <= center ? (hz - left) / (center - left) : (right - hz) / (right - center));
+		}
+
+		// low bands can be narrower than a bin, they take the nearest one
+		if (melBand.weights.empty())
+		{
+			melBand.firstBin = std::min(FFT_SIZE / 2, std::max(1, (int)lroundf(center / binHz)));
+			melBand.weights.push_back(1.0f);
+		}
+	}
+
+	dct.resize(COEFFICIENTS * MEL_BANDS);
+	const double scale = sqrt(2.0 / MEL_BANDS);
+	for (int c = 0; c < COEFFICIENTS; c++)
+	{
+		for (int band = 0; band < MEL_BANDS; band++)
+		{
+			dct[c * MEL_BANDS + band] = (float)(scale * cos(PI * (c + 1) * (band + 0.5) / MEL_BANDS));
+		}
+	}
+}
+
+void FingerprintBuilder::Add(const float* frames, size_t frameCount)
+{
+	const float channelScale = 1.0f / channels;
+	for (size_t frame = 0; frame < frameCount; frame++, frames += channels)
+	{
+		float mono = 0.0f;
+		for (uint32_t channel = 0; channel < channels; channel++)
+		{
+			mono += frames[channel];
+		}
+		samples.push_back(mono * channelScale);
+
+		if (samples.size() == FFT_SIZE)
+		{
+			ProcessWindow();
+		}
+	}
+}
+
+void FingerprintBuilder::ProcessWindow()
+{
+	// zero padded for the last, partial window
+	samples.resize(FFT_SIZE, 0.0f);
+
+	float energy = 0.0f;
+	for (int i = 0; i < FFT_SIZE; i++)
+	{
+		energy += samples[i] * samples[i];
+		windowed[i] = samples[i] * window[i];
+	}
+	samples.clear();
+
+	if (energy / FFT_SIZE < SILENT_WINDOW_POWER)
+	{
+		return;
+	}
+
+	fft.PowerSpectrum(windowed.data(), power.data());
+
+	float logBands[MEL_BANDS];
+	for (int band = 0; band < MEL_BANDS; band++)
+	{
+		const MelBand& melBand = melBands[band];
+		float sum = 0.0f;
+		for (size_t i = 0; i < melBand.weights.size(); i++)
+		{
+			sum += melBand.weights[i] * power[melBand.firstBin + i];
+		}
+		logBands[band] = logf(sum + 1e-10f);
+	}
+
+	for (int c = 0; c < COEFFICIENTS; c++)
+	{
+		const float* row = &dct[c * MEL_BANDS];
+		float coefficient = 0.0f;
+		for (int band = 0; band < MEL_BANDS; band++)
+		{
+			coefficient += row[band] * logBands[band];
+		}
+		sums[c] += coefficient;
+		sumSquares[c] += (double)coefficient * coefficient;
+	}
+	windowCount++;
+}
+
+bool FingerprintBuilder::Finish(std::vector<float>& outFingerprint)
+{
+	// a tail of at least half a window counts, and so does anything shorter than one window
+	if (!samples.empty() && (windowCount == 0 || samples.size() >= FFT_SIZE / 2))
+	{
+		ProcessWindow();
+	}
+
+	outFingerprint.clear();
+	if (windowCount == 0)
+	{
+		return false;
+	}
+
+	outFingerprint.resize(db::AUDIO_FINGERPRINT_SIZE);
+	for (int c = 0; c < COEFFICIENTS; c++)
+	{
+		const double mean = sums[c] / windowCount;
+		const double variance = std::max(0.0, sumSquares[c] / windowCount - mean * mean);
+		outFingerprint[c] = (float)mean;
+		outFingerprint[COEFFICIENTS + c] = (float)sqrt(variance);
+	}
+	return true;
+}
+
+#ifdef FINGERPRINT_SSE2
+
+float GetFingerprintDistance(const float* a, const float* b)
+{
+	static_assert(db::AUDIO_FINGERPRINT_SIZE % 8 == 0, "two vectors per step");
+
+	// two accumulators so consecutive adds don't wait on each other
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i += 8)
+	{
+		const __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+		const __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(d0, d0));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(d1, d1));
+	}
+
+	__m128 sum = _mm_add_ps(sum0, sum1);
+	sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(sum);
+}
+
+#else
+
+float GetFingerprintDistance(const float* a, const float* b)
+{
+	float sum = 0.0f;
+	for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i++)
+	{
+		const float d = a[i] - b[i];
+		sum += d * d;
+	}
+	return sum;
+}
+
+#endif
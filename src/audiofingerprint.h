@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "db.h"
+#include "spectrum.h"
+
+// summarizes how a sound's spectrum looks and moves in db::AUDIO_FINGERPRINT_SIZE floats: the mean and
+// standard deviation over time of mfcc 1..16 (mel cepstrum, c0 is left out so level doesn't count).
+// frequencies are mapped in hz, so the same sound at 22 and 48 khz gets nearly the same fingerprint.
+// fed the decoded frames as they come, memory doesn't depend on the length
+class FingerprintBuilder
+{
+public:
+	static const int FFT_SIZE = 1024;
+	static const int MEL_BANDS = 40;
+	static const int COEFFICIENTS = 16;
+
+	FingerprintBuilder(uint32_t channels, uint32_t sampleRate);
+
+	void Add(const float* frames, size_t frameCount);
+
+	// false (and no values) for silence
+	bool Finish(std::vector<float>& outFingerprint);
+
+private:
+	void ProcessWindow();
+
+	uint32_t channels;
+	RealFft fft;
+	std::vector<float> window;
+	std::vector<float> samples;  // mono, fills up to FFT_SIZE
+	std::vector<float> windowed;
+	std::vector<float> power;
+
+	// triangular mel filters as runs of bin weights
+	struct MelBand
+	{
+		int firstBin;
+		std::vector<float> weights;
+	};
+	std::vector<MelBand> melBands;
+	std::vector<float> dct;  // COEFFICIENTS x MEL_BANDS, row c is coefficient c + 1
+
+	int windowCount = 0;
+	double sums[COEFFICIENTS] = {};
+	double sumSquares[COEFFICIENTS] = {};
+};
+
+// squared euclidean distance of two fingerprints, sse2 where available
+float GetFingerprintDistance(const float* a, const float* b);
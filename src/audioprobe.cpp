@@ -0,0 +1,376 @@
+#include "audioprobe.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// how much of the front of a file the parsers look at. covers the fmt chunk of any wav, the first
+// ogg page and a few mpeg frames
+static const size_t PROBE_HEAD_BYTES = 16 * 1024;
+// the last ogg page (its granule position is the length) is at most 64 kb
+static const size_t PROBE_TAIL_BYTES = 64 * 1024;
+
+static bool Seek(FILE* file, int64_t offset, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, origin) == 0;
+#else
+	return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+}
+
+static int64_t Tell(FILE* file)
+{
+#ifdef _WIN32
+	return _ftelli64(file);
+#else
+	return (int64_t)ftello(file);
+#endif
+}
+
+// reads up to count bytes at offset, returns how many were read
+static size_t ReadAt(FILE* file, int64_t offset, std::vector<unsigned char>& outBytes, size_t count)
+{
+	outBytes.resize(count);
+	if (!Seek(file, offset, SEEK_SET))
+	{
+		outBytes.clear();
+		return 0;
+	}
+	outBytes.resize(fread(outBytes.data(), 1, count, file));
+	return outBytes.size();
+}
+
+static inline uint32_t ReadLe16(const unsigned char* bytes) { return bytes[0] | (bytes[1] << 8); }
+static inline uint32_t ReadLe32(const unsigned char* bytes) { return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24); }
+static inline uint32_t ReadBe32(const unsigned char* bytes) { return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]; }
+static inline uint64_t ReadLe64(const unsigned char* bytes) { return ReadLe32(bytes) | ((uint64_t)ReadLe32(bytes + 4) << 32); }
+
+static const char* GetWaveCodec(uint32_t formatTag)
+{
+	switch (formatTag)
+	{
+	case 0x0001: return "pcm";
+	case 0x0002: return "adpcm";
+	case 0x0003: return "float";
+	case 0x0006: return "alaw";
+	case 0x0007: return "mulaw";
+	case 0x0011: return "adpcm";
+	case 0x0055: return "mp3";
+	default: return "wav";
+	}
+}
+
+// riff chunks: fmt has the format, data's size gives the length. chunks are walked with seeks,
+// the sample data itself is never read
+static bool ProbeWave(FILE* file, int64_t fileSize, AudioHeader& outHeader)
+{
+	std::vector<unsigned char> bytes;
+	int64_t offset = 12;
+	uint32_t blockAlign = 0;
+	bool bHasFormat = false;
+
+	while (offset + 8 <= fileSize)
+	{
+		if (ReadAt(file, offset, bytes, 8) < 8)
+		{
+			break;
+		}
+
+		const uint32_t chunkSize = ReadLe32(&bytes[4]);
+		const int64_t dataOffset = offset + 8;
+
+		if (memcmp(bytes.data(), "fmt ", 4) == 0 && chunkSize >= 16)
+		{
+			if (ReadAt(file, dataOffset, bytes, chunkSize < 40 ? chunkSize : 40) < 16)
+			{
+				return false;
+			}
+
+			uint32_t formatTag = ReadLe16(&bytes[0]);
+			outHeader.channels = (int)ReadLe16(&bytes[2]);
+			outHeader.sampleRate = (int)ReadLe32(&bytes[4]);
+			blockAlign = ReadLe16(&bytes[12]);
+
+			// WAVE_FORMAT_EXTENSIBLE, the real tag is the start of the sub format guid
+			if (formatTag == 0xFFFE && bytes.size() >= 26)
+			{
+				formatTag = ReadLe16(&bytes[24]);
+			}
+			outHeader.codec = GetWaveCodec(formatTag);
+			bHasFormat = true;
+		}
+		else if (memcmp(bytes.data(), "data", 4) == 0 && bHasFormat)
+		{
+			// writers that stream leave the size at 0 or -1, the data then runs to the end of the file
+			int64_t dataSize = chunkSize;
+			if (dataSize == 0 || dataSize == 0xFFFFFFFF || dataOffset + dataSize > fileSize)
+			{
+				dataSize = fileSize - dataOffset;
+			}
+
+			// compressed formats have no fixed bytes per frame, the header alone can't tell their length
+			if (blockAlign > 0 && outHeader.sampleRate > 0 && (outHeader.codec == "pcm" || outHeader.codec == "float" ||
+				outHeader.codec == "alaw" || outHeader.codec == "mulaw"))
+			{
+				const int64_t frames = dataSize / blockAlign;
+				outHeader.durationMs = frames * 1000 / outHeader.sampleRate;
+			}
+			return true;
+		}
+
+		// chunks are padded to an even size
+		offset = dataOffset + chunkSize + (chunkSize & 1);
+	}
+
+	return bHasFormat;
+}
+
+// the identification header is the first packet of the first page, the granule position
+// of the last page is the stream length in samples
+static bool ProbeOgg(FILE* file, int64_t fileSize, const std::vector<unsigned char>& head, AudioHeader& outHeader)
+{
+	if (head.size() < 28)
+	{
+		return false;
+	}
+
+	const uint32_t serial = ReadLe32(&head[14]);
+	const size_t segmentCount = head[26];
+	const size_t packetOffset = 27 + segmentCount;
+	if (packetOffset + 19 > head.size())
+	{
+		return false;
+	}
+
+	const unsigned char* packet = &head[packetOffset];
+	uint32_t preSkip = 0;
+	if (memcmp(packet, "\x01vorbis", 7) == 0)
+	{
+		outHeader.codec = "vorbis";
+		outHeader.channels = packet[11];
+		outHeader.sampleRate = (int)ReadLe32(packet + 12);
+	}
+	else if (memcmp(packet, "OpusHead", 8) == 0)
+	{
+		// opus always decodes at 48 kHz, the input rate is informational
+		outHeader.codec = "opus";
+		outHeader.channels = packet[9];
+		outHeader.sampleRate = 48000;
+		preSkip = ReadLe16(packet + 10);
+	}
+	else
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> tail;
+	const int64_t tailOffset = fileSize > (int64_t)PROBE_TAIL_BYTES ? fileSize - (int64_t)PROBE_TAIL_BYTES : 0;
+	ReadAt(file, tailOffset, tail, (size_t)(fileSize - tailOffset));
+
+	for (size_t i = tail.size() >= 27 ? tail.size() - 26 : 0; i-- > 0;)
+	{
+		if (memcmp(&tail[i], "OggS", 4) == 0 && ReadLe32(&tail[i + 14]) == serial)
+		{
+			const uint64_t granule = ReadLe64(&tail[i + 6]);
+			// -1 marks a page where no packet ends
+			if (granule != ~0ull && outHeader.sampleRate > 0 && granule > preSkip)
+			{
+				outHeader.durationMs = (int64_t)((granule - preSkip) * 1000 / (uint64_t)outHeader.sampleRate);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+struct MpegFrame
+{
+	int version = 0;  // 1, 2, or 25 for 2.5
+	int layer = 0;
+	int bitrateKbps = 0;
+	int sampleRate = 0;
+	int channels = 0;
+	int samplesPerFrame = 0;
+	int size = 0;
+};
+
+static bool ParseMpegFrame(const unsigned char* bytes, MpegFrame& outFrame)
+{
+	static const int BITRATES[2][3][15] = {
+		// mpeg 1, layer 1, 2, 3
+		{ { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+		  { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+		  { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 } },
+		// mpeg 2 and 2.5
+		{ { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+		  { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+		  { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 } },
+	};
+	static const int SAMPLE_RATES[3] = { 44100, 48000, 32000 };
+
+	if (bytes[0] != 0xFF || (bytes[1] & 0xE0) != 0xE0)
+	{
+		return false;
+	}
+
+	const int versionBits = (bytes[1] >> 3) & 3;
+	const int layerBits = (bytes[1] >> 1) & 3;
+	const int bitrateIndex = bytes[2] >> 4;
+	const int sampleRateIndex = (bytes[2] >> 2) & 3;
+	if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3)
+	{
+		return false;
+	}
+
+	outFrame.version = versionBits == 3 ? 1 : (versionBits == 2 ? 2 : 25);
+	outFrame.layer = 4 - layerBits;
+	outFrame.bitrateKbps = BITRATES[outFrame.version == 1 ? 0 : 1][outFrame.layer - 1][bitrateIndex];
+	outFrame.sampleRate = SAMPLE_RATES[sampleRateIndex] / (outFrame.version == 1 ? 1 : (outFrame.version == 2 ? 2 : 4));
+	outFrame.channels = (bytes[3] >> 6) == 3 ? 1 : 2;
+
+	const int padding = (bytes[2] >> 1) & 1;
+	if (outFrame.layer == 1)
+	{
+		outFrame.samplesPerFrame = 384;
+		outFrame.size = (12 * outFrame.bitrateKbps * 1000 / outFrame.sampleRate + padding) * 4;
+	}
+	else
+	{
+		outFrame.samplesPerFrame = (outFrame.layer == 3 && outFrame.version != 1) ? 576 : 1152;
+		outFrame.size = outFrame.samplesPerFrame / 8 * outFrame.bitrateKbps * 1000 / outFrame.sampleRate + padding;
+	}
+	return true;
+}
+
+// skips an id3v2 tag, finds the first frame that is followed by another valid frame and reads the
+// length from its xing/info or vbri header. without one the stream is taken as constant bitrate
+static bool ProbeMpeg(FILE* file, int64_t fileSize, const std::vector<unsigned char>& head, AudioHeader& outHeader)
+{
+	int64_t offset = 0;
+	if (head.size() >= 10 && memcmp(head.data(), "ID3", 3) == 0)
+	{
+		const int64_t tagSize = ((head[6] & 0x7F) << 21) | ((head[7] & 0x7F) << 14) | ((head[8] & 0x7F) << 7) | (head[9] & 0x7F);
+		offset = 10 + tagSize + ((head[5] & 0x10) ? 10 : 0);
+	}
+
+	std::vector<unsigned char> bytes;
+	if (offset == 0)
+	{
+		bytes = head;
+	}
+	else
+	{
+		ReadAt(file, offset, bytes, PROBE_HEAD_BYTES);
+	}
+
+	MpegFrame frame;
+	size_t frameOffset = 0;
+	bool bFound = false;
+	for (size_t i = 0; i + 4 <= bytes.size() && !bFound; i++)
+	{
+		if (!ParseMpegFrame(&bytes[i], frame))
+		{
+			continue;
+		}
+
+		// a lone sync pattern inside other data is common, the next frame has to line up too
+		MpegFrame next;
+		const size_t nextOffset = i + frame.size;
+		if (nextOffset + 4 <= bytes.size())
+		{
+			bFound = ParseMpegFrame(&bytes[nextOffset], next) && next.sampleRate == frame.sampleRate && next.layer == frame.layer;
+		}
+		else
+		{
+			bFound = offset + (int64_t)nextOffset == fileSize;
+		}
+
+		if (bFound)
+		{
+			frameOffset = i;
+		}
+	}
+
+	if (!bFound)
+	{
+		return false;
+	}
+
+	outHeader.codec = frame.layer == 3 ? "mp3" : (frame.layer == 2 ? "mp2" : "mp1");
+	outHeader.sampleRate = frame.sampleRate;
+	outHeader.channels = frame.channels;
+
+	// vbr encoders put the frame count in the first frame, after the side info
+	const size_t sideInfo = frame.version == 1 ? (frame.channels == 1 ? 17 : 32) : (frame.channels == 1 ? 9 : 17);
+	const size_t xingOffset = frameOffset + 4 + sideInfo;
+	const size_t vbriOffset = frameOffset + 4 + 32;
+
+	uint32_t frameCount = 0;
+	if (xingOffset + 12 <= bytes.size() &&
+		(memcmp(&bytes[xingOffset], "Xing", 4) == 0 || memcmp(&bytes[xingOffset], "Info", 4) == 0))
+	{
+		if (ReadBe32(&bytes[xingOffset + 4]) & 1)
+		{
+			frameCount = ReadBe32(&bytes[xingOffset + 8]);
+		}
+	}
+	else if (vbriOffset + 18 <= bytes.size() && memcmp(&bytes[vbriOffset], "VBRI", 4) == 0)
+	{
+		frameCount = ReadBe32(&bytes[vbriOffset + 14]);
+	}
+
+	if (frameCount > 0)
+	{
+		outHeader.durationMs = (int64_t)frameCount * frame.samplesPerFrame * 1000 / frame.sampleRate;
+	}
+	else
+	{
+		int64_t audioBytes = fileSize - offset - (int64_t)frameOffset;
+
+		std::vector<unsigned char> id3v1;
+		if (fileSize >= 128 && ReadAt(file, fileSize - 128, id3v1, 3) == 3 && memcmp(id3v1.data(), "TAG", 3) == 0)
+		{
+			audioBytes -= 128;
+		}
+		outHeader.durationMs = audioBytes > 0 ? audioBytes * 8 / frame.bitrateKbps : 0;
+	}
+	return true;
+}
+
+bool ProbeAudioFile(const char* path, AudioHeader& outHeader)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	int64_t fileSize = 0;
+	if (Seek(file, 0, SEEK_END))
+	{
+		fileSize = Tell(file);
+	}
+
+	std::vector<unsigned char> head;
+	ReadAt(file, 0, head, PROBE_HEAD_BYTES);
+
+	// recognized by content, extensions lie
+	bool bParsed = false;
+	if (head.size() >= 12 && (memcmp(head.data(), "RIFF", 4) == 0 || memcmp(head.data(), "RF64", 4) == 0) &&
+		memcmp(&head[8], "WAVE", 4) == 0)
+	{
+		bParsed = ProbeWave(file, fileSize, outHeader);
+	}
+	else if (head.size() >= 4 && memcmp(head.data(), "OggS", 4) == 0)
+	{
+		bParsed = ProbeOgg(file, fileSize, head, outHeader);
+	}
+	else
+	{
+		bParsed = ProbeMpeg(file, fileSize, head, outHeader);
+	}
+
+	fclose(file);
+	return bParsed && outHeader.sampleRate > 0 && outHeader.channels > 0;
+}
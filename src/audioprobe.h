@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// what a sound's header says about it, read without decoding or opening a device
+struct AudioHeader
+{
+	int sampleRate = 0;
+	int channels = 0;
+	int64_t durationMs = 0;  // 0 if the header doesn't tell
+	std::string codec;       // "pcm", "float", "adpcm", "vorbis", "opus", "mp3"...
+};
+
+// parses the header of a wav, ogg (vorbis/opus) or mpeg audio file. reads a few kb from the front
+// (and the last page of an ogg stream for its length). false if the format isn't recognized
+bool ProbeAudioFile(const char* path, AudioHeader& outHeader);
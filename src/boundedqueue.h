@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// blocking multi producer / multi consumer queue with a fixed capacity.
+// producers block when the queue is full so a fast producer can't run away from a slow consumer.
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity)
+		: capacity(capacity)
+	{
+	}
+
+	// returns false if the queue was closed
+	bool Push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this] { return bClosed || items.size() < capacity; });
+		if (bClosed)
+		{
+			return false;
+		}
+
+		items.push_back(std::move(item));
+		lock.unlock();
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// blocks until an item is available, returns false once closed and drained
+	bool Pop(T& outItem)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this] { return bClosed || !items.empty(); });
+		if (items.empty())
+		{
+			return false;
+		}
+
+		outItem = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		notFull.notify_one();
+		return true;
+	}
+
+	// non blocking pop
+	bool TryPop(T& outItem)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (items.empty())
+		{
+			return false;
+		}
+
+		outItem = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		notFull.notify_one();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bClosed = true;
+		}
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+	// reopens a closed queue, dropping anything left in it
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		items.clear();
+		bClosed = false;
+	}
+
+	size_t Size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return items.size();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	std::deque<T> items;
+	size_t capacity;
+	bool bClosed = false;
+};
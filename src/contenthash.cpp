@@ -0,0 +1,188 @@
+#include "contenthash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// one read per call, big enough that the disk streams instead of seeking between files
+static const size_t HASH_READ_BYTES = 1024 * 1024;
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+// little endian loads, memcpy compiles to a plain move
+static inline uint64_t Read64(const unsigned char* bytes)
+{
+	uint64_t value;
+	memcpy(&value, bytes, 8);
+	return value;
+}
+
+static inline uint32_t Read32(const unsigned char* bytes)
+{
+	uint32_t value;
+	memcpy(&value, bytes, 4);
+	return value;
+}
+
+static inline uint64_t Round(uint64_t lane, uint64_t input)
+{
+	lane += input * PRIME2;
+	lane = RotateLeft(lane, 31);
+	return lane * PRIME1;
+}
+
+static inline uint64_t MergeRound(uint64_t hash, uint64_t lane)
+{
+	hash ^= Round(0, lane);
+	return hash * PRIME1 + PRIME4;
+}
+
+Xxh64::Xxh64(uint64_t seed)
+	: seed(seed)
+{
+	lanes[0] = seed + PRIME1 + PRIME2;
+	lanes[1] = seed + PRIME2;
+	lanes[2] = seed;
+	lanes[3] = seed - PRIME1;
+}
+
+void Xxh64::Update(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	const unsigned char* const end = bytes + size;
+	totalSize += size;
+
+	if (bufferSize + size < 32)
+	{
+		memcpy(buffer + bufferSize, bytes, size);
+		bufferSize += size;
+		return;
+	}
+
+	if (bufferSize > 0)
+	{
+		const size_t fill = 32 - bufferSize;
+		memcpy(buffer + bufferSize, bytes, fill);
+		bytes += fill;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			lanes[lane] = Round(lanes[lane], Read64(buffer + lane * 8));
+		}
+		bufferSize = 0;
+	}
+
+	// four independent lanes, the multiplies of one stripe overlap
+	uint64_t lane0 = lanes[0], lane1 = lanes[1], lane2 = lanes[2], lane3 = lanes[3];
+	for (; bytes + 32 <= end; bytes += 32)
+	{
+		lane0 = Round(lane0, Read64(bytes));
+		lane1 = Round(lane1, Read64(bytes + 8));
+		lane2 = Round(lane2, Read64(bytes + 16));
+		lane3 = Round(lane3, Read64(bytes + 24));
+	}
+	lanes[0] = lane0; lanes[1] = lane1; lanes[2] = lane2; lanes[3] = lane3;
+
+	bufferSize = end - bytes;
+	memcpy(buffer, bytes, bufferSize);
+}
+
+uint64_t Xxh64::Digest() const
+{
+	uint64_t hash;
+	if (totalSize >= 32)
+	{
+		hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			hash = MergeRound(hash, lanes[lane]);
+		}
+	}
+	else
+	{
+		hash = seed + PRIME5;
+	}
+	hash += totalSize;
+
+	// the tail: 8, then 4, then single bytes
+	const unsigned char* bytes = buffer;
+	const unsigned char* const end = buffer + bufferSize;
+	for (; bytes + 8 <= end; bytes += 8)
+	{
+		hash ^= Round(0, Read64(bytes));
+		hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+	}
+	if (bytes + 4 <= end)
+	{
+		hash ^= (uint64_t)Read32(bytes) * PRIME1;
+		hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+		bytes += 4;
+	}
+	for (; bytes < end; bytes++)
+	{
+		hash ^= *bytes * PRIME5;
+		hash = RotateLeft(hash, 11) * PRIME1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint64_t Xxh64::Hash(const void* data, size_t size, uint64_t seed)
+{
+	Xxh64 state(seed);
+	state.Update(data, size);
+	return state.Digest();
+}
+
+bool HashFile(const char* path, uint64_t maxBytes, const std::atomic<bool>* bCancel, uint64_t& outHash)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	// reads go straight into our buffer, stdio's own would only add a copy
+	setvbuf(file, nullptr, _IONBF, 0);
+
+	const uint64_t limit = maxBytes > 0 ? maxBytes : UINT64_MAX;
+	std::vector<unsigned char> chunk((size_t)std::min<uint64_t>(limit, HASH_READ_BYTES));
+
+	Xxh64 state;
+	uint64_t total = 0;
+	bool bOk = true;
+	while (total < limit)
+	{
+		if (bCancel && bCancel->load(std::memory_order_relaxed))
+		{
+			bOk = false;
+			break;
+		}
+
+		const size_t wanted = (size_t)std::min<uint64_t>(chunk.size(), limit - total);
+		const size_t read = fread(chunk.data(), 1, wanted, file);
+		state.Update(chunk.data(), read);
+		total += read;
+
+		if (read < wanted)
+		{
+			bOk = !ferror(file);
+			break;
+		}
+	}
+
+	fclose(file);
+	outHash = state.Digest();
+	return bOk;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// xxh64, streaming. digests match the reference implementation, so they can be checked with xxhsum
+class Xxh64
+{
+public:
+	explicit Xxh64(uint64_t seed = 0);
+
+	void Update(const void* data, size_t size);
+	uint64_t Digest() const;
+
+	static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+private:
+	uint64_t seed;
+	uint64_t lanes[4];
+	uint64_t totalSize = 0;
+	unsigned char buffer[32];
+	size_t bufferSize = 0;
+};
+
+// hashes the first maxBytes of a file (0 for all of it) with large sequential reads.
+// false if it can't be read or bCancel was raised meanwhile
+bool HashFile(const char* path, uint64_t maxBytes, const std::atomic<bool>* bCancel, uint64_t& outHash);
@@ -0,0 +1,969 @@
+#include "db.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdio.h>
+
+#include "sqlite3.h"
+#include "sqlite_orm/sqlite_orm.h"
+
+namespace db {
+
+	static const char* DB_PATH = "./db.sqlite";
+
+	using namespace sqlite_orm;
+	static auto storage = make_storage(DB_PATH,
+
+		// note:  indexing speeds up exact query but slows down like query
+		//put `make_index` before `make_table` cause `sync_schema` is called in reverse order
+		//make_index("idx_file_name", &File::name),
+
+		// removing a directory deletes its subtree by a range over dir
+		make_index("idx_files_dir", &File::directory),
+
+		make_table("files",
+			make_column("id", &File::id, autoincrement(), primary_key()),
+			make_column("name", &File::name),
+			make_column("path", &File::path, unique()),
+			make_column("ext", &File::ext),
+			make_column("size", &File::size),
+			make_column("type", &File::type),
+			make_column("dir", &File::directory),
+			make_column("mtime", &File::mtime, default_value(0)),
+			make_column("duration_ms", &File::durationMs, default_value(0)),
+			make_column("sample_rate", &File::sampleRate, default_value(0)),
+			make_column("channels", &File::channels, default_value(0)),
+			make_column("codec", &File::codec, default_value("")),
+			make_column("width", &File::width, default_value(0)),
+			make_column("height", &File::height, default_value(0)),
+			make_column("components", &File::components, default_value(0)),
+			make_column("content_hash", &File::contentHash, default_value(0)),
+			make_column("hash_mtime", &File::hashMtime, default_value(0)),
+			make_column("perceptual_hash", &File::perceptualHash, default_value(0)),
+			make_column("perceptual_mtime", &File::perceptualMtime, default_value(0))),
+
+		make_table("directories",
+			make_column("path", &Directory::path, primary_key()),
+			make_column("parent", &Directory::parent),
+			make_column("mtime", &Directory::mtime)),
+
+		make_table("tags",
+			make_column("id", &Tag::id, autoincrement(), primary_key()),
+			make_column("name", &Tag::name, unique())),
+
+		make_table("fileTags",
+			make_column("id", &FileTag::id, autoincrement(), primary_key()),
+			make_column("file_id", &FileTag::file_id),
+			make_column("tag_id", &FileTag::tag_id),
+			foreign_key(&FileTag::file_id).references(&File::id),
+			foreign_key(&FileTag::tag_id).references(&Tag::id))
+	);
+
+	// the scanner writes from its own thread while the ui queries
+	static std::recursive_mutex storageMutex;
+
+	// bulk reads for the in memory search index (and the few queries that don't go through it) run on
+	// their own connection, wal lets them run while the scanner writes
+	static sqlite3* searchConnection = nullptr;
+	static std::mutex searchMutex;
+
+	// name search used to go through the searchPattern scratch table of older dbs, it is answered by the
+	// in memory SearchIndex now
+	static const char* DROP_UNUSED_SCHEMA =
+		"DROP TABLE IF EXISTS searchPattern;";
+
+	static void InitSearchConnection()
+	{
+		if (sqlite3_open_v2(DB_PATH, &searchConnection, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to open search connection: %s\n", sqlite3_errmsg(searchConnection));
+			sqlite3_close(searchConnection);
+			searchConnection = nullptr;
+			return;
+		}
+		sqlite3_busy_timeout(searchConnection, 5000);
+
+		char* error = nullptr;
+		if (sqlite3_exec(searchConnection, DROP_UNUSED_SCHEMA, nullptr, nullptr, &error) != SQLITE_OK)
+		{
+			printf("[db]: failed to drop unused tables: %s\n", error);
+			sqlite3_free(error);
+		}
+	}
+
+	// thumbnails and previews are written by worker threads and read while browsing, they get their
+	// own connection so they never wait behind the scanner or a search
+	static sqlite3* cacheConnection = nullptr;
+	static sqlite3_stmt* selectThumbnail = nullptr;
+	static sqlite3_stmt* replaceThumbnail = nullptr;
+	static sqlite3_stmt* selectPreview = nullptr;
+	static sqlite3_stmt* replacePreview = nullptr;
+	static sqlite3_stmt* selectWaveform = nullptr;
+	static sqlite3_stmt* replaceWaveform = nullptr;
+	static sqlite3_stmt* selectMissingWaveforms = nullptr;
+	static sqlite3_stmt* replaceFingerprint = nullptr;
+	static std::mutex cacheMutex;
+
+	static const char* CACHE_SCHEMA =
+		"CREATE TABLE IF NOT EXISTS thumbnails ("
+		"	file_id INTEGER PRIMARY KEY, mtime INTEGER NOT NULL,"
+		"	width INTEGER NOT NULL, height INTEGER NOT NULL, pixels BLOB NOT NULL);"
+
+		"CREATE TRIGGER IF NOT EXISTS thumbnails_delete AFTER DELETE ON files BEGIN"
+		"	DELETE FROM thumbnails WHERE file_id = old.id;"
+		"END;"
+
+		// keyed by path hash, the texture preview only knows the path
+		"CREATE TABLE IF NOT EXISTS previews ("
+		"	path_hash INTEGER PRIMARY KEY, mtime INTEGER NOT NULL, format INTEGER NOT NULL,"
+		"	width INTEGER NOT NULL, height INTEGER NOT NULL, levels INTEGER NOT NULL, data BLOB NOT NULL);"
+
+		"CREATE TABLE IF NOT EXISTS waveforms ("
+		"	file_id INTEGER PRIMARY KEY, mtime INTEGER NOT NULL, sample_rate INTEGER NOT NULL, channels INTEGER NOT NULL,"
+		"	length_frames INTEGER NOT NULL, rms_db REAL NOT NULL, peak_db REAL NOT NULL,"
+		"	base_buckets INTEGER NOT NULL, levels INTEGER NOT NULL, peaks BLOB NOT NULL);"
+
+		"CREATE TRIGGER IF NOT EXISTS waveforms_delete AFTER DELETE ON files BEGIN"
+		"	DELETE FROM waveforms WHERE file_id = old.id;"
+		"END;"
+
+		// AUDIO_FINGERPRINT_SIZE floats, empty for silent or undecodable files
+		"CREATE TABLE IF NOT EXISTS fingerprints ("
+		"	file_id INTEGER PRIMARY KEY, mtime INTEGER NOT NULL, data BLOB NOT NULL);"
+
+		"CREATE TRIGGER IF NOT EXISTS fingerprints_delete AFTER DELETE ON files BEGIN"
+		"	DELETE FROM fingerprints WHERE file_id = old.id;"
+		"END;";
+
+	static void InitCache()
+	{
+		if (sqlite3_open_v2(DB_PATH, &cacheConnection, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to open cache connection: %s\n", sqlite3_errmsg(cacheConnection));
+			sqlite3_close(cacheConnection);
+			cacheConnection = nullptr;
+			return;
+		}
+		sqlite3_busy_timeout(cacheConnection, 5000);
+		sqlite3_exec(cacheConnection, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
+
+		char* error = nullptr;
+		if (sqlite3_exec(cacheConnection, CACHE_SCHEMA, nullptr, nullptr, &error) != SQLITE_OK)
+		{
+			printf("[db]: failed to create cache tables: %s\n", error);
+			sqlite3_free(error);
+			return;
+		}
+
+		sqlite3_prepare_v2(cacheConnection,
+			"SELECT width, height, pixels FROM thumbnails WHERE file_id = ?1 AND mtime = ?2",
+			-1, &selectThumbnail, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"INSERT OR REPLACE INTO thumbnails (file_id, mtime, width, height, pixels) VALUES (?1, ?2, ?3, ?4, ?5)",
+			-1, &replaceThumbnail, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"SELECT format, width, height, levels, data FROM previews WHERE path_hash = ?1 AND mtime = ?2",
+			-1, &selectPreview, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"INSERT OR REPLACE INTO previews (path_hash, mtime, format, width, height, levels, data) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)",
+			-1, &replacePreview, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"SELECT sample_rate, channels, length_frames, rms_db, peak_db, base_buckets, levels, peaks FROM waveforms"
+			" WHERE file_id = ?1 AND mtime = ?2",
+			-1, &selectWaveform, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"INSERT OR REPLACE INTO waveforms (file_id, mtime, sample_rate, channels, length_frames, rms_db, peak_db, base_buckets, levels, peaks)"
+			" VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)",
+			-1, &replaceWaveform, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"SELECT f.id, f.path, f.mtime FROM files f"
+			" LEFT JOIN waveforms w ON w.file_id = f.id AND w.mtime = f.mtime"
+			" LEFT JOIN fingerprints p ON p.file_id = f.id AND p.mtime = f.mtime"
+			" WHERE f.type = ?1 AND (w.file_id IS NULL OR p.file_id IS NULL)",
+			-1, &selectMissingWaveforms, nullptr);
+		sqlite3_prepare_v2(cacheConnection,
+			"INSERT OR REPLACE INTO fingerprints (file_id, mtime, data) VALUES (?1, ?2, ?3)",
+			-1, &replaceFingerprint, nullptr);
+	}
+
+	// tags are written in bulk from a background thread and loaded once into bitmaps, raw statements
+	// on their own connection keep a 100k row tagging off the storage mutex the scanner needs
+	static sqlite3* tagConnection = nullptr;
+	static sqlite3_stmt* selectTagId = nullptr;
+	static sqlite3_stmt* insertTag = nullptr;
+	static sqlite3_stmt* insertFileTag = nullptr;
+	static sqlite3_stmt* deleteFileTag = nullptr;
+	static std::mutex tagMutex;
+
+	static const char* TAG_SCHEMA =
+		// tagging the same file twice is a no op, and the tag -> files load is an index scan
+		"CREATE UNIQUE INDEX IF NOT EXISTS idx_fileTags_tag_file ON fileTags(tag_id, file_id);"
+		"CREATE INDEX IF NOT EXISTS idx_fileTags_file ON fileTags(file_id);"
+
+		"CREATE TRIGGER IF NOT EXISTS fileTags_delete AFTER DELETE ON files BEGIN"
+		"	DELETE FROM fileTags WHERE file_id = old.id;"
+		"END;";
+
+	static void InitTags()
+	{
+		if (sqlite3_open_v2(DB_PATH, &tagConnection, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to open tag connection: %s\n", sqlite3_errmsg(tagConnection));
+			sqlite3_close(tagConnection);
+			tagConnection = nullptr;
+			return;
+		}
+		sqlite3_busy_timeout(tagConnection, 5000);
+		sqlite3_exec(tagConnection, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
+
+		char* error = nullptr;
+		if (sqlite3_exec(tagConnection, TAG_SCHEMA, nullptr, nullptr, &error) != SQLITE_OK)
+		{
+			printf("[db]: failed to create tag indices: %s\n", error);
+			sqlite3_free(error);
+			return;
+		}
+
+		sqlite3_prepare_v2(tagConnection, "SELECT id FROM tags WHERE name = ?1", -1, &selectTagId, nullptr);
+		sqlite3_prepare_v2(tagConnection, "INSERT INTO tags (name) VALUES (?1)", -1, &insertTag, nullptr);
+		sqlite3_prepare_v2(tagConnection,
+			"INSERT OR IGNORE INTO fileTags (file_id, tag_id) VALUES (?1, ?2)",
+			-1, &insertFileTag, nullptr);
+		sqlite3_prepare_v2(tagConnection,
+			"DELETE FROM fileTags WHERE tag_id = ?2 AND file_id = ?1",
+			-1, &deleteFileTag, nullptr);
+	}
+
+	void Init()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+		storage.sync_schema();
+
+		InitSearchConnection();
+		InitCache();
+		InitTags();
+	}
+
+	void Checkpoint()
+	{
+		std::lock_guard<std::mutex> lock(searchMutex);
+		if (!searchConnection)
+		{
+			return;
+		}
+
+		char* error = nullptr;
+		if (sqlite3_exec(searchConnection, "PRAGMA wal_checkpoint(TRUNCATE)", nullptr, nullptr, &error) != SQLITE_OK)
+		{
+			printf("[db]: checkpoint failed: %s\n", error);
+			sqlite3_free(error);
+		}
+	}
+
+	const char* GetPath()
+	{
+		return DB_PATH;
+	}
+
+	bool GetThumbnail(int fileId, int64_t mtime, Thumbnail& outThumbnail)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!selectThumbnail)
+		{
+			return false;
+		}
+
+		sqlite3_bind_int(selectThumbnail, 1, fileId);
+		sqlite3_bind_int64(selectThumbnail, 2, mtime);
+
+		bool bFound = false;
+		if (sqlite3_step(selectThumbnail) == SQLITE_ROW)
+		{
+			outThumbnail.width = sqlite3_column_int(selectThumbnail, 0);
+			outThumbnail.height = sqlite3_column_int(selectThumbnail, 1);
+
+			const unsigned char* pixels = (const unsigned char*)sqlite3_column_blob(selectThumbnail, 2);
+			const int size = sqlite3_column_bytes(selectThumbnail, 2);
+
+			// a row that doesn't match its dimensions gets regenerated. 0x0 marks a source that couldn't be decoded
+			if (outThumbnail.width == 0 && outThumbnail.height == 0 && size == 0)
+			{
+				outThumbnail.pixels.clear();
+				bFound = true;
+			}
+			else if (pixels && size == outThumbnail.width * outThumbnail.height * 4)
+			{
+				outThumbnail.pixels.assign(pixels, pixels + size);
+				bFound = true;
+			}
+		}
+		sqlite3_reset(selectThumbnail);
+		return bFound;
+	}
+
+	void PutThumbnail(int fileId, int64_t mtime, const Thumbnail& thumbnail)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!replaceThumbnail)
+		{
+			return;
+		}
+
+		sqlite3_bind_int(replaceThumbnail, 1, fileId);
+		sqlite3_bind_int64(replaceThumbnail, 2, mtime);
+		sqlite3_bind_int(replaceThumbnail, 3, thumbnail.width);
+		sqlite3_bind_int(replaceThumbnail, 4, thumbnail.height);
+		if (thumbnail.pixels.empty())
+		{
+			// a null pointer would bind NULL, the column wants an empty blob
+			sqlite3_bind_zeroblob(replaceThumbnail, 5, 0);
+		}
+		else
+		{
+			sqlite3_bind_blob(replaceThumbnail, 5, thumbnail.pixels.data(), (int)thumbnail.pixels.size(), SQLITE_STATIC);
+		}
+
+		if (sqlite3_step(replaceThumbnail) != SQLITE_DONE)
+		{
+			printf("[db]: failed to store thumbnail: %s\n", sqlite3_errmsg(cacheConnection));
+		}
+		sqlite3_reset(replaceThumbnail);
+		sqlite3_clear_bindings(replaceThumbnail);
+	}
+
+	bool GetPreview(uint64_t pathHash, int64_t mtime, Preview& outPreview)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!selectPreview)
+		{
+			return false;
+		}
+
+		sqlite3_bind_int64(selectPreview, 1, (sqlite3_int64)pathHash);
+		sqlite3_bind_int64(selectPreview, 2, mtime);
+
+		bool bFound = false;
+		if (sqlite3_step(selectPreview) == SQLITE_ROW)
+		{
+			outPreview.format = sqlite3_column_int(selectPreview, 0);
+			outPreview.width = sqlite3_column_int(selectPreview, 1);
+			outPreview.height = sqlite3_column_int(selectPreview, 2);
+			outPreview.levels = sqlite3_column_int(selectPreview, 3);
+
+			const unsigned char* data = (const unsigned char*)sqlite3_column_blob(selectPreview, 4);
+			const int size = sqlite3_column_bytes(selectPreview, 4);
+			if (data && size > 0)
+			{
+				outPreview.data.assign(data, data + size);
+				bFound = true;
+			}
+		}
+		sqlite3_reset(selectPreview);
+		return bFound;
+	}
+
+	void PutPreview(uint64_t pathHash, int64_t mtime, const Preview& preview)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!replacePreview)
+		{
+			return;
+		}
+
+		sqlite3_bind_int64(replacePreview, 1, (sqlite3_int64)pathHash);
+		sqlite3_bind_int64(replacePreview, 2, mtime);
+		sqlite3_bind_int(replacePreview, 3, preview.format);
+		sqlite3_bind_int(replacePreview, 4, preview.width);
+		sqlite3_bind_int(replacePreview, 5, preview.height);
+		sqlite3_bind_int(replacePreview, 6, preview.levels);
+		sqlite3_bind_blob(replacePreview, 7, preview.data.data(), (int)preview.data.size(), SQLITE_STATIC);
+
+		if (sqlite3_step(replacePreview) != SQLITE_DONE)
+		{
+			printf("[db]: failed to store preview: %s\n", sqlite3_errmsg(cacheConnection));
+		}
+		sqlite3_reset(replacePreview);
+		sqlite3_clear_bindings(replacePreview);
+	}
+
+	bool GetWaveform(int fileId, int64_t mtime, Waveform& outWaveform)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!selectWaveform)
+		{
+			return false;
+		}
+
+		sqlite3_bind_int(selectWaveform, 1, fileId);
+		sqlite3_bind_int64(selectWaveform, 2, mtime);
+
+		bool bFound = false;
+		if (sqlite3_step(selectWaveform) == SQLITE_ROW)
+		{
+			outWaveform.sampleRate = (uint32_t)sqlite3_column_int64(selectWaveform, 0);
+			outWaveform.channels = (uint32_t)sqlite3_column_int(selectWaveform, 1);
+			outWaveform.lengthFrames = (uint64_t)sqlite3_column_int64(selectWaveform, 2);
+			outWaveform.rmsDb = (float)sqlite3_column_double(selectWaveform, 3);
+			outWaveform.peakDb = (float)sqlite3_column_double(selectWaveform, 4);
+			outWaveform.baseBuckets = sqlite3_column_int(selectWaveform, 5);
+			outWaveform.levels = sqlite3_column_int(selectWaveform, 6);
+
+			const int8_t* peaks = (const int8_t*)sqlite3_column_blob(selectWaveform, 7);
+			const int size = sqlite3_column_bytes(selectWaveform, 7);
+
+			// a pyramid that doesn't add up gets regenerated
+			int expectedSize = 0;
+			for (int level = 0; level < outWaveform.levels; level++)
+			{
+				expectedSize += 2 * std::max(1, outWaveform.baseBuckets >> level);
+			}
+			if (size == expectedSize)
+			{
+				outWaveform.peaks.assign(peaks, peaks + size);
+				bFound = true;
+			}
+		}
+		sqlite3_reset(selectWaveform);
+		return bFound;
+	}
+
+	void PutWaveform(int fileId, int64_t mtime, const Waveform& waveform)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!replaceWaveform)
+		{
+			return;
+		}
+
+		sqlite3_bind_int(replaceWaveform, 1, fileId);
+		sqlite3_bind_int64(replaceWaveform, 2, mtime);
+		sqlite3_bind_int64(replaceWaveform, 3, waveform.sampleRate);
+		sqlite3_bind_int(replaceWaveform, 4, (int)waveform.channels);
+		sqlite3_bind_int64(replaceWaveform, 5, (sqlite3_int64)waveform.lengthFrames);
+		sqlite3_bind_double(replaceWaveform, 6, waveform.rmsDb);
+		sqlite3_bind_double(replaceWaveform, 7, waveform.peakDb);
+		sqlite3_bind_int(replaceWaveform, 8, waveform.baseBuckets);
+		sqlite3_bind_int(replaceWaveform, 9, waveform.levels);
+		// a null blob would violate NOT NULL
+		if (waveform.peaks.empty()) sqlite3_bind_zeroblob(replaceWaveform, 10, 0);
+		else sqlite3_bind_blob(replaceWaveform, 10, waveform.peaks.data(), (int)waveform.peaks.size(), SQLITE_STATIC);
+
+		if (sqlite3_step(replaceWaveform) != SQLITE_DONE)
+		{
+			printf("[db]: failed to store waveform: %s\n", sqlite3_errmsg(cacheConnection));
+		}
+		sqlite3_reset(replaceWaveform);
+		sqlite3_clear_bindings(replaceWaveform);
+	}
+
+	void PutAudioFingerprint(int fileId, int64_t mtime, const std::vector<float>& fingerprint)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!replaceFingerprint)
+		{
+			return;
+		}
+
+		sqlite3_bind_int(replaceFingerprint, 1, fileId);
+		sqlite3_bind_int64(replaceFingerprint, 2, mtime);
+		if (fingerprint.empty()) sqlite3_bind_zeroblob(replaceFingerprint, 3, 0);
+		else sqlite3_bind_blob(replaceFingerprint, 3, fingerprint.data(), (int)(fingerprint.size() * sizeof(float)), SQLITE_STATIC);
+
+		if (sqlite3_step(replaceFingerprint) != SQLITE_DONE)
+		{
+			printf("[db]: failed to store fingerprint: %s\n", sqlite3_errmsg(cacheConnection));
+		}
+		sqlite3_reset(replaceFingerprint);
+		sqlite3_clear_bindings(replaceFingerprint);
+	}
+
+	std::vector<AnalysisTarget> GetFilesWithoutWaveform()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::vector<AnalysisTarget> targets;
+		if (!selectMissingWaveforms)
+		{
+			return targets;
+		}
+
+		sqlite3_bind_text(selectMissingWaveforms, 1, AUDIO_FILE_TYPE, -1, SQLITE_STATIC);
+		while (sqlite3_step(selectMissingWaveforms) == SQLITE_ROW)
+		{
+			AnalysisTarget target;
+			target.id = sqlite3_column_int(selectMissingWaveforms, 0);
+			const unsigned char* path = sqlite3_column_text(selectMissingWaveforms, 1);
+			target.path = path ? (const char*)path : "";
+			target.mtime = sqlite3_column_int64(selectMissingWaveforms, 2);
+			targets.push_back(std::move(target));
+		}
+		sqlite3_reset(selectMissingWaveforms);
+		return targets;
+	}
+
+	std::vector<Tag> GetTags()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+		return storage.get_all<Tag>();
+	}
+
+	int GetOrCreateTag(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(tagMutex);
+		if (!selectTagId || !insertTag)
+		{
+			return -1;
+		}
+
+		int id = -1;
+		sqlite3_bind_text(selectTagId, 1, name.c_str(), (int)name.size(), SQLITE_STATIC);
+		if (sqlite3_step(selectTagId) == SQLITE_ROW)
+		{
+			id = sqlite3_column_int(selectTagId, 0);
+		}
+		sqlite3_reset(selectTagId);
+
+		if (id < 0)
+		{
+			sqlite3_bind_text(insertTag, 1, name.c_str(), (int)name.size(), SQLITE_STATIC);
+			if (sqlite3_step(insertTag) == SQLITE_DONE)
+			{
+				id = (int)sqlite3_last_insert_rowid(tagConnection);
+			}
+			else
+			{
+				printf("[db]: failed to create tag [%s]: %s\n", name.c_str(), sqlite3_errmsg(tagConnection));
+			}
+			sqlite3_reset(insertTag);
+		}
+		return id;
+	}
+
+	void VisitFileTags(const std::function<void(int tagId, int fileId)>& visitor)
+	{
+		std::lock_guard<std::mutex> lock(tagMutex);
+		if (!tagConnection)
+		{
+			return;
+		}
+
+		// straight off idx_fileTags_tag_file, every tag's files come out sorted
+		sqlite3_stmt* statement = nullptr;
+		if (sqlite3_prepare_v2(tagConnection, "SELECT tag_id, file_id FROM fileTags ORDER BY tag_id, file_id", -1, &statement, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to prepare tag visit: %s\n", sqlite3_errmsg(tagConnection));
+			return;
+		}
+
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			visitor(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1));
+		}
+		sqlite3_finalize(statement);
+	}
+
+	// one transaction for the whole batch, the statement is rebound per file
+	static void StepFileTags(sqlite3_stmt* statement, int tagId, const std::vector<int>& fileIds, const char* action)
+	{
+		std::lock_guard<std::mutex> lock(tagMutex);
+		if (!statement)
+		{
+			return;
+		}
+
+		sqlite3_exec(tagConnection, "BEGIN", nullptr, nullptr, nullptr);
+		sqlite3_bind_int(statement, 2, tagId);
+		for (int fileId : fileIds)
+		{
+			sqlite3_bind_int(statement, 1, fileId);
+			if (sqlite3_step(statement) != SQLITE_DONE)
+			{
+				printf("[db]: failed to %s file %d: %s\n", action, fileId, sqlite3_errmsg(tagConnection));
+			}
+			sqlite3_reset(statement);
+		}
+		sqlite3_clear_bindings(statement);
+		if (sqlite3_exec(tagConnection, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to commit tags: %s\n", sqlite3_errmsg(tagConnection));
+			sqlite3_exec(tagConnection, "ROLLBACK", nullptr, nullptr, nullptr);
+		}
+	}
+
+	void TagFiles(int tagId, const std::vector<int>& fileIds)
+	{
+		StepFileTags(insertFileTag, tagId, fileIds, "tag");
+	}
+
+	void UntagFiles(int tagId, const std::vector<int>& fileIds)
+	{
+		StepFileTags(deleteFileTag, tagId, fileIds, "untag");
+	}
+
+	std::vector<FileFingerprint> GetFileFingerprints()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+
+		auto rows = storage.select(columns(&File::id, &File::directory, &File::name, &File::mtime, &File::size, &File::codec));
+
+		std::vector<FileFingerprint> fingerprints;
+		fingerprints.reserve(rows.size());
+		for (auto& row : rows)
+		{
+			FileFingerprint fingerprint;
+			fingerprint.id = std::get<0>(row);
+			fingerprint.directory = std::move(std::get<1>(row));
+			fingerprint.name = std::move(std::get<2>(row));
+			fingerprint.mtime = std::get<3>(row);
+			fingerprint.size = std::get<4>(row);
+			fingerprint.bProbed = !std::get<5>(row).empty();
+			fingerprints.push_back(std::move(fingerprint));
+		}
+		return fingerprints;
+	}
+
+	std::vector<HashTarget> GetHashTargets()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+
+		auto rows = storage.select(columns(&File::id, &File::path, &File::size, &File::mtime, &File::contentHash, &File::hashMtime),
+			where(c(&File::size) > 0));
+
+		std::vector<HashTarget> targets;
+		targets.reserve(rows.size());
+		for (auto& row : rows)
+		{
+			HashTarget target;
+			target.id = std::get<0>(row);
+			target.path = std::move(std::get<1>(row));
+			target.size = std::get<2>(row);
+			target.mtime = std::get<3>(row);
+			// the file changed since it was hashed
+			target.contentHash = std::get<5>(row) == target.mtime ? (uint64_t)std::get<4>(row) : 0;
+			targets.push_back(std::move(target));
+		}
+		return targets;
+	}
+
+	std::vector<ImageHashTarget> GetImagesWithoutPerceptualHash()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+
+		auto rows = storage.select(columns(&File::id, &File::path, &File::mtime),
+			where(is_equal(&File::type, TEXTURE_FILE_TYPE) and is_not_equal(&File::perceptualMtime, &File::mtime)));
+
+		std::vector<ImageHashTarget> targets;
+		targets.reserve(rows.size());
+		for (auto& row : rows)
+		{
+			ImageHashTarget target;
+			target.id = std::get<0>(row);
+			target.path = std::move(std::get<1>(row));
+			target.mtime = std::get<2>(row);
+			targets.push_back(std::move(target));
+		}
+		return targets;
+	}
+
+	std::vector<Directory> GetDirectories()
+	{
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+		return storage.get_all<Directory>();
+	}
+
+	void VisitFiles(const std::function<void(const FileView&)>& visitor)
+	{
+		std::lock_guard<std::mutex> lock(searchMutex);
+		if (!searchConnection)
+		{
+			return;
+		}
+
+		sqlite3_stmt* statement = nullptr;
+		if (sqlite3_prepare_v2(searchConnection, "SELECT f.id, f.name, f.path, f.type, f.size, f.mtime, f.duration_ms, f.sample_rate, f.channels,"
+			" f.codec, f.width, f.height, f.components, CASE WHEN f.perceptual_mtime = f.mtime THEN f.perceptual_hash ELSE 0 END, p.data"
+			" FROM files f LEFT JOIN fingerprints p ON p.file_id = f.id AND p.mtime = f.mtime", -1, &statement, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to prepare file visit: %s\n", sqlite3_errmsg(searchConnection));
+			return;
+		}
+
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			FileView view;
+			view.id = sqlite3_column_int(statement, 0);
+			view.name = (const char*)sqlite3_column_text(statement, 1);
+			view.path = (const char*)sqlite3_column_text(statement, 2);
+			view.type = (const char*)sqlite3_column_text(statement, 3);
+			view.size = (size_t)sqlite3_column_int64(statement, 4);
+			view.mtime = sqlite3_column_int64(statement, 5);
+			view.durationMs = sqlite3_column_int64(statement, 6);
+			view.sampleRate = sqlite3_column_int(statement, 7);
+			view.channels = sqlite3_column_int(statement, 8);
+			view.codec = (const char*)sqlite3_column_text(statement, 9);
+			view.width = sqlite3_column_int(statement, 10);
+			view.height = sqlite3_column_int(statement, 11);
+			view.components = sqlite3_column_int(statement, 12);
+			view.perceptualHash = (uint64_t)sqlite3_column_int64(statement, 13);
+			const bool bHasFingerprint = sqlite3_column_bytes(statement, 14) == AUDIO_FINGERPRINT_SIZE * (int)sizeof(float);
+			view.fingerprint = bHasFingerprint ? sqlite3_column_blob(statement, 14) : nullptr;
+
+			if (view.name && view.path && view.type && view.codec)
+			{
+				visitor(view);
+			}
+		}
+		sqlite3_finalize(statement);
+	}
+
+	std::vector<std::pair<std::string, int>> GetFileIds(const std::vector<std::string>& paths)
+	{
+		std::vector<std::pair<std::string, int>> ids;
+		if (paths.empty())
+		{
+			return ids;
+		}
+
+		std::lock_guard<std::recursive_mutex> lock(storageMutex);
+
+		// stay well below sqlite's bound parameter limit
+		const size_t chunkSize = 500;
+		for (size_t begin = 0; begin < paths.size(); begin += chunkSize)
+		{
+			const size_t end = std::min(begin + chunkSize, paths.size());
+			const std::vector<std::string> chunk(paths.begin() + begin, paths.begin() + end);
+
+			auto rows = storage.select(columns(&File::path, &File::id), where(in(&File::path, chunk)));
+			for (auto& row : rows)
+			{
+				ids.emplace_back(std::move(std::get<0>(row)), std::get<1>(row));
+			}
+		}
+		return ids;
+	}
+
+	static const char* FILE_COLUMNS = "(name, path, ext, size, type, dir, mtime, duration_ms, sample_rate, channels, codec, width, height, components)"
+		" VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13, ?14)";
+
+	BulkWriter::BulkWriter(size_t chunkSize)
+		: chunkSize(chunkSize)
+	{
+		if (sqlite3_open_v2(DB_PATH, &connection, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to open [%s]: %s\n", DB_PATH, sqlite3_errmsg(connection));
+			sqlite3_close(connection);
+			connection = nullptr;
+			return;
+		}
+
+		// wal is persistent in the file and lets the ui keep reading while a chunk is written.
+		// synchronous/cache_size only apply to this connection, i.e. the ingest window
+		sqlite3_busy_timeout(connection, 5000);
+		Execute("PRAGMA journal_mode=WAL");
+		Execute("PRAGMA synchronous=NORMAL");
+		Execute("PRAGMA cache_size=-65536");  // 64mb
+		Execute("PRAGMA temp_store=MEMORY");
+
+		const std::string upsertSql = std::string("INSERT INTO files ") + FILE_COLUMNS +
+			" ON CONFLICT(path) DO UPDATE SET name = excluded.name, ext = excluded.ext, size = excluded.size,"
+			" type = excluded.type, dir = excluded.dir, mtime = excluded.mtime, duration_ms = excluded.duration_ms,"
+			" sample_rate = excluded.sample_rate, channels = excluded.channels, codec = excluded.codec,"
+			" width = excluded.width, height = excluded.height, components = excluded.components";
+
+		upsertFile = Prepare(upsertSql.c_str());
+		removeFile = Prepare("DELETE FROM files WHERE id = ?1");
+		// everything below "a/b" sorts in ["a/b/", "a/b0"), a range the dir index and the path key can answer
+		removeDirectoryFiles = Prepare("DELETE FROM files WHERE dir = ?1 OR (dir >= ?2 AND dir < ?3)");
+		removeDirectories = Prepare("DELETE FROM directories WHERE path = ?1 OR (path >= ?2 AND path < ?3)");
+		replaceDirectory = Prepare("INSERT OR REPLACE INTO directories (path, parent, mtime) VALUES (?1, ?2, ?3)");
+		insertDirectory = Prepare("INSERT OR IGNORE INTO directories (path, parent, mtime) VALUES (?1, ?2, ?3)");
+		updateContentHash = Prepare("UPDATE files SET content_hash = ?2, hash_mtime = ?3 WHERE id = ?1");
+		updatePerceptualHash = Prepare("UPDATE files SET perceptual_hash = ?2, perceptual_mtime = ?3 WHERE id = ?1");
+	}
+
+	BulkWriter::~BulkWriter()
+	{
+		if (!connection)
+		{
+			return;
+		}
+
+		sqlite3_finalize(upsertFile);
+		sqlite3_finalize(removeFile);
+		sqlite3_finalize(removeDirectoryFiles);
+		sqlite3_finalize(removeDirectories);
+		sqlite3_finalize(replaceDirectory);
+		sqlite3_finalize(insertDirectory);
+		sqlite3_finalize(updateContentHash);
+		sqlite3_finalize(updatePerceptualHash);
+		sqlite3_close(connection);
+	}
+
+	bool BulkWriter::Execute(const char* sql)
+	{
+		char* error = nullptr;
+		if (sqlite3_exec(connection, sql, nullptr, nullptr, &error) != SQLITE_OK)
+		{
+			printf("[db]: [%s] failed: %s\n", sql, error);
+			sqlite3_free(error);
+			return false;
+		}
+		return true;
+	}
+
+	sqlite3_stmt* BulkWriter::Prepare(const char* sql)
+	{
+		sqlite3_stmt* statement = nullptr;
+		if (sqlite3_prepare_v2(connection, sql, -1, &statement, nullptr) != SQLITE_OK)
+		{
+			printf("[db]: failed to prepare [%s]: %s\n", sql, sqlite3_errmsg(connection));
+		}
+		return statement;
+	}
+
+	void BulkWriter::BindFile(sqlite3_stmt* statement, const File& file)
+	{
+		// SQLITE_STATIC: the strings outlive the step
+		sqlite3_bind_text(statement, 1, file.name.c_str(), (int)file.name.size(), SQLITE_STATIC);
+		sqlite3_bind_text(statement, 2, file.path.c_str(), (int)file.path.size(), SQLITE_STATIC);
+		sqlite3_bind_text(statement, 3, file.ext.c_str(), (int)file.ext.size(), SQLITE_STATIC);
+		sqlite3_bind_int64(statement, 4, (sqlite3_int64)file.size);
+		sqlite3_bind_text(statement, 5, file.type.c_str(), (int)file.type.size(), SQLITE_STATIC);
+		sqlite3_bind_text(statement, 6, file.directory.c_str(), (int)file.directory.size(), SQLITE_STATIC);
+		sqlite3_bind_int64(statement, 7, (sqlite3_int64)file.mtime);
+		sqlite3_bind_int64(statement, 8, (sqlite3_int64)file.durationMs);
+		sqlite3_bind_int(statement, 9, file.sampleRate);
+		sqlite3_bind_int(statement, 10, file.channels);
+		sqlite3_bind_text(statement, 11, file.codec.c_str(), (int)file.codec.size(), SQLITE_STATIC);
+		sqlite3_bind_int(statement, 12, file.width);
+		sqlite3_bind_int(statement, 13, file.height);
+		sqlite3_bind_int(statement, 14, file.components);
+	}
+
+	bool BulkWriter::Step(sqlite3_stmt* statement)
+	{
+		const int result = sqlite3_step(statement);
+		if (result != SQLITE_DONE)
+		{
+			printf("[db]: step failed: %s\n", sqlite3_errmsg(connection));
+		}
+		sqlite3_reset(statement);
+		sqlite3_clear_bindings(statement);
+		return result == SQLITE_DONE;
+	}
+
+	void BulkWriter::BeginChunk()
+	{
+		if (bInChunk)
+		{
+			return;
+		}
+
+		// writes from the sqlite_orm connection are serialized by the same mutex
+		storageMutex.lock();
+		Execute("BEGIN");
+		bInChunk = true;
+		chunkRows = 0;
+	}
+
+	void BulkWriter::EndChunk()
+	{
+		if (!bInChunk)
+		{
+			return;
+		}
+
+		Execute("COMMIT");
+		bInChunk = false;
+		storageMutex.unlock();
+	}
+
+	void BulkWriter::CountRow()
+	{
+		if (++chunkRows >= chunkSize)
+		{
+			EndChunk();
+			BeginChunk();
+		}
+	}
+
+	void BulkWriter::ApplyScanChanges(const ScanChanges& changes)
+	{
+		if (!IsValid())
+		{
+			return;
+		}
+
+		BeginChunk();
+
+		for (const auto& path : changes.removedDirectories)
+		{
+			// '0' is the character after '/'
+			const std::string lower = path + "/";
+			const std::string upper = path + "0";
+			for (sqlite3_stmt* statement : { removeDirectoryFiles, removeDirectories })
+			{
+				sqlite3_bind_text(statement, 1, path.c_str(), (int)path.size(), SQLITE_STATIC);
+				sqlite3_bind_text(statement, 2, lower.c_str(), (int)lower.size(), SQLITE_STATIC);
+				sqlite3_bind_text(statement, 3, upper.c_str(), (int)upper.size(), SQLITE_STATIC);
+				Step(statement);
+			}
+			CountRow();
+		}
+
+		for (int id : changes.removedFileIds)
+		{
+			sqlite3_bind_int(removeFile, 1, id);
+			Step(removeFile);
+			CountRow();
+		}
+
+		for (const auto& file : changes.upserts)
+		{
+			BindFile(upsertFile, file);
+			Step(upsertFile);
+			CountRow();
+		}
+
+		for (const auto& directory : changes.directories)
+		{
+			sqlite3_stmt* statement = directory.mtime < 0 ? insertDirectory : replaceDirectory;
+			sqlite3_bind_text(statement, 1, directory.path.c_str(), (int)directory.path.size(), SQLITE_STATIC);
+			sqlite3_bind_text(statement, 2, directory.parent.c_str(), (int)directory.parent.size(), SQLITE_STATIC);
+			sqlite3_bind_int64(statement, 3, (sqlite3_int64)directory.mtime);
+			Step(statement);
+			CountRow();
+		}
+
+		EndChunk();
+	}
+
+	void BulkWriter::PutHashes(sqlite3_stmt* statement, const std::vector<FileHash>& hashes)
+	{
+		if (!IsValid())
+		{
+			return;
+		}
+
+		BeginChunk();
+		for (const auto& hash : hashes)
+		{
+			sqlite3_bind_int(statement, 1, hash.id);
+			// stored bit for bit in the signed column
+			sqlite3_bind_int64(statement, 2, (sqlite3_int64)hash.hash);
+			sqlite3_bind_int64(statement, 3, (sqlite3_int64)hash.mtime);
+			Step(statement);
+			CountRow();
+		}
+		EndChunk();
+	}
+
+	void BulkWriter::PutContentHashes(const std::vector<FileHash>& hashes)
+	{
+		PutHashes(updateContentHash, hashes);
+	}
+
+	void BulkWriter::PutPerceptualHashes(const std::vector<FileHash>& hashes)
+	{
+		PutHashes(updatePerceptualHash, hashes);
+	}
+}
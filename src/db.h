@@ -0,0 +1,328 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cute_files.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace db {
+
+	constexpr const char* AUDIO_FILE_TYPE = "audio";
+	constexpr const char* TEXTURE_FILE_TYPE = "texture";
+
+	// floats in an audio fingerprint, see FingerprintBuilder
+	static const int AUDIO_FINGERPRINT_SIZE = 32;
+
+	// codec stored for files whose header couldn't be parsed, so they aren't probed again until they change
+	constexpr const char* UNKNOWN_CODEC = "unknown";
+
+	struct File
+	{
+		int id = -1;
+		std::string name;
+		std::string path;
+		std::string ext;
+		std::string type;  // using strings for now,  enum binding is too much work
+		std::string directory;
+		size_t size;
+		int64_t mtime = 0;  // last write time, together with size used to detect changes on rescan
+
+		// header, parsed at scan time. codec stays empty until the file was probed
+		std::string codec;
+		int64_t durationMs = 0;  // audio
+		int sampleRate = 0;
+		int channels = 0;
+		int width = 0;           // textures
+		int height = 0;
+		int components = 0;
+
+		// xxh64 of the whole file, only hashed when another file has the same size.
+		// valid while hashMtime matches mtime
+		int64_t contentHash = 0;
+		int64_t hashMtime = 0;
+
+		// 64 bit dhash of a texture, valid while perceptualMtime matches mtime.
+		// 0 for images that couldn't be decoded, or are flat and have nothing to compare
+		int64_t perceptualHash = 0;
+		int64_t perceptualMtime = 0;
+
+		File()
+		{
+		}
+
+		File(const cf_file_t& rawFile)
+			:name(rawFile.name), path(rawFile.path),
+			ext(rawFile.ext), size(rawFile.size)
+		{
+			const size_t last_slash_idx = path.rfind('/');
+			if (std::string::npos != last_slash_idx)
+			{
+				directory = path.substr(0, last_slash_idx);
+			}
+		}
+	};
+
+	struct Tag
+	{
+		int id = -1;
+		std::string name;
+	};
+
+	struct FileTag
+	{
+		int id = -1;
+		int file_id;
+		int tag_id;
+	};
+
+	// per directory fingerprint. a directory's mtime changes when entries are added, removed or renamed,
+	// so a matching mtime means its listing doesn't need to be diffed again
+	struct Directory
+	{
+		std::string path;
+		std::string parent;
+		int64_t mtime = 0;
+	};
+
+	struct FileFingerprint
+	{
+		int id = -1;
+		std::string directory;
+		std::string name;
+		int64_t mtime = 0;
+		size_t size = 0;
+		bool bProbed = false;  // has a codec, i.e. its header was read since the last change
+	};
+
+	// everything a rescan found out, applied in a single transaction
+	struct ScanChanges
+	{
+		std::vector<File> upserts;  // inserted, or updated in place when the path exists
+		std::vector<int> removedFileIds;
+		std::vector<std::string> removedDirectories;  // removes the whole subtree
+		std::vector<Directory> directories;  // mtime -1 marks a placeholder, only written if the path isn't known yet
+
+		bool empty() const
+		{
+			return upserts.empty() && removedFileIds.empty() && removedDirectories.empty() && directories.empty();
+		}
+	};
+
+	// all functions are safe to call from any thread, access to the storage is serialized
+	void Init();
+
+	// folds the write ahead log back into db.sqlite, so the file can be copied on its own
+	void Checkpoint();
+
+	// the db file, relative to the working directory
+	const char* GetPath();
+
+	std::vector<FileFingerprint> GetFileFingerprints();
+	std::vector<Directory> GetDirectories();
+	// borrowed view of a files row, only valid inside the VisitFiles callback
+	struct FileView
+	{
+		int id;
+		const char* name;
+		const char* path;
+		const char* type;
+		size_t size;
+		int64_t mtime;
+		int64_t durationMs;
+		int sampleRate;
+		int channels;
+		int width;
+		int height;
+		int components;
+		uint64_t perceptualHash;  // 0 if there is none for this mtime
+		const void* fingerprint;  // AUDIO_FINGERPRINT_SIZE floats, maybe unaligned. null if there is none for this mtime
+		const char* codec;
+	};
+
+	// streams every row of the files table without materializing db::File objects
+	void VisitFiles(const std::function<void(const FileView&)>& visitor);
+
+	// 0 (or an empty range) matches anything. applied by SearchIndex::FilterAudioFormat
+	struct AudioFormatFilter
+	{
+		int channels = 0;
+		int sampleRate = 0;
+		int64_t minDurationMs = 0;
+		int64_t maxDurationMs = 0;  // exclusive
+
+		bool IsEmpty() const { return channels == 0 && sampleRate == 0 && minDurationMs == 0 && maxDurationMs == 0; }
+		bool Matches(int fileChannels, int fileSampleRate, int64_t fileDurationMs) const
+		{
+			return (channels == 0 || fileChannels == channels) &&
+				(sampleRate == 0 || fileSampleRate == sampleRate) &&
+				fileDurationMs >= minDurationMs &&
+				(maxDurationMs == 0 || fileDurationMs < maxDurationMs);
+		}
+	};
+
+	// inclusive bounds, 0 matches anything. applied by SearchIndex::FilterImageSize
+	struct ImageSizeFilter
+	{
+		int minWidth = 0;
+		int maxWidth = 0;
+		int minHeight = 0;
+		int maxHeight = 0;
+		int components = 0;
+
+		bool IsEmpty() const { return minWidth == 0 && maxWidth == 0 && minHeight == 0 && maxHeight == 0 && components == 0; }
+		bool Matches(int fileWidth, int fileHeight, int fileComponents) const
+		{
+			return fileWidth >= minWidth && (maxWidth == 0 || fileWidth <= maxWidth) &&
+				fileHeight >= minHeight && (maxHeight == 0 || fileHeight <= maxHeight) &&
+				(components == 0 || fileComponents == components);
+		}
+	};
+
+	// path -> id for the given paths that exist in the db, one query
+	std::vector<std::pair<std::string, int>> GetFileIds(const std::vector<std::string>& paths);
+	// a file that may have byte identical copies. contentHash is 0 if it was never hashed or changed since
+	struct HashTarget
+	{
+		int id = -1;
+		std::string path;
+		size_t size = 0;
+		int64_t mtime = 0;
+		uint64_t contentHash = 0;
+	};
+
+	// every non empty file with its stored hash, if it is still valid
+	std::vector<HashTarget> GetHashTargets();
+
+	struct FileHash
+	{
+		int id;
+		int64_t mtime;  // of the file when it was hashed
+		uint64_t hash;
+	};
+
+	// textures without a perceptual hash for their current mtime
+	struct ImageHashTarget
+	{
+		int id = -1;
+		std::string path;
+		int64_t mtime = 0;
+	};
+	std::vector<ImageHashTarget> GetImagesWithoutPerceptualHash();
+
+	// ingestion path for large batches. owns its own connection tuned for writing (wal, relaxed sync,
+	// big page cache) and prepares every statement once. conflicts on the unique path column are
+	// resolved by sqlite instead of a select per row. commits every chunkSize rows so the ui
+	// can still get the storage in between chunks.
+	class BulkWriter
+	{
+	public:
+		explicit BulkWriter(size_t chunkSize = 5000);
+		~BulkWriter();
+
+		BulkWriter(const BulkWriter&) = delete;
+		BulkWriter& operator=(const BulkWriter&) = delete;
+
+		bool IsValid() const { return connection != nullptr; }
+
+		// new paths are inserted, existing ones updated in place so their id (and tags) survive
+		void ApplyScanChanges(const ScanChanges& changes);
+
+		void PutContentHashes(const std::vector<FileHash>& hashes);
+		void PutPerceptualHashes(const std::vector<FileHash>& hashes);
+
+	private:
+		bool Execute(const char* sql);
+		sqlite3_stmt* Prepare(const char* sql);
+		void BindFile(sqlite3_stmt* statement, const File& file);
+		bool Step(sqlite3_stmt* statement);
+		void PutHashes(sqlite3_stmt* statement, const std::vector<FileHash>& hashes);
+
+		void BeginChunk();
+		void EndChunk();
+		void CountRow();
+
+		sqlite3* connection = nullptr;
+		sqlite3_stmt* upsertFile = nullptr;
+		sqlite3_stmt* removeFile = nullptr;
+		sqlite3_stmt* removeDirectoryFiles = nullptr;
+		sqlite3_stmt* removeDirectories = nullptr;
+		sqlite3_stmt* replaceDirectory = nullptr;
+		sqlite3_stmt* insertDirectory = nullptr;
+		sqlite3_stmt* updateContentHash = nullptr;
+		sqlite3_stmt* updatePerceptualHash = nullptr;
+
+		size_t chunkSize;
+		size_t chunkRows = 0;
+		bool bInChunk = false;
+	};
+
+	// downscaled rgba copy of an image, only valid for the mtime it was made from
+	struct Thumbnail
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> pixels;
+	};
+
+	// false if there is no thumbnail for this version of the file. a thumbnail without pixels
+	// marks a source that couldn't be decoded, so it isn't decoded again until it changes
+	bool GetThumbnail(int fileId, int64_t mtime, Thumbnail& outThumbnail);
+	void PutThumbnail(int fileId, int64_t mtime, const Thumbnail& thumbnail);
+
+	// mip chain of a texture preview, levels stored back to back in data. format is a PreviewFormat
+	struct Preview
+	{
+		int format = 0;
+		int width = 0;
+		int height = 0;
+		int levels = 0;
+		std::vector<unsigned char> data;
+	};
+
+	bool GetPreview(uint64_t pathHash, int64_t mtime, Preview& outPreview);
+	void PutPreview(uint64_t pathHash, int64_t mtime, const Preview& preview);
+
+	// decode once summary of a sound. peaks is a min/max pyramid quantized to int8, the finest level
+	// (baseBuckets pairs) first and every following level half as wide, down to a single pair.
+	// files that couldn't be decoded are stored with no levels so they aren't retried until they change
+	struct Waveform
+	{
+		uint32_t sampleRate = 0;
+		uint32_t channels = 0;
+		uint64_t lengthFrames = 0;
+		float rmsDb = 0.0f;   // dBFS over all channels
+		float peakDb = 0.0f;
+		int baseBuckets = 0;
+		int levels = 0;
+		std::vector<int8_t> peaks;
+	};
+
+	bool GetWaveform(int fileId, int64_t mtime, Waveform& outWaveform);
+	void PutWaveform(int fileId, int64_t mtime, const Waveform& waveform);
+
+	// empty for files that are silent or couldn't be decoded, so they aren't analyzed again until they change
+	void PutAudioFingerprint(int fileId, int64_t mtime, const std::vector<float>& fingerprint);
+
+	// audio files without a waveform or fingerprint for their current mtime
+	struct AnalysisTarget
+	{
+		int id = -1;
+		std::string path;
+		int64_t mtime = 0;
+	};
+	std::vector<AnalysisTarget> GetFilesWithoutWaveform();
+
+	std::vector<Tag> GetTags();
+	// id of the tag with that name, created if it doesn't exist yet. -1 on failure
+	int GetOrCreateTag(const std::string& name);
+	// streams every (tag, file) pair, grouped by tag with file ids ascending
+	void VisitFileTags(const std::function<void(int tagId, int fileId)>& visitor);
+	// single transaction each, tagging a file twice or untagging an untagged one is a no op
+	void TagFiles(int tagId, const std::vector<int>& fileIds);
+	void UntagFiles(int tagId, const std::vector<int>& fileIds);
+}
@@ -0,0 +1,276 @@
+#include "duplicatefinder.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include "contenthash.h"
+#include "jobsystem.h"
+
+// enough to tell apart most same sized files that differ (headers, metadata), one read each
+static const uint64_t PREFIX_BYTES = 4096;
+
+// reads in flight. keeps an ssd's queue busy, more would only make a spinning disk seek
+static const unsigned HASH_THREADS = 4;
+
+// full hashes are stored in chunks so a cancelled batch keeps most of its work
+static const size_t STORE_CHUNK = 1000;
+
+DuplicateFinder::DuplicateFinder()
+{
+}
+
+DuplicateFinder::~DuplicateFinder()
+{
+	Stop();
+}
+
+void DuplicateFinder::Start()
+{
+	if (bRunning && !progress.bDone)
+	{
+		bRestart = true;
+		return;
+	}
+
+	// the previous batch finished, only its thread is left
+	Stop();
+
+	bRunning = true;
+	bCancel = false;
+	bRestart = true;
+	progress.filesQueued = 0;
+	progress.filesHashed = 0;
+	progress.bytesHashed = 0;
+	progress.bDone = false;
+
+	jobs = std::make_unique<JobSystem>(std::min(HASH_THREADS, std::max(1u, std::thread::hardware_concurrency())));
+	batchThread = std::thread(&DuplicateFinder::BatchLoop, this);
+}
+
+void DuplicateFinder::Stop()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bCancel = true;
+	batchThread.join();
+	jobs.reset();
+	bRunning = false;
+}
+
+void DuplicateFinder::BatchLoop()
+{
+	// files committed while a batch runs are picked up by another pass
+	while (bRestart.exchange(false) && !bCancel)
+	{
+		FindDuplicates();
+	}
+
+	progress.bDone = true;
+}
+
+void DuplicateFinder::FindDuplicates()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<db::HashTarget> targets = db::GetHashTargets();
+	std::sort(targets.begin(), targets.end(),
+		[](const db::HashTarget& a, const db::HashTarget& b) { return a.size < b.size; });
+
+	// only sizes shared by two or more files can hold duplicates
+	struct Bucket
+	{
+		size_t begin;
+		size_t end;
+	};
+	std::vector<Bucket> buckets;
+	for (size_t begin = 0, end = 0; begin < targets.size(); begin = end)
+	{
+		end = begin + 1;
+		while (end < targets.size() && targets[end].size == targets[begin].size) end++;
+		if (end - begin > 1) buckets.push_back(Bucket{ begin, end });
+	}
+
+	// pass 1: first 4 kb of every member without a stored hash. small files are read whole,
+	// which makes their prefix hash their full hash
+	std::vector<size_t> unhashed;
+	for (const Bucket& bucket : buckets)
+	{
+		for (size_t i = bucket.begin; i < bucket.end; i++)
+		{
+			if (targets[i].contentHash == 0) unhashed.push_back(i);
+		}
+	}
+	progress.filesQueued += (int)unhashed.size();
+
+	std::vector<uint64_t> prefixHashes(targets.size(), 0);
+	std::vector<char> bReadable(targets.size(), 1);
+	std::atomic<uint64_t> bytesRead{ 0 };
+	jobs->ParallelFor(unhashed.size(), [&](size_t index)
+		{
+			const size_t i = unhashed[index];
+			const db::HashTarget& target = targets[i];
+			const uint64_t length = std::min<uint64_t>(target.size, PREFIX_BYTES);
+			if (!HashFile(target.path.c_str(), length, &bCancel, prefixHashes[i]))
+			{
+				bReadable[i] = 0;
+				progress.filesHashed++;
+				return;
+			}
+			bytesRead += length;
+			progress.bytesHashed += length;
+			progress.filesHashed++;
+		});
+
+	// pass 2: full hashes, only for files another member could still equal: an unhashed one
+	// with the same prefix, or any already hashed one (its prefix wasn't read)
+	std::vector<size_t> fullReads;
+	std::vector<db::FileHash> newHashes;
+	for (const Bucket& bucket : buckets)
+	{
+		if (bCancel) break;
+
+		bool bHasStored = false;
+		std::vector<size_t> members;
+		for (size_t i = bucket.begin; i < bucket.end; i++)
+		{
+			if (targets[i].contentHash != 0) bHasStored = true;
+			else if (bReadable[i]) members.push_back(i);
+		}
+
+		if (targets[bucket.begin].size <= PREFIX_BYTES)
+		{
+			for (size_t i : members)
+			{
+				targets[i].contentHash = prefixHashes[i];
+				newHashes.push_back(db::FileHash{ targets[i].id, targets[i].mtime, prefixHashes[i] });
+			}
+			continue;
+		}
+
+		std::sort(members.begin(), members.end(), [&](size_t a, size_t b) { return prefixHashes[a] < prefixHashes[b]; });
+		for (size_t m = 0; m < members.size(); m++)
+		{
+			const bool bSharesPrefix = (m > 0 && prefixHashes[members[m - 1]] == prefixHashes[members[m]]) ||
+				(m + 1 < members.size() && prefixHashes[members[m + 1]] == prefixHashes[members[m]]);
+			if (bSharesPrefix || bHasStored) fullReads.push_back(members[m]);
+		}
+	}
+
+	progress.filesQueued += (int)fullReads.size();
+
+	// big files first, so one large straggler doesn't hold up the end of the batch
+	std::sort(fullReads.begin(), fullReads.end(), [&](size_t a, size_t b) { return targets[a].size > targets[b].size; });
+	std::vector<uint64_t> fullHashes(fullReads.size(), 0);
+	jobs->ParallelFor(fullReads.size(), [&](size_t index)
+		{
+			const db::HashTarget& target = targets[fullReads[index]];
+			if (HashFile(target.path.c_str(), 0, &bCancel, fullHashes[index]))
+			{
+				bytesRead += target.size;
+				progress.bytesHashed += target.size;
+			}
+			else
+			{
+				fullHashes[index] = 0;
+			}
+			progress.filesHashed++;
+		});
+
+	for (size_t index = 0; index < fullReads.size(); index++)
+	{
+		if (fullHashes[index] == 0) continue;
+		db::HashTarget& target = targets[fullReads[index]];
+		target.contentHash = fullHashes[index];
+		newHashes.push_back(db::FileHash{ target.id, target.mtime, target.contentHash });
+	}
+
+	// whatever was hashed is kept, even from a cancelled pass
+	if (!newHashes.empty())
+	{
+		db::BulkWriter writer(STORE_CHUNK);
+		writer.PutContentHashes(newHashes);
+	}
+
+	if (bCancel)
+	{
+		return;
+	}
+
+	// same size and same full hash
+	std::vector<const db::HashTarget*> hashed;
+	for (const Bucket& bucket : buckets)
+	{
+		for (size_t i = bucket.begin; i < bucket.end; i++)
+		{
+			if (targets[i].contentHash != 0) hashed.push_back(&targets[i]);
+		}
+	}
+	std::sort(hashed.begin(), hashed.end(), [](const db::HashTarget* a, const db::HashTarget* b)
+		{
+			return a->size != b->size ? a->size < b->size : a->contentHash < b->contentHash;
+		});
+
+	std::vector<DuplicateGroup> found;
+	uint64_t reclaimable = 0;
+	for (size_t begin = 0, end = 0; begin < hashed.size(); begin = end)
+	{
+		end = begin + 1;
+		while (end < hashed.size() && hashed[end]->size == hashed[begin]->size &&
+			hashed[end]->contentHash == hashed[begin]->contentHash) end++;
+		if (end - begin < 2) continue;
+
+		DuplicateGroup group;
+		group.hash = hashed[begin]->contentHash;
+		group.size = hashed[begin]->size;
+		for (size_t i = begin; i < end; i++)
+		{
+			group.paths.push_back(hashed[i]->path);
+		}
+		std::sort(group.paths.begin(), group.paths.end());
+		reclaimable += group.GetReclaimableBytes();
+		found.push_back(std::move(group));
+	}
+	std::sort(found.begin(), found.end(), [](const DuplicateGroup& a, const DuplicateGroup& b)
+		{
+			return a.GetReclaimableBytes() > b.GetReclaimableBytes();
+		});
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double megabytes = bytesRead.load() / (1024.0 * 1024.0);
+	printf("[duplicates]: %d of %d files read, %.1f mb in %.2f s (%.2f gb/s), %d groups, %.1f mb reclaimable\n",
+		(int)unhashed.size(), (int)targets.size(), megabytes, seconds, seconds > 0.0 ? megabytes / 1024.0 / seconds : 0.0,
+		(int)found.size(), reclaimable / (1024.0 * 1024.0));
+
+	std::lock_guard<std::mutex> lock(resultMutex);
+	finishedGroups = std::move(found);
+	bHasResult = true;
+}
+
+void DuplicateFinder::Update()
+{
+	// a restart that came in while the last batch was wrapping up
+	if (bRunning && progress.bDone && bRestart)
+	{
+		Start();
+	}
+
+	std::lock_guard<std::mutex> lock(resultMutex);
+	if (!bHasResult)
+	{
+		return;
+	}
+
+	groups = std::move(finishedGroups);
+	finishedGroups.clear();
+	bHasResult = false;
+
+	reclaimableBytes = 0;
+	for (const DuplicateGroup& group : groups)
+	{
+		reclaimableBytes += group.GetReclaimableBytes();
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db.h"
+
+class JobSystem;
+
+// byte identical files, largest waste first
+struct DuplicateGroup
+{
+	uint64_t hash = 0;
+	size_t size = 0;
+	std::vector<std::string> paths;
+
+	// what deleting every copy but one would free
+	uint64_t GetReclaimableBytes() const { return paths.size() > 1 ? (uint64_t)size * (paths.size() - 1) : 0; }
+};
+
+// reads, not files: a file whose prefix collides is counted again for its full read
+struct HashProgress
+{
+	std::atomic<int> filesQueued{ 0 };
+	std::atomic<int> filesHashed{ 0 };
+	std::atomic<uint64_t> bytesHashed{ 0 };
+	std::atomic<bool> bDone{ true };
+};
+
+// finds duplicate assets in the background. only files sharing their size with another file
+// are read at all, and of those only the ones whose first 4 kb also collide are hashed in full.
+// full hashes are stored for the file's mtime, so a later batch only reads what changed
+class DuplicateFinder
+{
+public:
+	DuplicateFinder();
+	~DuplicateFinder();
+
+	DuplicateFinder(const DuplicateFinder&) = delete;
+	DuplicateFinder& operator=(const DuplicateFinder&) = delete;
+
+	// starts a batch. if one is running it goes over the files again once it is done
+	void Start();
+
+	// cancels the running batch, hashes stored so far are kept
+	void Stop();
+
+	const HashProgress& GetProgress() const { return progress; }
+
+	// main thread, once per frame. picks up the groups of a finished batch
+	void Update();
+
+	// main thread
+	const std::vector<DuplicateGroup>& GetGroups() const { return groups; }
+	uint64_t GetReclaimableBytes() const { return reclaimableBytes; }
+
+private:
+	void BatchLoop();
+	void FindDuplicates();
+
+	std::unique_ptr<JobSystem> jobs;
+	std::thread batchThread;
+	HashProgress progress;
+	std::atomic<bool> bCancel{ false };
+	std::atomic<bool> bRestart{ false };
+	bool bRunning = false;
+
+	// written by the batch, taken by Update
+	std::mutex resultMutex;
+	std::vector<DuplicateGroup> finishedGroups;
+	bool bHasResult = false;
+
+	// main thread only
+	std::vector<DuplicateGroup> groups;
+	uint64_t reclaimableBytes = 0;
+};
@@ -0,0 +1,499 @@
+#include "idbitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int PopCount(uint64_t word)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt64(word);
+#else
+	return __builtin_popcountll(word);
+#endif
+}
+
+static inline int CountTrailingZeros(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+static inline uint16_t HighBits(uint32_t id) { return (uint16_t)(id >> 16); }
+static inline uint16_t LowBits(uint32_t id) { return (uint16_t)(id & 0xFFFF); }
+
+bool IdBitmap::Chunk::Contains(uint16_t low) const
+{
+	if (IsBitset())
+	{
+		return (bits[low >> 6] >> (low & 63)) & 1;
+	}
+	return std::binary_search(values.begin(), values.end(), low);
+}
+
+void IdBitmap::Chunk::Normalize()
+{
+	if (IsBitset() && cardinality <= ARRAY_MAX)
+	{
+		values.clear();
+		values.reserve(cardinality);
+		for (size_t word = 0; word < BITSET_WORDS; word++)
+		{
+			for (uint64_t remaining = bits[word]; remaining; remaining &= remaining - 1)
+			{
+				values.push_back((uint16_t)(word * 64 + CountTrailingZeros(remaining)));
+			}
+		}
+		std::vector<uint64_t>().swap(bits);
+	}
+	else if (!IsBitset() && cardinality > ARRAY_MAX)
+	{
+		ToBits(bits);
+		std::vector<uint16_t>().swap(values);
+	}
+}
+
+void IdBitmap::Chunk::ToBits(std::vector<uint64_t>& outBits) const
+{
+	if (IsBitset())
+	{
+		outBits = bits;
+		return;
+	}
+
+	outBits.assign(BITSET_WORDS, 0);
+	for (uint16_t low : values)
+	{
+		outBits[low >> 6] |= 1ull << (low & 63);
+	}
+}
+
+bool IdBitmap::FromBits(uint16_t key, std::vector<uint64_t>& bits, Chunk& outChunk)
+{
+	uint32_t cardinality = 0;
+	for (uint64_t word : bits)
+	{
+		cardinality += PopCount(word);
+	}
+	if (cardinality == 0)
+	{
+		return false;
+	}
+
+	outChunk.key = key;
+	outChunk.cardinality = cardinality;
+	outChunk.bits.swap(bits);
+	outChunk.Normalize();
+	return true;
+}
+
+size_t IdBitmap::FindChunk(uint16_t key) const
+{
+	const auto it = std::lower_bound(chunks.begin(), chunks.end(), key,
+		[](const Chunk& chunk, uint16_t key) { return chunk.key < key; });
+	return it - chunks.begin();
+}
+
+IdBitmap::Chunk& IdBitmap::GetChunk(uint16_t key)
+{
+	const size_t index = FindChunk(key);
+	if (index == chunks.size() || chunks[index].key != key)
+	{
+		Chunk chunk;
+		chunk.key = key;
+		chunks.insert(chunks.begin() + index, std::move(chunk));
+	}
+	return chunks[index];
+}
+
+void IdBitmap::Add(uint32_t id)
+{
+	Chunk& chunk = GetChunk(HighBits(id));
+	const uint16_t low = LowBits(id);
+
+	if (chunk.IsBitset())
+	{
+		uint64_t& word = chunk.bits[low >> 6];
+		const uint64_t bit = 1ull << (low & 63);
+		if (!(word & bit))
+		{
+			word |= bit;
+			chunk.cardinality++;
+		}
+		return;
+	}
+
+	const auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+	if (it == chunk.values.end() || *it != low)
+	{
+		chunk.values.insert(it, low);
+		chunk.cardinality++;
+		chunk.Normalize();
+	}
+}
+
+void IdBitmap::Remove(uint32_t id)
+{
+	const size_t index = FindChunk(HighBits(id));
+	if (index == chunks.size() || chunks[index].key != HighBits(id))
+	{
+		return;
+	}
+
+	Chunk& chunk = chunks[index];
+	const uint16_t low = LowBits(id);
+	if (chunk.IsBitset())
+	{
+		uint64_t& word = chunk.bits[low >> 6];
+		const uint64_t bit = 1ull << (low & 63);
+		if (!(word & bit))
+		{
+			return;
+		}
+		word &= ~bit;
+	}
+	else
+	{
+		const auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+		if (it == chunk.values.end() || *it != low)
+		{
+			return;
+		}
+		chunk.values.erase(it);
+	}
+
+	if (--chunk.cardinality == 0)
+	{
+		chunks.erase(chunks.begin() + index);
+		return;
+	}
+	chunk.Normalize();
+}
+
+bool IdBitmap::Contains(uint32_t id) const
+{
+	const size_t index = FindChunk(HighBits(id));
+	return index < chunks.size() && chunks[index].key == HighBits(id) && chunks[index].Contains(LowBits(id));
+}
+
+void IdBitmap::AddMany(const std::vector<uint32_t>& ids)
+{
+	std::vector<uint32_t> sorted(ids);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	std::vector<uint16_t> lows;
+	std::vector<uint16_t> merged;
+	for (size_t begin = 0; begin < sorted.size();)
+	{
+		const uint16_t key = HighBits(sorted[begin]);
+		size_t end = begin;
+		lows.clear();
+		while (end < sorted.size() && HighBits(sorted[end]) == key)
+		{
+			lows.push_back(LowBits(sorted[end++]));
+		}
+		begin = end;
+
+		Chunk& chunk = GetChunk(key);
+		if (chunk.IsBitset())
+		{
+			for (uint16_t low : lows)
+			{
+				uint64_t& word = chunk.bits[low >> 6];
+				const uint64_t bit = 1ull << (low & 63);
+				chunk.cardinality += (word & bit) ? 0 : 1;
+				word |= bit;
+			}
+		}
+		else
+		{
+			merged.clear();
+			std::set_union(chunk.values.begin(), chunk.values.end(), lows.begin(), lows.end(), std::back_inserter(merged));
+			chunk.values.swap(merged);
+			chunk.cardinality = (uint32_t)chunk.values.size();
+			chunk.Normalize();
+		}
+	}
+}
+
+void IdBitmap::RemoveMany(const std::vector<uint32_t>& ids)
+{
+	std::vector<uint32_t> sorted(ids);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	std::vector<uint16_t> lows;
+	std::vector<uint16_t> remaining;
+	for (size_t begin = 0; begin < sorted.size();)
+	{
+		const uint16_t key = HighBits(sorted[begin]);
+		size_t end = begin;
+		lows.clear();
+		while (end < sorted.size() && HighBits(sorted[end]) == key)
+		{
+			lows.push_back(LowBits(sorted[end++]));
+		}
+		begin = end;
+
+		const size_t index = FindChunk(key);
+		if (index == chunks.size() || chunks[index].key != key)
+		{
+			continue;
+		}
+
+		Chunk& chunk = chunks[index];
+		if (chunk.IsBitset())
+		{
+			for (uint16_t low : lows)
+			{
+				uint64_t& word = chunk.bits[low >> 6];
+				const uint64_t bit = 1ull << (low & 63);
+				chunk.cardinality -= (word & bit) ? 1 : 0;
+				word &= ~bit;
+			}
+		}
+		else
+		{
+			remaining.clear();
+			std::set_difference(chunk.values.begin(), chunk.values.end(), lows.begin(), lows.end(), std::back_inserter(remaining));
+			chunk.values.swap(remaining);
+			chunk.cardinality = (uint32_t)chunk.values.size();
+		}
+
+		if (chunk.cardinality == 0)
+		{
+			chunks.erase(chunks.begin() + index);
+		}
+		else
+		{
+			chunk.Normalize();
+		}
+	}
+}
+
+size_t IdBitmap::GetCardinality() const
+{
+	size_t cardinality = 0;
+	for (const Chunk& chunk : chunks)
+	{
+		cardinality += chunk.cardinality;
+	}
+	return cardinality;
+}
+
+size_t IdBitmap::GetMemoryBytes() const
+{
+	size_t bytes = chunks.capacity() * sizeof(Chunk);
+	for (const Chunk& chunk : chunks)
+	{
+		bytes += chunk.values.capacity() * sizeof(uint16_t) + chunk.bits.capacity() * sizeof(uint64_t);
+	}
+	return bytes;
+}
+
+void IdBitmap::ToVector(std::vector<uint32_t>& outIds) const
+{
+	outIds.reserve(outIds.size() + GetCardinality());
+	for (const Chunk& chunk : chunks)
+	{
+		const uint32_t high = (uint32_t)chunk.key << 16;
+		if (chunk.IsBitset())
+		{
+			for (size_t word = 0; word < BITSET_WORDS; word++)
+			{
+				for (uint64_t remaining = chunk.bits[word]; remaining; remaining &= remaining - 1)
+				{
+					outIds.push_back(high | (uint32_t)(word * 64 + CountTrailingZeros(remaining)));
+				}
+			}
+		}
+		else
+		{
+			for (uint16_t low : chunk.values)
+			{
+				outIds.push_back(high | low);
+			}
+		}
+	}
+}
+
+IdBitmap IdBitmap::And(const IdBitmap& a, const IdBitmap& b)
+{
+	IdBitmap result;
+	std::vector<uint64_t> bits;
+
+	size_t i = 0, j = 0;
+	while (i < a.chunks.size() && j < b.chunks.size())
+	{
+		const Chunk& left = a.chunks[i];
+		const Chunk& right = b.chunks[j];
+		if (left.key < right.key) { i++; continue; }
+		if (right.key < left.key) { j++; continue; }
+		i++;
+		j++;
+
+		Chunk chunk;
+		chunk.key = left.key;
+		if (!left.IsBitset() && !right.IsBitset())
+		{
+			std::set_intersection(left.values.begin(), left.values.end(), right.values.begin(), right.values.end(),
+				std::back_inserter(chunk.values));
+		}
+		else if (left.IsBitset() && right.IsBitset())
+		{
+			bits.resize(BITSET_WORDS);
+			for (size_t word = 0; word < BITSET_WORDS; word++)
+			{
+				bits[word] = left.bits[word] & right.bits[word];
+			}
+			if (FromBits(chunk.key, bits, chunk))
+			{
+				result.chunks.push_back(std::move(chunk));
+			}
+			continue;
+		}
+		else
+		{
+			// the array side bounds the result, probe the bitset with it
+			const Chunk& array = left.IsBitset() ? right : left;
+			const Chunk& bitset = left.IsBitset() ? left : right;
+			for (uint16_t low : array.values)
+			{
+				if (bitset.Contains(low)) chunk.values.push_back(low);
+			}
+		}
+
+		chunk.cardinality = (uint32_t)chunk.values.size();
+		if (chunk.cardinality > 0)
+		{
+			result.chunks.push_back(std::move(chunk));
+		}
+	}
+	return result;
+}
+
+IdBitmap IdBitmap::Or(const IdBitmap& a, const IdBitmap& b)
+{
+	IdBitmap result;
+	result.chunks.reserve(a.chunks.size() + b.chunks.size());
+	std::vector<uint64_t> bits;
+
+	size_t i = 0, j = 0;
+	while (i < a.chunks.size() || j < b.chunks.size())
+	{
+		if (j == b.chunks.size() || (i < a.chunks.size() && a.chunks[i].key < b.chunks[j].key))
+		{
+			result.chunks.push_back(a.chunks[i++]);
+			continue;
+		}
+		if (i == a.chunks.size() || b.chunks[j].key < a.chunks[i].key)
+		{
+			result.chunks.push_back(b.chunks[j++]);
+			continue;
+		}
+
+		const Chunk& left = a.chunks[i++];
+		const Chunk& right = b.chunks[j++];
+
+		Chunk chunk;
+		chunk.key = left.key;
+		if (!left.IsBitset() && !right.IsBitset())
+		{
+			std::set_union(left.values.begin(), left.values.end(), right.values.begin(), right.values.end(),
+				std::back_inserter(chunk.values));
+			chunk.cardinality = (uint32_t)chunk.values.size();
+			chunk.Normalize();
+			result.chunks.push_back(std::move(chunk));
+			continue;
+		}
+
+		// at least one side is dense, so is the union
+		const Chunk& bitset = left.IsBitset() ? left : right;
+		const Chunk& other = left.IsBitset() ? right : left;
+		bits = bitset.bits;
+		if (other.IsBitset())
+		{
+			for (size_t word = 0; word < BITSET_WORDS; word++)
+			{
+				bits[word] |= other.bits[word];
+			}
+		}
+		else
+		{
+			for (uint16_t low : other.values)
+			{
+				bits[low >> 6] |= 1ull << (low & 63);
+			}
+		}
+		FromBits(chunk.key, bits, chunk);
+		result.chunks.push_back(std::move(chunk));
+	}
+	return result;
+}
+
+IdBitmap IdBitmap::AndNot(const IdBitmap& a, const IdBitmap& b)
+{
+	IdBitmap result;
+	std::vector<uint64_t> bits;
+
+	size_t j = 0;
+	for (const Chunk& left : a.chunks)
+	{
+		while (j < b.chunks.size() && b.chunks[j].key < left.key)
+		{
+			j++;
+		}
+		if (j == b.chunks.size() || b.chunks[j].key != left.key)
+		{
+			result.chunks.push_back(left);
+			continue;
+		}
+
+		const Chunk& right = b.chunks[j];
+		Chunk chunk;
+		chunk.key = left.key;
+		if (!left.IsBitset())
+		{
+			for (uint16_t low : left.values)
+			{
+				if (!right.Contains(low)) chunk.values.push_back(low);
+			}
+			chunk.cardinality = (uint32_t)chunk.values.size();
+			if (chunk.cardinality > 0)
+			{
+				result.chunks.push_back(std::move(chunk));
+			}
+			continue;
+		}
+
+		bits = left.bits;
+		if (right.IsBitset())
+		{
+			for (size_t word = 0; word < BITSET_WORDS; word++)
+			{
+				bits[word] &= ~right.bits[word];
+			}
+		}
+		else
+		{
+			for (uint16_t low : right.values)
+			{
+				bits[low >> 6] &= ~(1ull << (low & 63));
+			}
+		}
+		if (FromBits(chunk.key, bits, chunk))
+		{
+			result.chunks.push_back(std::move(chunk));
+		}
+	}
+	return result;
+}
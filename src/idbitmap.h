@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// compressed set of 32 bit ids, roaring style. ids are split by their high 16 bits into chunks,
+// each chunk stores its low 16 bits either as a sorted array (up to 4096 of them, 8 kb at most)
+// or as a 65536 bit bitset (8 kb) once denser than that. set operations work chunk by chunk
+// and pick the loop for the pair of representations: merges for arrays, word ops for bitsets.
+class IdBitmap
+{
+public:
+	void Add(uint32_t id);
+	void Remove(uint32_t id);
+	bool Contains(uint32_t id) const;
+
+	// bulk versions, sort a copy once and touch every chunk a single time
+	void AddMany(const std::vector<uint32_t>& ids);
+	void RemoveMany(const std::vector<uint32_t>& ids);
+
+	bool IsEmpty() const { return chunks.empty(); }
+	size_t GetCardinality() const;
+	size_t GetMemoryBytes() const;
+
+	// ascending
+	void ToVector(std::vector<uint32_t>& outIds) const;
+
+	static IdBitmap And(const IdBitmap& a, const IdBitmap& b);
+	static IdBitmap Or(const IdBitmap& a, const IdBitmap& b);
+	static IdBitmap AndNot(const IdBitmap& a, const IdBitmap& b);
+
+private:
+	// past this many values a chunk is smaller as a bitset
+	static const size_t ARRAY_MAX = 4096;
+	static const size_t BITSET_WORDS = 65536 / 64;
+
+	struct Chunk
+	{
+		uint16_t key = 0;
+		uint32_t cardinality = 0;
+		std::vector<uint16_t> values;  // sorted, while cardinality <= ARRAY_MAX
+		std::vector<uint64_t> bits;    // BITSET_WORDS words otherwise
+
+		bool IsBitset() const { return !bits.empty(); }
+		bool Contains(uint16_t low) const;
+		// switches to whichever representation fits the cardinality
+		void Normalize();
+		// bitset copy of the chunk, whatever its representation
+		void ToBits(std::vector<uint64_t>& outBits) const;
+	};
+
+	// index of the chunk with the key, or of where it would go
+	size_t FindChunk(uint16_t key) const;
+	// the chunk for key, inserted empty if missing
+	Chunk& GetChunk(uint16_t key);
+
+	static bool FromBits(uint16_t key, std::vector<uint64_t>& bits, Chunk& outChunk);
+
+	std::vector<Chunk> chunks;  // sorted by key, never empty
+};
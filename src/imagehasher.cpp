@@ -0,0 +1,149 @@
+#include "imagehasher.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "jobsystem.h"
+#include "perceptualhash.h"
+#include "textureloader.h"
+#include "thumbnailcache.h"
+
+#include "stb_image.h"
+
+// hashes are written once per chunk, a cancelled batch keeps everything before it
+static const size_t HASH_CHUNK = 256;
+
+ImageHasher::ImageHasher()
+{
+}
+
+ImageHasher::~ImageHasher()
+{
+	Stop();
+}
+
+void ImageHasher::Start()
+{
+	if (bRunning && !progress.bDone)
+	{
+		bRestart = true;
+		return;
+	}
+
+	// the previous batch finished, only its thread is left
+	Stop();
+
+	bRunning = true;
+	bCancel = false;
+	bRestart = true;
+	progress.filesQueued = 0;
+	progress.filesHashed = 0;
+	progress.filesFailed = 0;
+	progress.bDone = false;
+
+	// decoding is all cpu, leave the other half to the ui and the shared pool
+	jobs = std::make_unique<JobSystem>(std::max(1u, std::thread::hardware_concurrency() / 2));
+	batchThread = std::thread(&ImageHasher::BatchLoop, this);
+}
+
+void ImageHasher::Stop()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bCancel = true;
+	batchThread.join();
+	jobs.reset();
+	bRunning = false;
+}
+
+void ImageHasher::BatchLoop()
+{
+	const auto start = std::chrono::steady_clock::now();
+	db::BulkWriter writer(HASH_CHUNK);
+
+	// files committed while a batch runs are picked up by another query
+	while (bRestart.exchange(false) && !bCancel)
+	{
+		const std::vector<db::ImageHashTarget> targets = db::GetImagesWithoutPerceptualHash();
+		progress.filesQueued += (int)targets.size();
+
+		std::vector<db::FileHash> hashes;
+		for (size_t begin = 0; begin < targets.size() && !bCancel; begin += HASH_CHUNK)
+		{
+			const size_t count = std::min(HASH_CHUNK, targets.size() - begin);
+			hashes.assign(count, db::FileHash{ -1, 0, 0 });
+			jobs->ParallelFor(count, [&](size_t i) { HashImage(targets[begin + i], hashes[i]); });
+
+			// cancelled ones are left out, they are picked up by the next batch
+			hashes.erase(std::remove_if(hashes.begin(), hashes.end(), [](const db::FileHash& hash) { return hash.id < 0; }), hashes.end());
+			writer.PutPerceptualHashes(hashes);
+			bDirty = true;
+		}
+	}
+
+	const int hashed = progress.filesHashed.load();
+	if (hashed > 0)
+	{
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("[imagehash]: %d images in %.2f s (%.0f/s), %d failed\n",
+			hashed, seconds, seconds > 0.0 ? hashed / seconds : 0.0, progress.filesFailed.load());
+	}
+
+	progress.bDone = true;
+}
+
+void ImageHasher::HashImage(const db::ImageHashTarget& target, db::FileHash& outHash)
+{
+	if (bCancel)
+	{
+		return;
+	}
+
+	db::Thumbnail thumbnail;
+	if (!db::GetThumbnail(target.id, target.mtime, thumbnail))
+	{
+		int width = 0;
+		int height = 0;
+		const char* failureReason = nullptr;
+		unsigned char* pixels = DecodeImageFile(target.path, &bCancel, &width, &height, &failureReason);
+		if (bCancel)
+		{
+			// a jpeg cut short by the cancel still comes back as pixels, zero filled past the cut
+			stbi_image_free(pixels);
+			return;
+		}
+		else if (pixels)
+		{
+			// the same thumbnail the grid would build, so both hash alike
+			ThumbnailCache::Downscale(pixels, width, height, ThumbnailCache::THUMBNAIL_SIZE, thumbnail);
+			stbi_image_free(pixels);
+			db::PutThumbnail(target.id, target.mtime, thumbnail);
+		}
+		else
+		{
+			// stored as 0, so it isn't retried until the file changes. the empty thumbnail tells the grid the same
+			printf("[imagehash]: failed to load [%s] (%s)\n", target.path.c_str(), failureReason);
+			db::PutThumbnail(target.id, target.mtime, thumbnail);
+			progress.filesFailed++;
+		}
+	}
+
+	outHash.id = target.id;
+	outHash.mtime = target.mtime;
+	outHash.hash = thumbnail.pixels.empty() ? 0 : ComputePerceptualHash(thumbnail.pixels.data(), thumbnail.width, thumbnail.height);
+	progress.filesHashed++;
+}
+
+void ImageHasher::Update()
+{
+	// a restart that came in while the last batch was wrapping up
+	if (bRunning && progress.bDone && bRestart)
+	{
+		Start();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "db.h"
+
+class JobSystem;
+
+struct ImageHashProgress
+{
+	std::atomic<int> filesQueued{ 0 };
+	std::atomic<int> filesHashed{ 0 };
+	std::atomic<int> filesFailed{ 0 };
+	std::atomic<bool> bDone{ true };
+};
+
+// computes the perceptual hash of every texture once in the background and stores it for the
+// file's mtime. a cached grid thumbnail is hashed as is, otherwise the source is decoded and the
+// thumbnail written back on the way, so browsing the grid later doesn't decode again.
+// runs on a pool half the size of the machine, like the audio analysis
+class ImageHasher
+{
+public:
+	ImageHasher();
+	~ImageHasher();
+
+	ImageHasher(const ImageHasher&) = delete;
+	ImageHasher& operator=(const ImageHasher&) = delete;
+
+	// starts a batch. if one is running it queries for new files again once it is done
+	void Start();
+
+	// cancels the running batch, hashes stored so far are kept
+	void Stop();
+
+	const ImageHashProgress& GetProgress() const { return progress; }
+
+	// true once after hashes were stored, the search index has to be reloaded to see them
+	bool ConsumeDirty() { return bDirty.exchange(false); }
+
+	// main thread, once per frame
+	void Update();
+
+private:
+	void BatchLoop();
+	void HashImage(const db::ImageHashTarget& target, db::FileHash& outHash);
+
+	std::unique_ptr<JobSystem> jobs;
+	std::thread batchThread;
+	ImageHashProgress progress;
+	std::atomic<bool> bCancel{ false };
+	std::atomic<bool> bRestart{ false };
+	std::atomic<bool> bDirty{ false };
+	bool bRunning = false;
+};
@@ -0,0 +1,188 @@
+#include "imageprobe.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// one read covers the whole header of a plain png or jpeg, anything bigger in front of it is seeked over
+static const size_t PROBE_HEAD_BYTES = 4 * 1024;
+// chunks or segments walked before giving up, real files have their size within the first few
+static const int PROBE_MAX_SEGMENTS = 64;
+
+static bool Seek(FILE* file, int64_t offset, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, origin) == 0;
+#else
+	return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+}
+
+// reads up to count bytes at offset, returns how many were read
+static size_t ReadAt(FILE* file, int64_t offset, std::vector<unsigned char>& outBytes, size_t count)
+{
+	outBytes.resize(count);
+	if (!Seek(file, offset, SEEK_SET))
+	{
+		outBytes.clear();
+		return 0;
+	}
+	outBytes.resize(fread(outBytes.data(), 1, count, file));
+	return outBytes.size();
+}
+
+// count bytes at offset, straight from the head when it covers them. null past the end of the file
+static const unsigned char* GetBytes(FILE* file, const std::vector<unsigned char>& head, int64_t offset, size_t count,
+	std::vector<unsigned char>& scratch)
+{
+	if (offset + (int64_t)count <= (int64_t)head.size())
+	{
+		return head.data() + offset;
+	}
+	if (ReadAt(file, offset, scratch, count) < count)
+	{
+		return nullptr;
+	}
+	return scratch.data();
+}
+
+static inline uint32_t ReadBe16(const unsigned char* bytes) { return (bytes[0] << 8) | bytes[1]; }
+static inline uint32_t ReadBe32(const unsigned char* bytes) { return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]; }
+
+// IHDR is always the first chunk. a tRNS chunk before the pixel data adds an alpha channel
+static bool ProbePng(FILE* file, const std::vector<unsigned char>& head, ImageHeader& outHeader)
+{
+	if (head.size() < 33 || memcmp(&head[12], "IHDR", 4) != 0)
+	{
+		return false;
+	}
+
+	outHeader.width = (int)ReadBe32(&head[16]);
+	outHeader.height = (int)ReadBe32(&head[20]);
+	outHeader.codec = "png";
+
+	const int colorType = head[25];
+	switch (colorType)
+	{
+	case 0: outHeader.components = 1; break;
+	case 2: outHeader.components = 3; break;
+	case 3: outHeader.components = 3; break;
+	case 4: outHeader.components = 2; break;
+	case 6: outHeader.components = 4; break;
+	default: return false;
+	}
+
+	if (colorType == 4 || colorType == 6)
+	{
+		return true;
+	}
+
+	std::vector<unsigned char> scratch;
+	int64_t offset = 33;
+	for (int chunk = 0; chunk < PROBE_MAX_SEGMENTS; chunk++)
+	{
+		const unsigned char* bytes = GetBytes(file, head, offset, 8, scratch);
+		if (!bytes || memcmp(bytes + 4, "IDAT", 4) == 0 || memcmp(bytes + 4, "IEND", 4) == 0)
+		{
+			break;
+		}
+		if (memcmp(bytes + 4, "tRNS", 4) == 0)
+		{
+			outHeader.components++;
+			break;
+		}
+		// length, type, data, crc
+		offset += 12 + (int64_t)ReadBe32(bytes);
+	}
+	return true;
+}
+
+// walks the marker segments up to the first SOFn, which holds the frame size. exif thumbnails and
+// icc profiles in front of it are skipped by their length without being read
+static bool ProbeJpeg(FILE* file, const std::vector<unsigned char>& head, ImageHeader& outHeader)
+{
+	std::vector<unsigned char> scratch;
+	int64_t offset = 2;
+	for (int segment = 0; segment < PROBE_MAX_SEGMENTS; segment++)
+	{
+		const unsigned char* bytes = GetBytes(file, head, offset, 4, scratch);
+		if (!bytes || bytes[0] != 0xFF)
+		{
+			return false;
+		}
+
+		const int marker = bytes[1];
+		if (marker == 0xFF)
+		{
+			// fill byte
+			offset++;
+			continue;
+		}
+		if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+		{
+			// no payload
+			offset += 2;
+			continue;
+		}
+		if (marker == 0xD9 || marker == 0xDA)
+		{
+			// end of image or start of scan without a frame header
+			return false;
+		}
+
+		const uint32_t length = ReadBe16(bytes + 2);
+		if (length < 2)
+		{
+			return false;
+		}
+
+		// SOF0..SOF15, the gaps are DHT, JPG and DAC
+		if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+		{
+			const unsigned char* frame = GetBytes(file, head, offset + 4, 6, scratch);
+			if (!frame)
+			{
+				return false;
+			}
+
+			outHeader.height = (int)ReadBe16(frame + 1);
+			outHeader.width = (int)ReadBe16(frame + 3);
+			outHeader.components = frame[5];
+
+			const bool bProgressive = marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE;
+			outHeader.codec = bProgressive ? "progressive jpeg" : "jpeg";
+			return true;
+		}
+
+		offset += 2 + length;
+	}
+	return false;
+}
+
+bool ProbeImageFile(const char* path, ImageHeader& outHeader)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> head;
+	ReadAt(file, 0, head, PROBE_HEAD_BYTES);
+
+	// recognized by content, extensions lie
+	static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool bParsed = false;
+	if (head.size() >= 8 && memcmp(head.data(), PNG_SIGNATURE, 8) == 0)
+	{
+		bParsed = ProbePng(file, head, outHeader);
+	}
+	else if (head.size() >= 3 && head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF)
+	{
+		bParsed = ProbeJpeg(file, head, outHeader);
+	}
+
+	fclose(file);
+	return bParsed && outHeader.width > 0 && outHeader.height > 0 && outHeader.components > 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// what an image's header says about it, read without decoding any pixels
+struct ImageHeader
+{
+	int width = 0;
+	int height = 0;
+	int components = 0;  // 1 gray, 2 gray + alpha, 3 rgb, 4 rgba (or cmyk for jpeg)
+	std::string codec;   // "png", "jpeg", "progressive jpeg"
+};
+
+// parses the header of a png or jpeg file. reads the first few kb and seeks over anything that
+// comes before the size (big exif or icc segments). false if the format isn't recognized
+bool ProbeImageFile(const char* path, ImageHeader& outHeader);
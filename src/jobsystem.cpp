@@ -0,0 +1,190 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+// index of the worker owning the current thread, -1 for non pool threads
+static thread_local int tlsWorkerIndex = -1;
+static thread_local const JobSystem* tlsOwner = nullptr;
+
+JobSystem::JobSystem(unsigned threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0) threadCount = 4;
+	}
+
+	workers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		bQuit = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void JobSystem::Submit(Job job)
+{
+	unsigned index;
+	if (tlsOwner == this && tlsWorkerIndex >= 0)
+	{
+		index = (unsigned)tlsWorkerIndex;
+	}
+	else
+	{
+		index = nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+	}
+
+	pendingJobs.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->mutex);
+		workers[index]->jobs.push_back(std::move(job));
+	}
+	queuedJobs.fetch_add(1);
+
+	// lock so a worker checking the predicate can't miss the notify
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeCondition.notify_one();
+}
+
+void JobSystem::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(sleepMutex);
+	idleCondition.wait(lock, [this] { return pendingJobs.load() == 0; });
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// helpers may start after the caller already finished everything,
+	// they only ever touch job after claiming an index below count
+	struct State
+	{
+		const std::function<void(size_t)>* job;
+		size_t count;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	auto state = std::make_shared<State>();
+	state->job = &job;
+	state->count = count;
+
+	const auto run = [](State& state)
+	{
+		size_t index;
+		while ((index = state.next.fetch_add(1)) < state.count)
+		{
+			(*state.job)(index);
+			if (state.done.fetch_add(1) + 1 == state.count)
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.finished.notify_all();
+			}
+		}
+	};
+
+	const size_t helpers = std::min(count - 1, workers.size());
+	for (size_t i = 0; i < helpers; i++)
+	{
+		Submit([state, run] { run(*state); });
+	}
+
+	run(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+}
+
+JobSystem& JobSystem::GetShared()
+{
+	static JobSystem shared;
+	return shared;
+}
+
+bool JobSystem::TryPop(unsigned index, Job& outJob)
+{
+	// own jobs first, newest first
+	{
+		Worker& self = *workers[index];
+		std::lock_guard<std::mutex> lock(self.mutex);
+		if (!self.jobs.empty())
+		{
+			outJob = std::move(self.jobs.back());
+			self.jobs.pop_back();
+			return true;
+		}
+	}
+
+	// steal oldest job from someone else
+	const unsigned count = (unsigned)workers.size();
+	for (unsigned i = 1; i < count; i++)
+	{
+		Worker& victim = *workers[(index + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			outJob = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+	tlsWorkerIndex = (int)index;
+	tlsOwner = this;
+
+	while (true)
+	{
+		Job job;
+		if (TryPop(index, job))
+		{
+			queuedJobs.fetch_sub(1);
+			job();
+
+			if (pendingJobs.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				idleCondition.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this] { return bQuit || queuedJobs.load() > 0; });
+		if (bQuit && queuedJobs.load() == 0)
+		{
+			return;
+		}
+	}
+}
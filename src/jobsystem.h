@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work stealing thread pool.
+// every worker owns a deque: it pops its own jobs from the back (lifo, cache friendly for
+// recursive work like directory walks) and steals from the front of other workers when empty.
+class JobSystem
+{
+public:
+	using Job = std::function<void()>;
+
+	// threadCount 0 -> hardware concurrency
+	explicit JobSystem(unsigned threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// jobs submitted from a worker thread go to that worker's own deque,
+	// jobs from other threads are distributed round robin
+	void Submit(Job job);
+
+	// blocks until every submitted job (including the ones they spawn) has finished
+	void WaitIdle();
+
+	// runs job(i) for every i in [0, count) and returns once all of them are done.
+	// the calling thread works through indices too, so this is safe to call from inside a job
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	// process wide pool for short compute bursts (search, decoding...), sized to the machine
+	static JobSystem& GetShared();
+
+	unsigned GetThreadCount() const { return (unsigned)threads.size(); }
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void WorkerLoop(unsigned index);
+	bool TryPop(unsigned index, Job& outJob);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable idleCondition;
+
+	std::atomic<int> queuedJobs{ 0 };   // sitting in a deque
+	std::atomic<int> pendingJobs{ 0 };  // submitted but not finished
+	std::atomic<unsigned> nextWorker{ 0 };
+	bool bQuit = false;
+};
@@ -7,22 +7,34 @@
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl.h"
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <atomic>
+#include <future>
+#include <memory>
 #include <stdio.h>
 
 #include "stb_image.h"
 #include "cute_files.h"
 
-#include "miniaudio.h"
-
 #include "IconsFontAwesome5.h"
 
-#define FTS_FUZZY_MATCH_IMPLEMENTATION
-#include "fuzzy_match.h"
-
-#include "sqlite_orm/sqlite_orm.h"
+#include "db.h"
+#include "scanner.h"
+#include "watcher.h"
+#include "searchindex.h"
+#include "searchworker.h"
+#include "tagindex.h"
+#include "spectrum.h"
+#include "textureloader.h"
+#include "thumbnailcache.h"
+#include "audioanalyzer.h"
+#include "duplicatefinder.h"
+#include "imagehasher.h"
+#include "audioengine.h"
+#include "waveform.h"
 
 const int WIDTH = 1024;
 const int HEIGHT = 768;
@@ -35,443 +47,590 @@ enum PreviewMode
 
 
 
-struct TexturePreview
+void ConfigImguiStyle()
 {
-	int width;
-	int height;
-	GLuint textureId;
-};
-
-namespace db {
-
-	static const char* AUDIO_FILE_TYPE = "audio";
-	static const char* TEXTURE_FILE_TYPE = "texture";
+	ImGuiStyle* style = &ImGui::GetStyle();
+	ImVec4* colors = style->Colors;
 
-	struct File
-	{
-		int id = -1;
-		std::string name;
-		std::string path;
-		std::string ext;
-		std::string type;  // using strings for now,  enum binding is too much work
-		std::string directory;
-		size_t size;
-
-		File()
-		{
-		}
+	colors[ImGuiCol_Text] = ImVec4(1.000f, 1.000f, 1.000f, 1.000f);
+	colors[ImGuiCol_TextDisabled] = ImVec4(0.500f, 0.500f, 0.500f, 1.000f);
+	colors[ImGuiCol_WindowBg] = ImVec4(0.180f, 0.180f, 0.180f, 1.000f);
+	colors[ImGuiCol_ChildBg] = ImVec4(0.280f, 0.280f, 0.280f, 0.000f);
+	colors[ImGuiCol_PopupBg] = ImVec4(0.313f, 0.313f, 0.313f, 1.000f);
+	colors[ImGuiCol_Border] = ImVec4(0.266f, 0.266f, 0.266f, 1.000f);
+	colors[ImGuiCol_BorderShadow] = ImVec4(0.000f, 0.000f, 0.000f, 0.000f);
+	colors[ImGuiCol_FrameBg] = ImVec4(0.160f, 0.160f, 0.160f, 1.000f);
+	colors[ImGuiCol_FrameBgHovered] = ImVec4(0.200f, 0.200f, 0.200f, 1.000f);
+	colors[ImGuiCol_FrameBgActive] = ImVec4(0.280f, 0.280f, 0.280f, 1.000f);
+	colors[ImGuiCol_TitleBg] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
+	colors[ImGuiCol_TitleBgActive] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
+	colors[ImGuiCol_TitleBgCollapsed] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
+	colors[ImGuiCol_MenuBarBg] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
+	colors[ImGuiCol_ScrollbarBg] = ImVec4(0.160f, 0.160f, 0.160f, 1.000f);
+	colors[ImGuiCol_ScrollbarGrab] = ImVec4(0.277f, 0.277f, 0.277f, 1.000f);
+	colors[ImGuiCol_ScrollbarGrabHovered] = ImVec4(0.300f, 0.300f, 0.300f, 1.000f);
+	colors[ImGuiCol_ScrollbarGrabActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_CheckMark] = ImVec4(1.000f, 1.000f, 1.000f, 1.000f);
+	colors[ImGuiCol_SliderGrab] = ImVec4(0.391f, 0.391f, 0.391f, 1.000f);
+	colors[ImGuiCol_SliderGrabActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_Button] = ImVec4(1.000f, 1.000f, 1.000f, 0.000f);
+	colors[ImGuiCol_ButtonHovered] = ImVec4(1.000f, 1.000f, 1.000f, 0.156f);
+	colors[ImGuiCol_ButtonActive] = ImVec4(1.000f, 1.000f, 1.000f, 0.391f);
+	colors[ImGuiCol_Header] = ImVec4(0.313f, 0.313f, 0.313f, 1.000f);
+	colors[ImGuiCol_HeaderHovered] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
+	colors[ImGuiCol_HeaderActive] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
+	colors[ImGuiCol_Separator] = colors[ImGuiCol_Border];
+	colors[ImGuiCol_SeparatorHovered] = ImVec4(0.391f, 0.391f, 0.391f, 1.000f);
+	colors[ImGuiCol_SeparatorActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_ResizeGrip] = ImVec4(1.000f, 1.000f, 1.000f, 0.250f);
+	colors[ImGuiCol_ResizeGripHovered] = ImVec4(1.000f, 1.000f, 1.000f, 0.670f);
+	colors[ImGuiCol_ResizeGripActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_Tab] = ImVec4(0.098f, 0.098f, 0.098f, 1.000f);
+	colors[ImGuiCol_TabHovered] = ImVec4(0.352f, 0.352f, 0.352f, 1.000f);
+	colors[ImGuiCol_TabActive] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
+	colors[ImGuiCol_TabUnfocused] = ImVec4(0.098f, 0.098f, 0.098f, 1.000f);
+	colors[ImGuiCol_TabUnfocusedActive] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
+	//colors[ImGuiCol_preview] = ImVec4(1.000f, 0.391f, 0.000f, 0.781f);
+	//colors[ImGuiCol_DockingEmptyBg] = ImVec4(0.180f, 0.180f, 0.180f, 1.000f);
+	colors[ImGuiCol_PlotLines] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
+	colors[ImGuiCol_PlotLinesHovered] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_PlotHistogram] = ImVec4(0.586f, 0.586f, 0.586f, 1.000f);
+	colors[ImGuiCol_PlotHistogramHovered] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_TextSelectedBg] = ImVec4(1.000f, 1.000f, 1.000f, 0.156f);
+	colors[ImGuiCol_DragDropTarget] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_NavHighlight] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_NavWindowingHighlight] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
+	colors[ImGuiCol_NavWindowingDimBg] = ImVec4(0.000f, 0.000f, 0.000f, 0.586f);
+	colors[ImGuiCol_ModalWindowDimBg] = ImVec4(0.000f, 0.000f, 0.000f, 0.586f);
 
-		File(const cf_file_t& rawFile)
-			:name(rawFile.name), path(rawFile.path),
-			ext(rawFile.ext), size(rawFile.size)
-		{
-			const size_t last_slash_idx = path.rfind('/');
-			if (std::string::npos != last_slash_idx)
-			{
-				directory = path.substr(0, last_slash_idx);
-			}
-		}
-	};
+	style->ChildRounding = 4.0f;
+	style->FrameBorderSize = 1.0f;
+	style->FrameRounding = 2.0f;
+	style->GrabMinSize = 7.0f;
+	style->PopupRounding = 2.0f;
+	style->ScrollbarRounding = 12.0f;
+	style->ScrollbarSize = 13.0f;
+	style->TabBorderSize = 1.0f;
+	style->TabRounding = 0.0f;
+	style->WindowRounding = 4.0f;
+}
 
-	struct Tag
-	{
-		int id = -1;
-		std::string name;
-	};
+static PreviewMode activeMode = PreviewMode::Texture;
 
-	struct FileTag
-	{
-		int id = -1;
-		int file_id;
-		int tag_id;
-	};
-
-	struct SearchPattern {
-		std::string value;
-	};
-
-	using namespace sqlite_orm;
-	auto storage = make_storage("./db.sqlite",
-
-		// note:  indexing speeds up exact query but slows down like query
-		//put `make_index` before `make_table` cause `sync_schema` is called in reverse order
-		//make_index("idx_file_name", &File::name),
-
-		make_table("files",
-			make_column("id", &File::id, autoincrement(), primary_key()),
-			make_column("name", &File::name),
-			make_column("path", &File::path, unique()),
-			make_column("ext", &File::ext),
-			make_column("size", &File::size),
-			make_column("type", &File::type),
-			make_column("dir", &File::directory)),
-
-		make_table("tags",
-			make_column("id", &Tag::id, autoincrement(), primary_key()),
-			make_column("name", &Tag::name, unique())),
-
-		make_table("fileTags",
-			make_column("id", &FileTag::id, autoincrement(), primary_key()),
-			make_column("file_id", &FileTag::file_id),
-			make_column("tag_id", &FileTag::tag_id),
-			foreign_key(&FileTag::file_id).references(&File::id),
-			foreign_key(&FileTag::tag_id).references(&Tag::id)),
-
-		make_table("searchPattern",
-			make_column("searchPattern", &SearchPattern::value))
-	);
-
-	void Init()
-	{
-		storage.sync_schema();
-	}
+// the selection is remembered by file id. the row is only where that file sits in the current
+// results, the search worker finds it again in every result it hands back
+static int selectedFileId = -1;
+static int selectedAssetIndex = -1;
 
-	void AddFile(const File& file)
-	{
-		//For a single column use `auto rows = storage.select(&User::id, where(...));
-		auto results = storage.select(&File::id, where(is_equal(&File::path, file.path)));
-		if (results.empty())
-		{
-			storage.insert(file);
-		}
-		else {
-			printf("already exist [%s]\n", file.path.c_str());
-		}
-	}
+// resident copy of the files table, replaced wholesale when the scanner or watcher changed the db
+static std::shared_ptr<const SearchIndex> searchIndex = std::make_shared<SearchIndex>();
 
-	void AddFiles(const std::vector<cf_file_t>& files)
-	{
-		storage.transaction([&] {
-			for (auto& file : files) {
-
-				auto results = storage.select(&File::id, where(is_equal(&File::path, file.path)));
-				if (results.empty()) {
-					File f;
-					f.ext = file.ext;
-					f.name = file.name;
-					f.path = file.path;
-					f.size = file.size;
-					storage.insert(f);
-				}
-			}
-			return true;  //  commit
-			});
-	}
+// what the list shows. stays on the previous results (and the index they belong to)
+// until the search worker delivers the latest generation
+static std::shared_ptr<const SearchIndex> filteredIndex = searchIndex;
+static std::vector<uint32_t> filteredFiles;  // rows into filteredIndex
 
-	void AddFiles(const std::vector<File>& files)
-	{
-		storage.transaction([&] {
-			for (auto& file : files) {
+static bool bFuzzySearch = false;
+static bool bSortByImageSize = false;
 
-				auto results = storage.select(&File::id, where(is_equal(&File::path, file.path)));
-				if (results.empty()) {
-					storage.insert(file);
-				}
-			}
-			return true;  //  commit
-			});
-	}
+// "find similar" on the selected texture replaces the name search until it is cleared
+static bool bFindSimilar = false;
+static uint64_t similarHash = 0;
+static std::string similarName;
+static int maxHashDistance = 12;
 
-	//std::vector<File> GetFilesByRoughName(const std::string& name)
-	//{
-	//	return storage.get_all<File>(where(like(&File::name, "%" + name + "%")));
-	//}
+// "sounds like this" on the selected sound, the same for the audio tab
+static bool bFindSimilarSounds = false;
+static std::vector<float> similarFingerprint;
+static std::string similarSoundName;
 
-	//std::vector<File> GetAudioFilesByRoughName(const std::string& name)
-	//{
-	//	return storage.get_all<File>(where(like(&File::name, "%" + name + "%") and is_equal(&File::type, AUDIO_FILE_TYPE)));
-	//}
+// evaluated from the tag expression whenever it or the tags change, null while the expression is empty
+static std::shared_ptr<const TagFilter> tagFilter;
+static std::string tagExpressionError;
 
-	//std::vector<File> GetTextureFilesByRoughName(const std::string& name)
-	//{
-	//	return storage.get_all<File>(where(like(&File::name, "%" + name + "%") and is_equal(&File::type, TEXTURE_FILE_TYPE)));
-	//}
+// ui thread time spent on search this frame, for the frame stats
+static Uint64 frameSearchCounter = 0;
 
-	std::vector<File> GetFilesByNameFilters(const std::string& fileType, char** tokens, int tokenCount, bool bMatchAll = true)
+// searches run on their own thread, the ui only submits and polls
+void RunSearch(SearchWorker& searchWorker, AssetType type, char** tokens, int tokenCount)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
+
+	SearchRequest request;
+	request.index = searchIndex;
+	request.type = type;
+	request.bFuzzy = bFuzzySearch;
+
+	request.bSortByImageSize = type == AssetType::Texture && bSortByImageSize;
+	request.bSimilar = (type == AssetType::Texture && bFindSimilar) || (type == AssetType::Audio && bFindSimilarSounds);
+	request.similarHash = similarHash;
+	request.maxHashDistance = maxHashDistance;
+	if (type == AssetType::Audio && bFindSimilarSounds) request.similarFingerprint = similarFingerprint;
+	request.tagFilter = tagFilter;
+	request.selectedFileId = selectedFileId;
+
+	// files can be narrowed down by their header: "stereo 48k <2s", "<=64x64 rgba"
+	for (int i = 0; i < tokenCount; i++)
 	{
-		std::vector<File> files;
-
-		if (tokenCount < 0)
+		const bool bHeaderToken =
+			(type == AssetType::Audio && SearchIndex::ParseAudioFormatToken(tokens[i], request.audioFilter)) ||
+			(type == AssetType::Texture && SearchIndex::ParseImageSizeToken(tokens[i], request.imageFilter));
+		if (!bHeaderToken)
 		{
-			printf("[error]: no token passed to GetTextureFilesByRoughNames()");
-			return files;
+			request.tokens.push_back(tokens[i]);
 		}
+	}
+	searchWorker.Submit(std::move(request));
 
-		storage.begin_transaction();
+	frameSearchCounter += SDL_GetPerformanceCounter() - start;
+}
 
-		for (int i = 0; i < tokenCount; i++)
-		{
-			const char* token = tokens[i];
-			storage.insert<SearchPattern>({ token });
-		}
+// a broken expression (e.g. while typing "(ui or") keeps the last filter that parsed
+void UpdateTagFilter(const TagIndex& tagIndex, const char* expression)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
 
-		if (bMatchAll)
-		{
-			files = storage.get_all<File>(
-				where(in(&File::id, select(&File::id,
-					where(is_equal(&File::type, fileType) and like(&File::name, conc(conc("%", &SearchPattern::value), "%"))),
-					group_by(&File::id),
-					having(is_equal(count(&SearchPattern::value),
-						select(count<SearchPattern>())))))));
-		}
-		else
+	tagExpressionError.clear();
+	if (expression[0] == '\0')
+	{
+		tagFilter.reset();
+	}
+	else
+	{
+		auto filter = std::make_shared<TagFilter>();
+		if (tagIndex.Evaluate(expression, *filter, tagExpressionError))
 		{
-			files = storage.get_all<File>(
-				where(in(&File::id, select(&File::id,
-					where(is_equal(&File::type, fileType) and like(&File::name, conc(conc("%", &SearchPattern::value), "%")))))));
+			tagFilter = std::move(filter);
 		}
+	}
 
-		storage.rollback();
+	frameSearchCounter += SDL_GetPerformanceCounter() - start;
+}
 
-		return files;
-	}
+// tags of the selected file, clicking one removes it. true if they changed
+bool DrawFileTags(TagIndex& tagIndex, int fileId)
+{
+	static std::vector<std::string> fileTags;
+	static char newTag[64] = "";
+	bool bChanged = false;
 
-	std::vector<File> GetAudioFilesByNameFilters(char** tokens, int tokenCount, bool bMatchAll = true)
+	tagIndex.GetFileTags(fileId, fileTags);
+	ImGui::Text("Tags:");
+	for (const auto& tag : fileTags)
 	{
-		return GetFilesByNameFilters(AUDIO_FILE_TYPE, tokens, tokenCount, bMatchAll);
+		ImGui::SameLine();
+		if (ImGui::SmallButton(tag.c_str()))
+		{
+			tagIndex.Untag(tag, { fileId });
+			bChanged = true;
+		}
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("remove");
 	}
 
-	std::vector<File> GetTextureFilesByNameFilters(char** tokens, int tokenCount, bool bMatchAll = true)
+	if (ImGui::InputTextWithHint("##add tag", "add tag", newTag, IM_ARRAYSIZE(newTag), ImGuiInputTextFlags_EnterReturnsTrue) &&
+		newTag[0] != '\0')
 	{
-		return GetFilesByNameFilters(TEXTURE_FILE_TYPE, tokens, tokenCount, bMatchAll);
+		bChanged |= tagIndex.Tag(newTag, { fileId });
+		newTag[0] = '\0';
 	}
+	return bChanged;
 }
 
-// todo: clean up
-namespace AudioCallback
+// index into filteredFiles, -1 clears the selection
+void SelectAsset(int index)
 {
-	void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
-	{
-		ma_decoder* pDecoder = (ma_decoder*)pDevice->pUserData;
-		if (pDecoder == NULL) {
-			return;
-		}
+	selectedAssetIndex = index;
+	selectedFileId = index >= 0 ? filteredIndex->GetId(filteredFiles[index]) : -1;
+}
 
-		ma_decoder_read_pcm_frames(pDecoder, pOutput, frameCount);
+void PollSearch(SearchWorker& searchWorker)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
 
-		(void)pInput;
+	SearchResult result;
+	if (searchWorker.Poll(result))
+	{
+		filteredIndex = std::move(result.index);
+		filteredFiles = std::move(result.rows);
+
+		// reloads and reordered results move the selected file, or drop it. a file selected
+		// after the search was submitted isn't known to the worker, its old row is meaningless now
+		selectedAssetIndex = result.selectedFileId == selectedFileId ? result.selectedIndex : -1;
+		if (selectedAssetIndex < 0) selectedFileId = -1;
 	}
+
+	frameSearchCounter += SDL_GetPerformanceCounter() - start;
 }
 
-struct AudioPreview
+// frame time history, shows that searching and loading never stall the ui thread
+struct FrameStats
 {
-	ma_device_config deviceConfig;
-	ma_device device;
-	ma_decoder decoder;
-	ma_result decodeResult;
-	ma_result initResult;
+	static const int HISTORY = 240;
+	float frameMs[HISTORY] = {};
+	float uiSearchMs[HISTORY] = {};  // time the ui thread spent submitting and polling searches
+	int cursor = 0;
+	bool bVisible = false;
 
-	AudioPreview() {}
+	void Push(float frame, float search)
+	{
+		frameMs[cursor] = frame;
+		uiSearchMs[cursor] = search;
+		cursor = (cursor + 1) % HISTORY;
+	}
 
-	AudioPreview(const std::string& filepath)
+	void Draw(const TextureLoader& textureLoader, const SearchWorker& searchWorker)
 	{
-		// todo: use format specific decoing api
-		const char* filepathCStr = filepath.c_str();
-		decodeResult = ma_decoder_init_file(filepathCStr, NULL, &decoder);
-		if (decodeResult != MA_SUCCESS) {
-			printf("Failed to decode [%s].\n", filepathCStr);
+		if (!bVisible)
+		{
 			return;
 		}
 
-		deviceConfig = ma_device_config_init(ma_device_type_playback);
-		deviceConfig.playback.format = decoder.outputFormat;
-		deviceConfig.playback.channels = decoder.outputChannels;
-		deviceConfig.sampleRate = decoder.outputSampleRate;
-		deviceConfig.dataCallback = AudioCallback::data_callback;
-		deviceConfig.pUserData = &decoder;
+		if (ImGui::Begin("Frame Stats", &bVisible, ImGuiWindowFlags_AlwaysAutoResize))
+		{
+			// buckets: <4, <8, <16.7, <33.3, >=33.3 ms
+			static const float limits[] = { 4.0f, 8.0f, 16.7f, 33.3f };
+			float buckets[5] = {};
+			float worstFrame = 0.0f;
+			float worstSearch = 0.0f;
+			for (int i = 0; i < HISTORY; i++)
+			{
+				int bucket = 0;
+				while (bucket < 4 && frameMs[i] >= limits[bucket]) bucket++;
+				buckets[bucket] += 1.0f;
+				worstFrame = std::max(worstFrame, frameMs[i]);
+				worstSearch = std::max(worstSearch, uiSearchMs[i]);
+			}
 
-		initResult = ma_device_init(NULL, &deviceConfig, &device);
-		if (initResult != MA_SUCCESS) {
-			printf("Failed to open playback device.\n");
+			ImGui::PlotLines("frame ms", frameMs, HISTORY, cursor, NULL, 0.0f, 33.3f, ImVec2(300, 60));
+			ImGui::PlotHistogram("<4 <8 <16 <33 >33", buckets, 5, 0, NULL, 0.0f, (float)HISTORY, ImVec2(300, 60));
+			ImGui::Text("worst frame: %.2f ms", worstFrame);
+			ImGui::Text("worst ui time in search: %.3f ms", worstSearch);
+			ImGui::Text("search worker: %s", searchWorker.IsBusy() ? "busy" : "idle");
+
+			const TextureCacheStats& cache = textureLoader.GetStats();
+			ImGui::Separator();
+			ImGui::Text("textures: %d resident, %.1f / %.1f mb",
+				cache.residentCount,
+				cache.residentBytes / (1024.0 * 1024.0), cache.budgetBytes / (1024.0 * 1024.0));
+			ImGui::Text("hits: %llu  misses: %llu  evictions: %llu",
+				(unsigned long long)cache.hits, (unsigned long long)cache.misses, (unsigned long long)cache.evictions);
 		}
+		ImGui::End();
 	}
+};
 
-	bool isValid() const {
-		return
-			decodeResult == MA_SUCCESS
-			&&
-			initResult == MA_SUCCESS;
+static FrameStats frameStats;
+
+// byte identical files, opened from the view menu. hashing only runs while this is shown
+static bool bShowDuplicates = false;
+
+static void DrawDuplicates(const DuplicateFinder& duplicateFinder)
+{
+	if (!bShowDuplicates)
+	{
+		return;
 	}
 
-	bool Play()
+	ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_FirstUseEver);
+	if (ImGui::Begin("Duplicates", &bShowDuplicates))
 	{
-		if (!isValid())
+		const auto& progress = duplicateFinder.GetProgress();
+		const int queued = progress.filesQueued.load();
+		if (!progress.bDone && queued > 0)
 		{
-			printf("Audio not initialized\n");
-			return false;
+			const int hashed = progress.filesHashed.load();
+
+			char overlay[64];
+			snprintf(overlay, sizeof(overlay), "hashing %d/%d, %.1f mb", hashed, queued, progress.bytesHashed.load() / (1024.0 * 1024.0));
+			ImGui::ProgressBar((float)hashed / (float)queued, ImVec2(-1, 0), overlay);
 		}
-		if (ma_device_is_started(&device))
+
+		const std::vector<DuplicateGroup>& groups = duplicateFinder.GetGroups();
+		ImGui::Text("%d groups, %.1f mb reclaimable", (int)groups.size(), duplicateFinder.GetReclaimableBytes() / (1024.0 * 1024.0));
+		ImGui::Separator();
+
+		ImGui::BeginChild("groups");
+		ImGuiListClipper clipper;
+		clipper.Begin((int)groups.size());
+		while (clipper.Step())
 		{
-			printf("Audio already playing\n");
-			return false;
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+			{
+				const DuplicateGroup& group = groups[i];
+				ImGui::PushID(i);
+				if (ImGui::TreeNode("group", "%d copies of %.1f kb, %.1f mb reclaimable", (int)group.paths.size(),
+					group.size / 1024.0, group.GetReclaimableBytes() / (1024.0 * 1024.0)))
+				{
+					for (const std::string& path : group.paths)
+					{
+						ImGui::TextUnformatted(path.c_str());
+					}
+					ImGui::TreePop();
+				}
+				ImGui::PopID();
+			}
 		}
+		ImGui::EndChild();
+	}
+	ImGui::End();
+}
 
-		ma_result playResult = ma_device_start(&device);
-		if (playResult != MA_SUCCESS) {
-			printf("Failed to start playback device.\n");
-			return false;
-		}
+// set by keyboard navigation, the list scrolls the selection into view on its next draw
+static bool bScrollToSelection = false;
+
+// keeps the item in the current window's visible region
+static void ScrollIntoView(float itemTop, float itemHeight)
+{
+	const float scrollY = ImGui::GetScrollY();
+	const float visibleHeight = ImGui::GetWindowHeight();
 
-		return true;
+	if (itemTop < scrollY)
+	{
+		ImGui::SetScrollY(itemTop);
+	}
+	else if (itemTop + itemHeight > scrollY + visibleHeight)
+	{
+		ImGui::SetScrollY(itemTop + itemHeight - visibleHeight);
 	}
+}
+
+// virtualized: only the rows inside the visible region are laid out and drawn,
+// so the per frame cost doesn't depend on the number of results
+void DrawAssetList()
+{
+	// own scroll region, keeps its scroll position across searches
+	ImGui::BeginChild("##AssetList");
 
-	bool Stop()
+	ImGuiListClipper clipper;
+	clipper.Begin((int)filteredFiles.size());
+	while (clipper.Step())
 	{
-		if (ma_device_is_started(&device))
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
 		{
-			ma_decoder_seek_to_pcm_frame(&decoder, 0);
-			ma_result stopResult = ma_device_stop(&device);
-			return stopResult == MA_SUCCESS;
+			// names aren't unique across directories
+			ImGui::PushID(i);
+			const char* filenameCstr = filteredIndex->GetName(filteredFiles[i]);
+			if (ImGui::Selectable(filenameCstr, selectedAssetIndex == i))
+				SelectAsset(i);
+			ImGui::PopID();
 		}
+	}
+	clipper.End();
 
-		return false;
+	if (bScrollToSelection && selectedAssetIndex >= 0)
+	{
+		const float itemHeight = ImGui::GetTextLineHeightWithSpacing();
+		ScrollIntoView(selectedAssetIndex * itemHeight, itemHeight);
 	}
+	bScrollToSelection = false;
+
+	ImGui::EndChild();
+}
 
-	void Pause()
+static bool bThumbnailGrid = false;
+
+struct ThumbnailQuad
+{
+	GLuint textureId;
+	ImVec2 min;
+	ImVec2 max;
+	ImVec2 uv0;
+	ImVec2 uv1;
+};
+static std::vector<ThumbnailQuad> thumbnailQuads;
+
+// same virtualization as the list, clipped by rows of cells.
+// only visible cells request their thumbnail, which cancels loads for cells scrolled past.
+// thumbnails come from a few atlas pages, so a screen of them is a handful of draw calls
+void DrawAssetGrid(ThumbnailCache& thumbnailCache)
+{
+	ImGui::BeginChild("##AssetGrid");
+
+	const float thumbnailSize = (float)ThumbnailCache::THUMBNAIL_SIZE;
+	const float spacing = ImGui::GetStyle().ItemSpacing.x;
+	const float cellSize = thumbnailSize + spacing;
+	const int columns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + spacing) / cellSize));
+	const int count = (int)filteredFiles.size();
+	const int rows = (count + columns - 1) / columns;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	thumbnailQuads.clear();
+
+	ImGuiListClipper clipper;
+	clipper.Begin(rows, thumbnailSize + ImGui::GetStyle().ItemSpacing.y);
+	while (clipper.Step())
 	{
-		if (ma_device_is_started(&device))
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
 		{
-			ma_result stopResult = ma_device_stop(&device);
+			for (int column = 0; column < columns; column++)
+			{
+				const int i = row * columns + column;
+				if (i >= count)
+				{
+					break;
+				}
 
-			if (stopResult != MA_SUCCESS) {
-				printf("Failed to pause playback device.\n");
-				Dispose();
+				const uint32_t fileRow = filteredFiles[i];
+				const ThumbnailSlot& slot = thumbnailCache.Request(
+					filteredIndex->GetId(fileRow), filteredIndex->GetMtime(fileRow), filteredIndex->GetPath(fileRow));
+
+				if (column > 0) ImGui::SameLine();
+
+				ImGui::PushID(i);
+				if (ImGui::Selectable("##cell", selectedAssetIndex == i, 0, ImVec2(thumbnailSize, thumbnailSize)))
+					SelectAsset(i);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", filteredIndex->GetName(fileRow));
+				ImGui::PopID();
+
+				// centered in the cell, drawn over the selectables once all cells are laid out
+				const ImVec2 cellMin = ImGui::GetItemRectMin();
+				if (slot.state == TextureState::Ready)
+				{
+					ThumbnailQuad quad;
+					quad.textureId = slot.textureId;
+					quad.min = ImVec2(cellMin.x + (thumbnailSize - slot.width) * 0.5f, cellMin.y + (thumbnailSize - slot.height) * 0.5f);
+					quad.max = ImVec2(quad.min.x + slot.width, quad.min.y + slot.height);
+					quad.uv0 = ImVec2(slot.u0, slot.v0);
+					quad.uv1 = ImVec2(slot.u1, slot.v1);
+					thumbnailQuads.push_back(quad);
+				}
+				else
+				{
+					drawList->AddRect(cellMin, ImVec2(cellMin.x + thumbnailSize, cellMin.y + thumbnailSize),
+						ImGui::GetColorU32(ImGuiCol_TextDisabled));
+				}
 			}
 		}
 	}
+	clipper.End();
 
-	void Dispose()
+	// grouped by atlas page, imgui merges consecutive images of the same texture into one draw command
+	std::stable_sort(thumbnailQuads.begin(), thumbnailQuads.end(),
+		[](const ThumbnailQuad& a, const ThumbnailQuad& b) { return a.textureId < b.textureId; });
+	for (const ThumbnailQuad& quad : thumbnailQuads)
 	{
-		ma_device_uninit(&device);
-		ma_decoder_uninit(&decoder);
+		drawList->AddImage((void*)(intptr_t)quad.textureId, quad.min, quad.max, quad.uv0, quad.uv1);
 	}
 
-	~AudioPreview()
+	if (bScrollToSelection && selectedAssetIndex >= 0)
 	{
-		Dispose();
+		const float rowHeight = thumbnailSize + ImGui::GetStyle().ItemSpacing.y;
+		ScrollIntoView((selectedAssetIndex / columns) * rowHeight, rowHeight);
 	}
-};
+	bScrollToSelection = false;
+
+	ImGui::EndChild();
+}
 
-bool LoadTextureFromFile(const std::string& filename, GLuint* out_texture, int* out_width, int* out_height)
+// one vertical line per pixel column from the coarsest pyramid level that still covers every column
+static void DrawWaveform(const db::Waveform& waveform, float playbackFraction)
 {
-	// Load from file
-	int image_width = 0;
-	int image_height = 0;
-	const char* filenameCstr = filename.c_str();
-	unsigned char* image_data = stbi_load(filenameCstr, &image_width, &image_height, NULL, 4);
-	if (image_data == NULL)
+	const float width = std::max(1.0f, ImGui::GetContentRegionAvail().x);
+	const float height = 80.0f;
+	const ImVec2 min = ImGui::GetCursorScreenPos();
+	const ImVec2 max(min.x + width, min.y + height);
+	ImGui::Dummy(ImVec2(width, height));
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(min, max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+	const int columns = (int)width;
+	int buckets = 0;
+	const int8_t* peaks = GetWaveformLevel(waveform, columns, buckets);
+	if (!peaks || buckets == 0)
 	{
-		printf("failed to load image: [%s]\n", filenameCstr);
-		return false;
+		return;
 	}
-	else
-	{
-		printf("loaded image: [%s]\n", filenameCstr);
-	}
-
-	// Create a OpenGL texture identifier
-	GLuint image_texture;
-	glGenTextures(1, &image_texture);
-	glBindTexture(GL_TEXTURE_2D, image_texture);
 
-	// Setup filtering parameters for display
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
+	const float centerY = (min.y + max.y) * 0.5f;
+	const float scale = height * 0.5f / 127.0f;
+	const ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotLines);
+	for (int x = 0; x < columns; x++)
+	{
+		const int begin = x * buckets / columns;
+		const int end = std::max(begin + 1, (x + 1) * buckets / columns);
 
-	// Upload pixels into texture
-#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-	stbi_image_free(image_data);
+		int8_t low = peaks[2 * begin];
+		int8_t high = peaks[2 * begin + 1];
+		for (int bucket = begin + 1; bucket < end; bucket++)
+		{
+			low = std::min(low, peaks[2 * bucket]);
+			high = std::max(high, peaks[2 * bucket + 1]);
+		}
 
-	*out_texture = image_texture;
-	*out_width = image_width;
-	*out_height = image_height;
+		// keep silence visible as a flat line
+		const float top = centerY - high * scale;
+		const float bottom = std::max(centerY - low * scale, top + 1.0f);
+		drawList->AddLine(ImVec2(min.x + x + 0.5f, top), ImVec2(min.x + x + 0.5f, bottom), color);
+	}
 
-	return true;
+	if (playbackFraction > 0.0f)
+	{
+		const float cursorX = min.x + width * playbackFraction;
+		drawList->AddLine(ImVec2(cursorX, min.y), ImVec2(cursorX, max.y), ImGui::GetColorU32(ImGuiCol_PlotLinesHovered));
+	}
 }
 
-void ConfigImguiStyle()
-{
-	ImGuiStyle* style = &ImGui::GetStyle();
-	ImVec4* colors = style->Colors;
+static bool bOscilloscope = false;
 
-	colors[ImGuiCol_Text] = ImVec4(1.000f, 1.000f, 1.000f, 1.000f);
-	colors[ImGuiCol_TextDisabled] = ImVec4(0.500f, 0.500f, 0.500f, 1.000f);
-	colors[ImGuiCol_WindowBg] = ImVec4(0.180f, 0.180f, 0.180f, 1.000f);
-	colors[ImGuiCol_ChildBg] = ImVec4(0.280f, 0.280f, 0.280f, 0.000f);
-	colors[ImGuiCol_PopupBg] = ImVec4(0.313f, 0.313f, 0.313f, 1.000f);
-	colors[ImGuiCol_Border] = ImVec4(0.266f, 0.266f, 0.266f, 1.000f);
-	colors[ImGuiCol_BorderShadow] = ImVec4(0.000f, 0.000f, 0.000f, 0.000f);
-	colors[ImGuiCol_FrameBg] = ImVec4(0.160f, 0.160f, 0.160f, 1.000f);
-	colors[ImGuiCol_FrameBgHovered] = ImVec4(0.200f, 0.200f, 0.200f, 1.000f);
-	colors[ImGuiCol_FrameBgActive] = ImVec4(0.280f, 0.280f, 0.280f, 1.000f);
-	colors[ImGuiCol_TitleBg] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
-	colors[ImGuiCol_TitleBgActive] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
-	colors[ImGuiCol_TitleBgCollapsed] = ImVec4(0.148f, 0.148f, 0.148f, 1.000f);
-	colors[ImGuiCol_MenuBarBg] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
-	colors[ImGuiCol_ScrollbarBg] = ImVec4(0.160f, 0.160f, 0.160f, 1.000f);
-	colors[ImGuiCol_ScrollbarGrab] = ImVec4(0.277f, 0.277f, 0.277f, 1.000f);
-	colors[ImGuiCol_ScrollbarGrabHovered] = ImVec4(0.300f, 0.300f, 0.300f, 1.000f);
-	colors[ImGuiCol_ScrollbarGrabActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_CheckMark] = ImVec4(1.000f, 1.000f, 1.000f, 1.000f);
-	colors[ImGuiCol_SliderGrab] = ImVec4(0.391f, 0.391f, 0.391f, 1.000f);
-	colors[ImGuiCol_SliderGrabActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_Button] = ImVec4(1.000f, 1.000f, 1.000f, 0.000f);
-	colors[ImGuiCol_ButtonHovered] = ImVec4(1.000f, 1.000f, 1.000f, 0.156f);
-	colors[ImGuiCol_ButtonActive] = ImVec4(1.000f, 1.000f, 1.000f, 0.391f);
-	colors[ImGuiCol_Header] = ImVec4(0.313f, 0.313f, 0.313f, 1.000f);
-	colors[ImGuiCol_HeaderHovered] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
-	colors[ImGuiCol_HeaderActive] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
-	colors[ImGuiCol_Separator] = colors[ImGuiCol_Border];
-	colors[ImGuiCol_SeparatorHovered] = ImVec4(0.391f, 0.391f, 0.391f, 1.000f);
-	colors[ImGuiCol_SeparatorActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_ResizeGrip] = ImVec4(1.000f, 1.000f, 1.000f, 0.250f);
-	colors[ImGuiCol_ResizeGripHovered] = ImVec4(1.000f, 1.000f, 1.000f, 0.670f);
-	colors[ImGuiCol_ResizeGripActive] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_Tab] = ImVec4(0.098f, 0.098f, 0.098f, 1.000f);
-	colors[ImGuiCol_TabHovered] = ImVec4(0.352f, 0.352f, 0.352f, 1.000f);
-	colors[ImGuiCol_TabActive] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
-	colors[ImGuiCol_TabUnfocused] = ImVec4(0.098f, 0.098f, 0.098f, 1.000f);
-	colors[ImGuiCol_TabUnfocusedActive] = ImVec4(0.195f, 0.195f, 0.195f, 1.000f);
-	//colors[ImGuiCol_preview] = ImVec4(1.000f, 0.391f, 0.000f, 0.781f);
-	//colors[ImGuiCol_DockingEmptyBg] = ImVec4(0.180f, 0.180f, 0.180f, 1.000f);
-	colors[ImGuiCol_PlotLines] = ImVec4(0.469f, 0.469f, 0.469f, 1.000f);
-	colors[ImGuiCol_PlotLinesHovered] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_PlotHistogram] = ImVec4(0.586f, 0.586f, 0.586f, 1.000f);
-	colors[ImGuiCol_PlotHistogramHovered] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_TextSelectedBg] = ImVec4(1.000f, 1.000f, 1.000f, 0.156f);
-	colors[ImGuiCol_DragDropTarget] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_NavHighlight] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_NavWindowingHighlight] = ImVec4(1.000f, 0.391f, 0.000f, 1.000f);
-	colors[ImGuiCol_NavWindowingDimBg] = ImVec4(0.000f, 0.000f, 0.000f, 0.586f);
-	colors[ImGuiCol_ModalWindowDimBg] = ImVec4(0.000f, 0.000f, 0.000f, 0.586f);
+// log spaced bands of the live spectrum as bars
+static void DrawSpectrum(const SpectrumAnalyzer& spectrum)
+{
+	const float width = std::max(1.0f, ImGui::GetContentRegionAvail().x);
+	const float height = 100.0f;
+	const ImVec2 min = ImGui::GetCursorScreenPos();
+	const ImVec2 max(min.x + width, min.y + height);
+	ImGui::Dummy(ImVec2(width, height));
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(min, max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+	const float* bands = spectrum.GetBands();
+	const float barWidth = width / SpectrumAnalyzer::BAND_COUNT;
+	const ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+	for (int band = 0; band < SpectrumAnalyzer::BAND_COUNT; band++)
+	{
+		const float level = 1.0f - bands[band] / SpectrumAnalyzer::FLOOR_DB;
+		if (level <= 0.0f)
+		{
+			continue;
+		}
 
-	style->ChildRounding = 4.0f;
-	style->FrameBorderSize = 1.0f;
-	style->FrameRounding = 2.0f;
-	style->GrabMinSize = 7.0f;
-	style->PopupRounding = 2.0f;
-	style->ScrollbarRounding = 12.0f;
-	style->ScrollbarSize = 13.0f;
-	style->TabBorderSize = 1.0f;
-	style->TabRounding = 0.0f;
-	style->WindowRounding = 4.0f;
+		const float x = min.x + band * barWidth;
+		drawList->AddRectFilled(ImVec2(x + 1.0f, max.y - level * height), ImVec2(x + barWidth - 1.0f, max.y), color);
+	}
 }
 
-static std::vector<db::File> scannedFiles;
-static std::vector<db::File> filteredFiles;
-
-static PreviewMode activeMode = PreviewMode::Texture;
-static int selectedAssetIndex = -1;
-
+// the analysis window as a line, one point per pixel column
+static void DrawOscilloscope(const SpectrumAnalyzer& spectrum)
+{
+	const float width = std::max(1.0f, ImGui::GetContentRegionAvail().x);
+	const float height = 100.0f;
+	const ImVec2 min = ImGui::GetCursorScreenPos();
+	const ImVec2 max(min.x + width, min.y + height);
+	ImGui::Dummy(ImVec2(width, height));
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(min, max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+	const float* samples = spectrum.GetSamples();
+	const int columns = std::min((int)width, SpectrumAnalyzer::FFT_SIZE);
+	const float centerY = (min.y + max.y) * 0.5f;
+	const float scale = height * 0.5f;
+
+	static ImVec2 points[SpectrumAnalyzer::FFT_SIZE];
+	for (int x = 0; x < columns; x++)
+	{
+		const float sample = std::min(1.0f, std::max(-1.0f, samples[x * SpectrumAnalyzer::FFT_SIZE / columns]));
+		points[x] = ImVec2(min.x + x * width / columns, centerY - sample * scale);
+	}
+	drawList->AddPolyline(points, columns, ImGui::GetColorU32(ImGuiCol_PlotLines), false, 1.0f);
+}
 
 void OnAssetBrowserTabSwitch()
 {
-	selectedAssetIndex = -1;
+	SelectAsset(-1);
 }
 
 int main(int argc, char const* argv[])
@@ -479,8 +638,15 @@ int main(int argc, char const* argv[])
 	SDL_Window* window = NULL;
 	SDL_Surface* screenSurface = NULL;
 
-	std::unordered_map<std::string, TexturePreview> texturePreviewMap;
-	std::unordered_map<std::string, AudioPreview*> audioPreviewMap;
+	TextureLoader textureLoader;
+	ThumbnailCache thumbnailCache;
+	AudioEngine audioEngine;
+	AudioAnalyzer audioAnalyzer;
+	DuplicateFinder duplicateFinder;
+	ImageHasher imageHasher;
+	TagIndex tagIndex;
+	SpectrumAnalyzer spectrumAnalyzer;
+	SearchWorker searchWorker;
 
 	static char filterStr[256] = "";
 	static char filterStrCopy[256] = "";
@@ -577,76 +743,59 @@ int main(int argc, char const* argv[])
 		// init database
 		{
 			db::Init();
+			tagIndex.LoadFromDb();
 		}
 
-		// load files
-		{
-			scannedFiles.reserve(500);
-			const auto fileTraverse = [](cf_file_t* fileOnStack, void* udata)
-			{
-				cf_file_t rawfile = *fileOnStack;
+		// scan files in the background, the browser fills in as batches get committed
+		const std::vector<std::string> assetRoots(std::begin(assetPaths), std::end(assetPaths));
+		AssetScanner scanner;
+		scanner.Start(assetRoots);
+		Uint32 lastScanRefreshTicks = 0;
 
-				db::File file(rawfile);
-				if (file.ext.compare(".png") == 0 ||
-					file.ext.compare(".jpg") == 0)
-				{
-					file.type = db::TEXTURE_FILE_TYPE;
-					scannedFiles.push_back(file);
-				}
-				else if (
-					file.ext.compare(".ogg") == 0 ||
-					file.ext.compare(".mp3") == 0 ||
-					file.ext.compare(".wav") == 0)
-				{
-					file.type = db::AUDIO_FILE_TYPE;
-					scannedFiles.push_back(file);
-				}
-			};
+		// keeps the index current once the initial scan is done
+		FileWatcher watcher;
 
-			for (const auto& assetPath : assetPaths)
-			{
-				cf_traverse(assetPath, fileTraverse, 0);
-			}
-		}
-		db::AddFiles(scannedFiles);
-		scannedFiles.clear();
+		// watcher and analysis stages are started once per scan, the watcher may not be able to run at all
+		bool bPostScanStagesStarted = false;
 
 		bool bFilteredForAudio = false;
 		bool bFilteredForTexture = false;
 
+		// how often the search index is reloaded after changes, e.g. a watcher batch
+		const Uint32 SCAN_REFRESH_INTERVAL_MS = 500;
+		// every reload reads the whole files table again. while the scanner, analyzer or hasher keep
+		// committing, reloads are spaced out to this, or to 10x the last reload if that takes longer.
+		// the stage finishing triggers one more reload at the normal interval
+		const Uint32 BULK_REFRESH_INTERVAL_MS = 3000;
+		const Uint32 BULK_REFRESH_LOAD_FACTOR = 10;
+		Uint32 searchIndexLoadStartTicks = 0;
+		Uint32 lastSearchIndexLoadMs = 0;
+
+		// the index is reloaded off the render thread, whatever the db had last session shows up right away
+		std::future<std::shared_ptr<SearchIndex>> pendingSearchIndex;
+		bool bSearchIndexStale = true;
+
+		// tags changed this frame, the filter and the results are refreshed next frame
+		bool bTagsDirty = false;
+
+		const double counterToMs = 1000.0 / (double)SDL_GetPerformanceFrequency();
+		Uint64 lastFrameCounter = SDL_GetPerformanceCounter();
+
 		SDL_Event sdlEvent;
 		while (bRunning)
 		{
+			frameSearchCounter = 0;
+
 			while (SDL_PollEvent(&sdlEvent) != 0)
 			{
 				ImGui_ImplSDL2_ProcessEvent(&sdlEvent);
 
 				switch (sdlEvent.type) {
 				case SDL_KEYDOWN:
-					break;
-
-				case SDL_KEYUP:
 				{
+					// on key down so holding the key repeats
 					const auto& keycode = sdlEvent.key.keysym.sym;
-					if (keycode == SDLK_SPACE)
-					{
-						if (activeMode == PreviewMode::Audio)
-						{
-							if (!filteredFiles.empty() &&
-								selectedAssetIndex >= 0 &&
-								selectedAssetIndex < filteredFiles.size())
-							{
-								const auto& file = filteredFiles[selectedAssetIndex];
-								if (audioPreviewMap.find(file.path) == audioPreviewMap.end())
-								{
-									audioPreviewMap[file.path] = new AudioPreview(file.path);
-								}
-								auto const audioPreview = audioPreviewMap[file.path];
-								if (!audioPreview->Play()) audioPreview->Pause();
-							}
-						}
-					}
-					else if (keycode == SDLK_UP || keycode == SDLK_DOWN)
+					if (keycode == SDLK_UP || keycode == SDLK_DOWN)
 					{
 						if (!filteredFiles.empty() &&
 							selectedAssetIndex != -1) // only navigate when focusing on asset list
@@ -654,10 +803,30 @@ int main(int argc, char const* argv[])
 							int listsize = filteredFiles.size();
 
 							int dir = (keycode == SDLK_UP ? -1 : 1);
-							selectedAssetIndex += dir;
+							int index = selectedAssetIndex + dir;
+
+							if (index < 0) index = listsize - 1;
+							else if (index >= listsize) index = 0;
+							SelectAsset(index);
+
+							bScrollToSelection = true;
+						}
+					}
+					break;
+				}
 
-							if (selectedAssetIndex < 0) selectedAssetIndex = listsize - 1;
-							else if (selectedAssetIndex >= listsize) selectedAssetIndex = 0;
+				case SDL_KEYUP:
+				{
+					const auto& keycode = sdlEvent.key.keysym.sym;
+					if (keycode == SDLK_SPACE)
+					{
+						if (activeMode == PreviewMode::Audio &&
+							!filteredFiles.empty() &&
+							selectedAssetIndex >= 0 &&
+							selectedAssetIndex < filteredFiles.size())
+						{
+							if (audioEngine.IsPlaying()) audioEngine.Pause();
+							else audioEngine.Play();
 						}
 					}
 					break;
@@ -672,6 +841,96 @@ int main(int argc, char const* argv[])
 				}
 			}
 
+			PollSearch(searchWorker);
+
+			// pick up newly scanned files
+			{
+				if (scanner.GetProgress().bDone && !bPostScanStagesStarted)
+				{
+					bPostScanStagesStarted = true;
+					watcher.Start(assetRoots);
+					audioAnalyzer.Start();
+					imageHasher.Start();
+					if (bShowDuplicates) duplicateFinder.Start();
+				}
+
+				// the kernel dropped events, only a rescan can tell what changed
+				if (watcher.ConsumeRescanRequest())
+				{
+					watcher.Stop();
+					scanner.Stop();
+					scanner.Start(assetRoots);
+					bPostScanStagesStarted = false;
+				}
+
+				const Uint32 ticks = SDL_GetTicks();
+				const bool bBulkRunning = !scanner.GetProgress().bDone ||
+					!audioAnalyzer.GetProgress().bDone || !imageHasher.GetProgress().bDone;
+				const Uint32 refreshInterval = bBulkRunning ?
+					std::max(BULK_REFRESH_INTERVAL_MS, lastSearchIndexLoadMs * BULK_REFRESH_LOAD_FACTOR) : SCAN_REFRESH_INTERVAL_MS;
+				if (ticks - lastScanRefreshTicks > refreshInterval)
+				{
+					const bool bScannerDirty = scanner.ConsumeDirty();
+					const bool bWatcherDirty = watcher.ConsumeDirty();
+
+					// new hashes and fingerprints only need the index reloaded
+					const bool bAnalyzerDirty = audioAnalyzer.ConsumeDirty();
+					if (imageHasher.ConsumeDirty() || bAnalyzerDirty)
+					{
+						lastScanRefreshTicks = ticks;
+						bSearchIndexStale = true;
+					}
+					if (bScannerDirty || bWatcherDirty)
+					{
+						lastScanRefreshTicks = ticks;
+						bSearchIndexStale = true;
+
+						// new or changed sounds and images, analyzed once the scan is through
+						if (scanner.GetProgress().bDone)
+						{
+							audioAnalyzer.Start();
+							imageHasher.Start();
+							if (bShowDuplicates) duplicateFinder.Start();
+						}
+					}
+				}
+
+				if (pendingSearchIndex.valid() &&
+					pendingSearchIndex.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				{
+					searchIndex = pendingSearchIndex.get();
+					lastSearchIndexLoadMs = SDL_GetTicks() - searchIndexLoadStartTicks;
+					bFilteredForAudio = false;
+					bFilteredForTexture = false;
+				}
+
+				if (bSearchIndexStale && !pendingSearchIndex.valid())
+				{
+					pendingSearchIndex = std::async(std::launch::async, SearchIndex::LoadFromDb);
+					searchIndexLoadStartTicks = SDL_GetTicks();
+					bSearchIndexStale = false;
+				}
+			}
+
+			// upload what finished decoding since last frame
+			textureLoader.Update();
+			thumbnailCache.Update();
+			audioEngine.Update();
+			audioAnalyzer.Update();
+			imageHasher.Update();
+			duplicateFinder.Update();
+
+			// drained every frame, even with the audio pane hidden, so the visualizer never starts on stale samples
+			{
+				static float visualizerSamples[4096];
+				size_t count = 0;
+				while ((count = audioEngine.ReadVisualizerSamples(visualizerSamples, IM_ARRAYSIZE(visualizerSamples))) > 0)
+				{
+					spectrumAnalyzer.Push(visualizerSamples, count);
+				}
+				spectrumAnalyzer.Update(audioEngine.GetDeviceSampleRate(), io.DeltaTime);
+			}
+
 			// imgui begin
 			{
 				ImGui_ImplOpenGL3_NewFrame();
@@ -696,6 +955,20 @@ int main(int argc, char const* argv[])
 						if (ImGui::MenuItem("Close")) bActive = false;
 						ImGui::EndMenu();
 					}
+					if (ImGui::BeginMenu("View"))
+					{
+						ImGui::MenuItem("Frame Stats", NULL, &frameStats.bVisible);
+
+						// an extra stage, files are only read once someone asks for duplicates
+						if (ImGui::MenuItem("Duplicates", NULL, &bShowDuplicates) && bShowDuplicates && scanner.GetProgress().bDone)
+							duplicateFinder.Start();
+
+						// only offered when the gpu can sample s3tc
+						bool bCompressPreviews = textureLoader.IsCompressionEnabled();
+						if (ImGui::MenuItem("Compressed Previews", NULL, &bCompressPreviews, textureLoader.IsCompressionSupported()))
+							textureLoader.SetCompression(bCompressPreviews);
+						ImGui::EndMenu();
+					}
 					ImGui::EndMenuBar();
 				}
 
@@ -704,6 +977,93 @@ int main(int argc, char const* argv[])
 					ImGui::BeginChild("left pane", ImVec2(200, 0), true);
 
 					bool bFilterStrDirty = ImGui::InputText(ICON_FA_SEARCH, filterStr, IM_ARRAYSIZE(filterStr));
+					bFilterStrDirty |= ImGui::Checkbox("Fuzzy", &bFuzzySearch);
+
+					// "ui and (sfx or music) not wip", intersected with the name matches
+					{
+						static char tagExpression[128] = "";
+						if (ImGui::InputText(ICON_FA_TAGS, tagExpression, IM_ARRAYSIZE(tagExpression)) || bTagsDirty)
+						{
+							UpdateTagFilter(tagIndex, tagExpression);
+							bFilterStrDirty = true;
+							bTagsDirty = false;
+						}
+						if (!tagExpressionError.empty())
+						{
+							ImGui::TextDisabled("%s", tagExpressionError.c_str());
+						}
+
+						// bulk tagging of whatever the search currently shows
+						static char bulkTag[64] = "";
+						ImGui::SetNextItemWidth(-1);
+						ImGui::InputTextWithHint("##bulk tag", "tag results", bulkTag, IM_ARRAYSIZE(bulkTag));
+						if (bulkTag[0] != '\0' && !filteredFiles.empty())
+						{
+							const bool bTag = ImGui::Button("Tag");
+							ImGui::SameLine();
+							const bool bUntag = ImGui::Button("Untag");
+							ImGui::SameLine();
+							ImGui::TextDisabled("%d files", (int)filteredFiles.size());
+
+							if (bTag || bUntag)
+							{
+								std::vector<int> fileIds;
+								fileIds.reserve(filteredFiles.size());
+								for (uint32_t row : filteredFiles)
+								{
+									fileIds.push_back(filteredIndex->GetId(row));
+								}
+
+								if (bTag) tagIndex.Tag(bulkTag, fileIds);
+								else tagIndex.Untag(bulkTag, fileIds);
+								UpdateTagFilter(tagIndex, tagExpression);
+								bFilterStrDirty = true;
+							}
+						}
+					}
+
+					// scan progress
+					{
+						const auto& progress = scanner.GetProgress();
+						if (!progress.bDone)
+						{
+							const int queued = progress.directoriesQueued.load();
+							const int scanned = progress.directoriesScanned.load();
+							const float fraction = queued > 0 ? (float)scanned / (float)queued : 0.0f;
+
+							char overlay[64];
+							snprintf(overlay, sizeof(overlay), "%d files", progress.filesWritten.load());
+							ImGui::ProgressBar(fraction, ImVec2(-1, 0), overlay);
+						}
+					}
+
+					// audio analysis progress
+					{
+						const auto& progress = audioAnalyzer.GetProgress();
+						const int queued = progress.filesQueued.load();
+						if (!progress.bDone && queued > 0)
+						{
+							const int analyzed = progress.filesAnalyzed.load();
+
+							char overlay[64];
+							snprintf(overlay, sizeof(overlay), "analyzing %d/%d", analyzed, queued);
+							ImGui::ProgressBar((float)analyzed / (float)queued, ImVec2(-1, 0), overlay);
+						}
+					}
+
+					// image hashing progress
+					{
+						const auto& progress = imageHasher.GetProgress();
+						const int queued = progress.filesQueued.load();
+						if (!progress.bDone && queued > 0)
+						{
+							const int hashed = progress.filesHashed.load();
+
+							char overlay[64];
+							snprintf(overlay, sizeof(overlay), "hashing %d/%d", hashed, queued);
+							ImGui::ProgressBar((float)hashed / (float)queued, ImVec2(-1, 0), overlay);
+						}
+					}
 
 
 
@@ -734,7 +1094,7 @@ int main(int argc, char const* argv[])
 
 							if (bFilterStrDirty || !bFilteredForTexture)
 							{
-								filteredFiles = db::GetTextureFilesByNameFilters(filterStrTokens, filterStrTokenCount);
+								RunSearch(searchWorker, AssetType::Texture, filterStrTokens, filterStrTokenCount);
 
 								// todo: cleanier way to manage these states?
 								{
@@ -743,16 +1103,32 @@ int main(int argc, char const* argv[])
 								}
 							}
 
-							for (int i = 0; i < filteredFiles.size(); i++)
+							if (bFindSimilar)
+							{
+								ImGui::TextWrapped("Similar to %s", similarName.c_str());
+								ImGui::SetNextItemWidth(-1);
+								bool bSimilarDirty = ImGui::SliderInt("##distance", &maxHashDistance, 0, 24, "distance %d");
+								if (ImGui::Button("Clear"))
+								{
+									bFindSimilar = false;
+									bSimilarDirty = true;
+								}
+								if (bSimilarDirty)
+								{
+									bFilteredForTexture = false;
+								}
+							}
+
+							ImGui::Checkbox("Grid", &bThumbnailGrid);
+							ImGui::SameLine();
+							if (ImGui::Checkbox("Smallest first", &bSortByImageSize))
 							{
-								const auto& file = filteredFiles[i];
-								const auto& filenameCstr = file.name.c_str();
-								//if (fts::fuzzy_match_simple(filterStr, filenameCstr))
-								//{
-								if (ImGui::Selectable(filenameCstr, selectedAssetIndex == i))
-									selectedAssetIndex = i;
-								//}
+								RunSearch(searchWorker, AssetType::Texture, filterStrTokens, filterStrTokenCount);
 							}
+							if (bThumbnailGrid)
+								DrawAssetGrid(thumbnailCache);
+							else
+								DrawAssetList();
 							ImGui::EndTabItem();
 
 						}
@@ -767,7 +1143,7 @@ int main(int argc, char const* argv[])
 
 							if (bFilterStrDirty || !bFilteredForAudio)
 							{
-								filteredFiles = db::GetAudioFilesByNameFilters(filterStrTokens, filterStrTokenCount);
+								RunSearch(searchWorker, AssetType::Audio, filterStrTokens, filterStrTokenCount);
 
 								// todo: cleanier way to manage these states?
 								{
@@ -776,16 +1152,17 @@ int main(int argc, char const* argv[])
 								}
 							}
 
-							for (int i = 0; i < filteredFiles.size(); i++)
+							if (bFindSimilarSounds)
 							{
-								const auto& file = filteredFiles[i];
-								const auto& filenameCstr = file.name.c_str();
-								/*if (fts::fuzzy_match_simple(filterStr, filenameCstr))
-								{*/
-								if (ImGui::Selectable(filenameCstr, selectedAssetIndex == i))
-									selectedAssetIndex = i;
-								//}
+								ImGui::TextWrapped("Sounds like %s", similarSoundName.c_str());
+								if (ImGui::Button("Clear"))
+								{
+									bFindSimilarSounds = false;
+									bFilteredForAudio = false;
+								}
 							}
+
+							DrawAssetList();
 							ImGui::EndTabItem();
 
 
@@ -807,12 +1184,16 @@ int main(int argc, char const* argv[])
 						if (!filteredFiles.empty() &&
 							selectedAssetIndex >= 0 && selectedAssetIndex < filteredFiles.size())
 						{
-							const auto& file = filteredFiles[selectedAssetIndex];
+							const db::File file = filteredIndex->GetFile(filteredFiles[selectedAssetIndex]);
 
 							// header
 							{
 								ImGui::Text("Name: %s", file.name.c_str());
-								ImGui::Text("Format: %s", file.ext.c_str());
+								ImGui::Text("Format: %s (%s)", file.ext.c_str(), file.codec.empty() ? "?" : file.codec.c_str());
+								if (file.width > 0)
+								{
+									ImGui::Text("Dimensions: %dx%d, %d channels", file.width, file.height, file.components);
+								}
 								ImGui::Text("Size: %d kb", file.size);
 								ImGui::Text("Path: %s", file.path.c_str());
 
@@ -825,50 +1206,63 @@ int main(int argc, char const* argv[])
 								{
 									SDL_OpenURL(file.directory.c_str());
 								}
-							}
 
-							// todo: maybe hash the path
-							if (texturePreviewMap.find(file.path) == texturePreviewMap.end())
-							{
-								TexturePreview preview{};
-								bool ret = LoadTextureFromFile(
-									file.path,
-									&preview.textureId,
-									&preview.width, &preview.height);
-								IM_ASSERT(ret);
-
-								// todo: resource manager
-								texturePreviewMap[file.path] = preview;
+								// only once the image was hashed
+								uint64_t hash = 0;
+								if (filteredIndex->GetPerceptualHash(filteredFiles[selectedAssetIndex], hash) && ImGui::Button("Find Similar"))
+								{
+									bFindSimilar = true;
+									similarHash = hash;
+									similarName = file.name;
+									bFilteredForTexture = false;
+									SelectAsset(-1);
+								}
+
+								bTagsDirty |= DrawFileTags(tagIndex, file.id);
 							}
 
+							const TexturePreview& preview = textureLoader.Request(file.path);
+
 							ImGui::Separator();
 							if (ImGui::BeginTabBar("##Tabs", ImGuiTabBarFlags_None))
 							{
 								if (ImGui::BeginTabItem("Description"))
 								{
-									const auto& preview = texturePreviewMap[file.path];
-									const float aspectRatio = (float)preview.width / (float)preview.height;
-									if (preview.width > preview.height)
+									if (preview.state == TextureState::Loading)
 									{
-										//w / h = 300 / x;
-										float width = 300;
-										float height = 300 / aspectRatio;
-
-										ImGui::Image((void*)(intptr_t)preview.textureId,
-											//ImVec2(preview.width, preview.height)
-											ImVec2(width, height)
-										);
+										// placeholder keeps the layout from jumping when the image arrives
+										ImGui::TextDisabled("Loading...");
+										ImGui::Dummy(ImVec2(300, 300 - ImGui::GetTextLineHeightWithSpacing()));
+									}
+									else if (preview.state == TextureState::Failed)
+									{
+										ImGui::TextDisabled("Failed to load image");
 									}
 									else
 									{
-										//w / h = x / 300;
-										float width = 300 * aspectRatio;
-										float height = 300;
-
-										ImGui::Image((void*)(intptr_t)preview.textureId,
-											//ImVec2(preview.width, preview.height)
-											ImVec2(width, height)
-										);
+										const float aspectRatio = (float)preview.width / (float)preview.height;
+										if (preview.width > preview.height)
+										{
+											//w / h = 300 / x;
+											float width = 300;
+											float height = 300 / aspectRatio;
+
+											ImGui::Image((void*)(intptr_t)preview.textureId,
+												//ImVec2(preview.width, preview.height)
+												ImVec2(width, height)
+											);
+										}
+										else
+										{
+											//w / h = x / 300;
+											float width = 300 * aspectRatio;
+											float height = 300;
+
+											ImGui::Image((void*)(intptr_t)preview.textureId,
+												//ImVec2(preview.width, preview.height)
+												ImVec2(width, height)
+											);
+										}
 									}
 
 									ImGui::EndTabItem();
@@ -888,11 +1282,11 @@ int main(int argc, char const* argv[])
 						if (!filteredFiles.empty() &&
 							selectedAssetIndex >= 0 && selectedAssetIndex < filteredFiles.size())
 						{
-							const auto& file = filteredFiles[selectedAssetIndex];
+							const db::File file = filteredIndex->GetFile(filteredFiles[selectedAssetIndex]);
 							// header
 							{
 								ImGui::Text("Name: %s", file.name.c_str());
-								ImGui::Text("Format: %s", file.ext.c_str());
+								ImGui::Text("Format: %s (%s)", file.ext.c_str(), file.codec.empty() ? "?" : file.codec.c_str());
 								ImGui::Text("Size: %d kb", file.size);
 								ImGui::Text("Path: %s", file.path.c_str());
 
@@ -905,33 +1299,91 @@ int main(int argc, char const* argv[])
 								{
 									SDL_OpenURL(file.directory.c_str());
 								}
-							}
 
-							if (audioPreviewMap.find(file.path) == audioPreviewMap.end())
-							{
-								audioPreviewMap[file.path] = new AudioPreview(file.path);
+								// only once the sound was analyzed
+								std::vector<float> fingerprint;
+								if (filteredIndex->GetAudioFingerprint(filteredFiles[selectedAssetIndex], fingerprint) && ImGui::Button("Sounds Like This"))
+								{
+									bFindSimilarSounds = true;
+									similarFingerprint = std::move(fingerprint);
+									similarSoundName = file.name;
+									bFilteredForAudio = false;
+									SelectAsset(-1);
+								}
+
+								bTagsDirty |= DrawFileTags(tagIndex, file.id);
 							}
 
-							auto& const audioPreview = audioPreviewMap[file.path];
+							// a playing sound follows the selection
+							audioEngine.Select(file.path);
 
-							ImGui::Text("Sample Rate: %d Hz", audioPreview->decoder.outputSampleRate);
-							ImGui::Text("Channel Count: %d", audioPreview->decoder.outputChannels);
+							const AudioTrackInfo& track = audioEngine.GetTrackInfo();
+
+							// the stored summary is there before the decoder even opened
+							const db::Waveform* waveform = audioAnalyzer.Request(file.id, file.mtime, file.path);
+							if (waveform && waveform->levels > 0)
+							{
+								ImGui::Text("Sample Rate: %u Hz", waveform->sampleRate);
+								ImGui::Text("Channel Count: %u", waveform->channels);
+								ImGui::Text("Duration: %.2f s", waveform->sampleRate ? (double)waveform->lengthFrames / waveform->sampleRate : 0.0);
+								ImGui::Text("Loudness: %.1f dBFS rms, %.1f dBFS peak", waveform->rmsDb, waveform->peakDb);
+							}
+							else if (file.sampleRate > 0)
+							{
+								// from the header, read at scan time
+								ImGui::Text("Sample Rate: %d Hz", file.sampleRate);
+								ImGui::Text("Channel Count: %d", file.channels);
+								ImGui::Text("Duration: %.2f s", file.durationMs / 1000.0);
+							}
+							else if (track.bValid)
+							{
+								const uint32_t deviceSampleRate = audioEngine.GetDeviceSampleRate();
+								ImGui::Text("Sample Rate: %u Hz", track.sampleRate);
+								ImGui::Text("Channel Count: %u", track.channels);
+								ImGui::Text("Duration: %.2f s", deviceSampleRate ? (double)track.lengthFrames / deviceSampleRate : 0.0);
+							}
+							else
+							{
+								ImGui::TextDisabled("Loading...");
+							}
 							ImGui::Separator();
 
+							const float playbackFraction = track.bValid && track.lengthFrames > 0 ?
+								(float)((double)audioEngine.GetCursorFrames() / track.lengthFrames) : 0.0f;
+							if (waveform && waveform->levels > 0)
+							{
+								DrawWaveform(*waveform, playbackFraction);
+							}
+
 
 							const auto& buttonSize = ImVec2(30, 30);
 							if (ImGui::Button(ICON_FA_PLAY, buttonSize)) {
-								audioPreview->Play();
+								audioEngine.Play();
 							}
 							ImGui::SameLine();
 
 							if (ImGui::Button(ICON_FA_PAUSE, buttonSize)) {
-								audioPreview->Pause();
+								audioEngine.Pause();
 							}
 
 							ImGui::SameLine();
 							if (ImGui::Button(ICON_FA_STOP, buttonSize)) {
-								audioPreview->Stop();
+								audioEngine.Stop();
+							}
+
+							if (track.bValid && track.lengthFrames > 0)
+							{
+								ImGui::ProgressBar(playbackFraction, ImVec2(-1, 0), "");
+							}
+
+							ImGui::Checkbox("Scope", &bOscilloscope);
+							if (bOscilloscope)
+							{
+								DrawOscilloscope(spectrumAnalyzer);
+							}
+							else
+							{
+								DrawSpectrum(spectrumAnalyzer);
 							}
 						}
 						ImGui::EndChild();
@@ -942,6 +1394,10 @@ int main(int argc, char const* argv[])
 			}
 			ImGui::End();
 
+			frameStats.Draw(textureLoader, searchWorker);
+			DrawDuplicates(duplicateFinder);
+			if (!bShowDuplicates) duplicateFinder.Stop();
+
 			// imgui end
 			{
 				ImGui::Render();
@@ -950,6 +1406,14 @@ int main(int argc, char const* argv[])
 
 			SDL_GL_SwapWindow(window);
 
+			{
+				const Uint64 frameCounter = SDL_GetPerformanceCounter();
+				frameStats.Push(
+					(float)((frameCounter - lastFrameCounter) * counterToMs),
+					(float)(frameSearchCounter * counterToMs));
+				lastFrameCounter = frameCounter;
+			}
+
 			// clear
 			{
 				glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
@@ -958,6 +1422,16 @@ int main(int argc, char const* argv[])
 			}
 		}
 
+		watcher.Stop();
+		scanner.Stop();
+		audioAnalyzer.Stop();
+		imageHasher.Stop();
+		duplicateFinder.Stop();
+		searchWorker.Stop();
+		if (pendingSearchIndex.valid()) pendingSearchIndex.wait();
+		textureLoader.Clear();
+		thumbnailCache.Clear();
+
 		// imgui clean up
 		ImGui_ImplOpenGL3_Shutdown();
 		ImGui_ImplSDL2_Shutdown();
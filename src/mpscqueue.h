@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+
+// lock free multi producer / single consumer queue.
+// producers push onto an intrusive stack with a single compare exchange, the consumer
+// takes the whole stack at once and reverses it, so items come out in push order.
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue() = default;
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		Node* node = head.exchange(nullptr, std::memory_order_acquire);
+		while (node)
+		{
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+	// safe from any thread
+	void Push(T item)
+	{
+		Node* node = new Node{ std::move(item), head.load(std::memory_order_relaxed) };
+		while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// consumer thread only, appends everything pushed so far to outItems
+	template <typename Container>
+	size_t PopAll(Container& outItems)
+	{
+		Node* node = head.exchange(nullptr, std::memory_order_acquire);
+
+		// the stack is newest first
+		Node* reversed = nullptr;
+		while (node)
+		{
+			Node* next = node->next;
+			node->next = reversed;
+			reversed = node;
+			node = next;
+		}
+
+		size_t count = 0;
+		while (reversed)
+		{
+			Node* next = reversed->next;
+			outItems.push_back(std::move(reversed->item));
+			delete reversed;
+			reversed = next;
+			count++;
+		}
+		return count;
+	}
+
+	bool IsEmpty() const { return head.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+	struct Node
+	{
+		T item;
+		Node* next;
+	};
+
+	std::atomic<Node*> head{ nullptr };
+};
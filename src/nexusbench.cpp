@@ -0,0 +1,412 @@
+// nexus-bench: reproduces the throughput numbers quoted for the hot paths, on the machine it runs on.
+//
+//   nexus-bench analyze [--threads N] [dir]   reduction kernel, a 10 min summary, then every sound below dir
+//   nexus-bench write [rows]                  BulkWriter ingest into a scratch db, then the same rows again
+//   nexus-bench fuzzy [rows]                  ranked fuzzy search over synthetic asset names
+//   nexus-bench hash [--threads N] [dir]      xxh64 in memory, then every asset below dir, twice
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audiofingerprint.h"
+#include "contenthash.h"
+#include "db.h"
+#include "jobsystem.h"
+#include "scanner.h"
+#include "searchindex.h"
+#include "waveform.h"
+
+// best of this many runs for the in memory measurements
+static const int BENCH_REPEATS = 5;
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point from)
+{
+	return std::chrono::duration<double>(Clock::now() - from).count();
+}
+
+// every supported file below path, of the given db type (null for any)
+static void CollectFiles(const std::string& path, const char* type, std::vector<std::string>& outPaths)
+{
+	cf_dir_t dir;
+	if (!cf_dir_open(&dir, path.c_str()))
+	{
+		return;
+	}
+
+	while (dir.has_next)
+	{
+		cf_file_t rawfile;
+		cf_read_file(&dir, &rawfile);
+
+		if (rawfile.is_dir && rawfile.name[0] != '.')
+		{
+			CollectFiles(path + "/" + rawfile.name, type, outPaths);
+		}
+		else if (rawfile.is_reg)
+		{
+			const char* fileType = AssetScanner::GetFileType(rawfile.ext);
+			if (fileType && (!type || strcmp(fileType, type) == 0))
+			{
+				outPaths.push_back(rawfile.path);
+			}
+		}
+
+		cf_dir_next(&dir);
+	}
+	cf_dir_close(&dir);
+}
+
+static void BenchAnalyze(const char* directory, unsigned threadCount)
+{
+	// 10 minutes of stereo at 44.1 kHz, a tone with some movement so nothing folds away
+	const uint32_t sampleRate = 44100;
+	const size_t frameCount = (size_t)sampleRate * 600;
+	std::vector<float> samples(frameCount * 2);
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		const float t = (float)i / sampleRate;
+		samples[i * 2 + 0] = 0.5f * sinf(t * 2.0f * 3.14159265f * 440.0f) * (0.5f + 0.5f * sinf(t));
+		samples[i * 2 + 1] = 0.3f * sinf(t * 2.0f * 3.14159265f * 660.0f);
+	}
+
+	// the same decode sized chunk over and over, it is still in cache when the analyzer reduces it
+	const size_t CHUNK_FRAMES = 4096;
+	const auto measureKernel = [&](void (*reduce)(const float*, size_t, float&, float&, double&))
+	{
+		double best = 1e9;
+		for (int run = 0; run < BENCH_REPEATS; run++)
+		{
+			float minValue = 0.0f, maxValue = 0.0f;
+			double sumSquares = 0.0;
+			const auto start = Clock::now();
+			for (size_t frame = 0; frame + CHUNK_FRAMES <= frameCount; frame += CHUNK_FRAMES)
+			{
+				reduce(samples.data(), CHUNK_FRAMES * 2, minValue, maxValue, sumSquares);
+			}
+			best = std::min(best, SecondsSince(start));
+		}
+		return (frameCount / CHUNK_FRAMES) * CHUNK_FRAMES * 2 / best / 1e9;
+	};
+	printf("[bench]: reduction kernel: scalar %.2f Gsamples/s, %s %.2f Gsamples/s\n",
+		measureKernel(ReduceSamplesScalar), GetReduceKernelName(), measureKernel(ReduceSamples));
+
+	// what AnalyzeAudioFile does per decoded chunk, minus the decode
+	double bestWaveform = 1e9, bestFingerprint = 1e9;
+	for (int run = 0; run < BENCH_REPEATS; run++)
+	{
+		auto start = Clock::now();
+		WaveformBuilder waveformBuilder(2);
+		for (size_t frame = 0; frame < frameCount; frame += CHUNK_FRAMES)
+		{
+			waveformBuilder.Add(&samples[frame * 2], std::min(CHUNK_FRAMES, frameCount - frame));
+		}
+		db::Waveform waveform;
+		waveformBuilder.Finish(sampleRate, waveform);
+		bestWaveform = std::min(bestWaveform, SecondsSince(start));
+
+		start = Clock::now();
+		FingerprintBuilder fingerprintBuilder(2, sampleRate);
+		for (size_t frame = 0; frame < frameCount; frame += CHUNK_FRAMES)
+		{
+			fingerprintBuilder.Add(&samples[frame * 2], std::min(CHUNK_FRAMES, frameCount - frame));
+		}
+		std::vector<float> fingerprint;
+		fingerprintBuilder.Finish(fingerprint);
+		bestFingerprint = std::min(bestFingerprint, SecondsSince(start));
+	}
+	printf("[bench]: 10 min stereo 44.1 kHz after decoding: waveform %.1f ms, fingerprint %.1f ms\n",
+		bestWaveform * 1000.0, bestFingerprint * 1000.0);
+
+	if (!directory)
+	{
+		return;
+	}
+
+	// the batch as AudioAnalyzer runs it, decode included, without writing to the db
+	std::vector<std::string> paths;
+	CollectFiles(directory, db::AUDIO_FILE_TYPE, paths);
+	if (paths.empty())
+	{
+		printf("[bench]: no sounds below [%s]\n", directory);
+		return;
+	}
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+	JobSystem jobs(threadCount);
+
+	std::atomic<uint64_t> audioMilliseconds{ 0 };
+	std::atomic<int> failed{ 0 };
+	const auto start = Clock::now();
+	jobs.ParallelFor(paths.size(), [&](size_t i)
+		{
+			db::Waveform waveform;
+			std::vector<float> fingerprint;
+			if (!AnalyzeAudioFile(paths[i], nullptr, waveform, &fingerprint) || waveform.sampleRate == 0)
+			{
+				failed++;
+				return;
+			}
+			audioMilliseconds += waveform.lengthFrames * 1000 / waveform.sampleRate;
+		});
+	const double seconds = SecondsSince(start);
+
+	const double minutes = audioMilliseconds / 60000.0;
+	printf("[bench]: analyzed %d sounds (%.1f min of audio, %d failed) on %u threads in %.2f s, %.0fx realtime\n",
+		(int)paths.size(), minutes, failed.load(), threadCount, seconds, seconds > 0.0 ? minutes * 60.0 / seconds : 0.0);
+}
+
+static void BenchWrite(const char* rowsArgument)
+{
+	const size_t rowCount = rowsArgument ? (size_t)strtoull(rowsArgument, nullptr, 10) : 1000000;
+	if (rowCount == 0)
+	{
+		return;
+	}
+
+	// db.sqlite is relative to the working directory, move away from any real one first
+	std::error_code error;
+	const std::filesystem::path scratch = std::filesystem::temp_directory_path(error) / "nexus-bench";
+	std::filesystem::remove_all(scratch, error);
+	std::filesystem::create_directories(scratch, error);
+	std::filesystem::current_path(scratch, error);
+	if (error)
+	{
+		printf("[bench]: can't use scratch directory [%s]: %s\n", scratch.string().c_str(), error.message().c_str());
+		return;
+	}
+
+	db::Init();
+
+	// what a scan of a large library hands to the writer, a thousand files per directory
+	db::ScanChanges changes;
+	changes.upserts.reserve(rowCount);
+	char name[64];
+	for (size_t i = 0; i < rowCount; i++)
+	{
+		const bool bAudio = (i % 2) == 0;
+		snprintf(name, sizeof(name), bAudio ? "sfx_%07d.wav" : "tex_%07d.png", (int)i);
+
+		db::File file;
+		file.name = name;
+		file.ext = bAudio ? ".wav" : ".png";
+		file.type = bAudio ? db::AUDIO_FILE_TYPE : db::TEXTURE_FILE_TYPE;
+		file.directory = "/library/pack_" + std::to_string(i / 1000);
+		file.path = file.directory + "/" + file.name;
+		file.size = 4096 + (i * 7919) % 1000000;
+		file.mtime = 1700000000 + (int64_t)i;
+		file.codec = bAudio ? "pcm" : "png";
+		file.durationMs = bAudio ? 500 + (int64_t)(i % 5000) : 0;
+		file.sampleRate = bAudio ? 48000 : 0;
+		file.channels = bAudio ? 2 : 0;
+		file.width = bAudio ? 0 : 256;
+		file.height = bAudio ? 0 : 256;
+		file.components = bAudio ? 0 : 4;
+		changes.upserts.push_back(std::move(file));
+	}
+
+	db::BulkWriter writer;
+	if (!writer.IsValid())
+	{
+		return;
+	}
+
+	// first pass inserts every path, the second hits the conflict on each one and updates in place
+	const char* passNames[] = { "insert", "re-upsert" };
+	for (const char* passName : passNames)
+	{
+		const auto start = Clock::now();
+		writer.ApplyScanChanges(changes);
+		const double seconds = SecondsSince(start);
+		printf("[bench]: %s %d rows in %.2f s, %.0f rows/s\n", passName, (int)rowCount, seconds, seconds > 0.0 ? rowCount / seconds : 0.0);
+
+		for (db::File& file : changes.upserts)
+		{
+			file.mtime++;
+		}
+	}
+}
+
+static void BenchFuzzy(const char* rowsArgument)
+{
+	const size_t rowCount = rowsArgument ? (size_t)strtoull(rowsArgument, nullptr, 10) : 1000000;
+
+	// one to four words glued together plus a variant number, the way packs tend to name their assets
+	static const char* WORDS[] = { "Action", "Loot", "Armor", "Icon", "Sword", "Shield", "Potion", "Gem",
+		"Ring", "Helmet", "Boots", "Foot", "Step", "Swoosh", "Hit", "Ui", "Click", "Fire" };
+	const size_t wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+
+	SearchIndex index;
+	uint32_t seed = 1;
+	const auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+	std::string name, path;
+	for (size_t i = 0; i < rowCount; i++)
+	{
+		const bool bAudio = (i % 3) == 0;
+		name.clear();
+		for (uint32_t word = 0, words = 1 + next() % 4; word < words; word++)
+		{
+			name += WORDS[next() % wordCount];
+		}
+		name += "_" + std::to_string(next() % 100000) + (bAudio ? ".wav" : ".png");
+		path = "/library/pack_" + std::to_string(i / 1000) + "/" + name;
+
+		db::FileView file = {};
+		file.id = (int)i;
+		file.name = name.c_str();
+		file.path = path.c_str();
+		file.type = bAudio ? db::AUDIO_FILE_TYPE : db::TEXTURE_FILE_TYPE;
+		file.codec = "";
+		index.Add(file);
+	}
+
+	// an abbreviation, a scattered one, a short pattern that matches almost everything and one without hits
+	static const char* PATTERNS[] = { "ActnLoot", "hlmtbts12", "swd", "zzz" };
+	const size_t MAX_RESULTS = 500;
+	printf("[bench]: fuzzy search over %d names on %u threads\n", (int)rowCount, JobSystem::GetShared().GetThreadCount());
+	for (const char* pattern : PATTERNS)
+	{
+		double best = 1e9;
+		std::vector<uint32_t> rows;
+		for (int run = 0; run < BENCH_REPEATS; run++)
+		{
+			rows.clear();
+			const auto start = Clock::now();
+			index.FuzzySearch(AssetType::Texture, pattern, MAX_RESULTS, nullptr, nullptr, rows);
+			best = std::min(best, SecondsSince(start));
+		}
+		printf("[bench]:   [%s] %.1f ms, %d kept, best [%s]\n", pattern, best * 1000.0, (int)rows.size(),
+			rows.empty() ? "" : index.GetName(rows[0]));
+	}
+}
+
+static void BenchHash(const char* directory, unsigned threadCount)
+{
+	// well past the last level cache, so this is hashing and not just a cache benchmark
+	std::vector<unsigned char> buffer((size_t)256 << 20);
+	uint32_t seed = 1;
+	for (unsigned char& byte : buffer)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		byte = (unsigned char)(seed >> 24);
+	}
+
+	double best = 1e9;
+	uint64_t digest = 0;
+	for (int run = 0; run < BENCH_REPEATS; run++)
+	{
+		const auto start = Clock::now();
+		digest ^= Xxh64::Hash(buffer.data(), buffer.size());
+		best = std::min(best, SecondsSince(start));
+	}
+	printf("[bench]: xxh64 in memory: %.2f GB/s (%016llx)\n", buffer.size() / best / 1e9, (unsigned long long)digest);
+
+	if (!directory)
+	{
+		return;
+	}
+
+	// whole files with HashFile, as DuplicateFinder reads the candidates that survived the prefix pass
+	std::vector<std::string> paths;
+	CollectFiles(directory, nullptr, paths);
+	if (paths.empty())
+	{
+		printf("[bench]: no assets below [%s]\n", directory);
+		return;
+	}
+
+	if (threadCount == 0) threadCount = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+	JobSystem jobs(threadCount);
+
+	// the first pass may come from disk, the second one is served by the page cache
+	const char* passNames[] = { "first pass", "second pass" };
+	for (const char* passName : passNames)
+	{
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<int> failed{ 0 };
+		const auto start = Clock::now();
+		jobs.ParallelFor(paths.size(), [&](size_t i)
+			{
+				int64_t mtime = 0;
+				size_t size = 0;
+				uint64_t hash = 0;
+				if (!AssetScanner::GetFileStats(paths[i].c_str(), mtime, size) || !HashFile(paths[i].c_str(), 0, nullptr, hash))
+				{
+					failed++;
+					return;
+				}
+				bytes += size;
+			});
+		const double seconds = SecondsSince(start);
+
+		printf("[bench]: %s: %d files (%d failed), %.1f mb on %u threads in %.2f s, %.2f GB/s\n", passName,
+			(int)paths.size(), failed.load(), bytes / (1024.0 * 1024.0), threadCount, seconds, seconds > 0.0 ? bytes / seconds / 1e9 : 0.0);
+	}
+}
+
+static void PrintUsage()
+{
+	printf("usage: nexus-bench <mode> [--threads N] [args]\n"
+		"  analyze [dir]  reduction kernel, a 10 min summary, then every sound below dir\n"
+		"  write [rows]   BulkWriter ingest of rows files (default 1M) into a scratch db, then the same rows again\n"
+		"  fuzzy [rows]   ranked fuzzy search over rows synthetic names (default 1M) on the shared job system\n"
+		"  hash [dir]     xxh64 over a 256 mb buffer, then every asset below dir twice, the second from the page cache\n");
+}
+
+int main(int argc, char const* argv[])
+{
+	std::vector<const char*> args;
+	unsigned threadCount = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCount = (unsigned)strtoul(argv[++i], nullptr, 10);
+		}
+		else
+		{
+			args.push_back(argv[i]);
+		}
+	}
+
+	if (args.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char* mode = args[0];
+	const char* argument = args.size() > 1 ? args[1] : nullptr;
+	if (strcmp(mode, "analyze") == 0)
+	{
+		BenchAnalyze(argument, threadCount);
+	}
+	else if (strcmp(mode, "write") == 0)
+	{
+		BenchWrite(argument);
+	}
+	else if (strcmp(mode, "fuzzy") == 0)
+	{
+		BenchFuzzy(argument);
+	}
+	else if (strcmp(mode, "hash") == 0)
+	{
+		BenchHash(argument, threadCount);
+	}
+	else
+	{
+		PrintUsage();
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+// nexus-index: builds db.sqlite without a window, e.g. nightly on a build server.
+// the browser started next to the resulting db only rescans what changed since.
+//
+//   nexus-index [--threads N] [--analyze] <root>...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audioanalyzer.h"
+#include "db.h"
+#include "scanner.h"
+
+// how often progress is printed
+static const int PROGRESS_INTERVAL_MS = 2000;
+
+static void PrintUsage()
+{
+	printf("usage: nexus-index [--threads N] [--analyze] <root>...\n"
+		"  writes %s in the working directory, incrementally if it already exists\n"
+		"  --threads N  scan (and analysis) threads, default: all cores (half for analysis)\n"
+		"  --analyze    also decode every sound for its waveform and fingerprint\n", db::GetPath());
+}
+
+int main(int argc, char const* argv[])
+{
+	std::vector<std::string> roots;
+	unsigned threadCount = 0;
+	bool bAnalyze = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCount = (unsigned)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--analyze") == 0)
+		{
+			bAnalyze = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+		}
+		else
+		{
+			roots.push_back(argv[i]);
+		}
+	}
+
+	if (roots.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto secondsSince = [](std::chrono::steady_clock::time_point from)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+	};
+
+	db::Init();
+
+	// scan, same as the browser does on startup
+	{
+		AssetScanner scanner;
+		scanner.Start(roots, threadCount);
+
+		const ScanProgress& progress = scanner.GetProgress();
+		while (!progress.bDone)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+
+			const double seconds = secondsSince(start);
+			printf("[index]: %d/%d directories, %d files found (%.0f/s), %d written, %d headers read\n",
+				progress.directoriesScanned.load(), progress.directoriesQueued.load(),
+				progress.filesFound.load(), seconds > 0.0 ? progress.filesFound.load() / seconds : 0.0,
+				progress.filesWritten.load(), progress.filesProbed.load());
+		}
+		scanner.Stop();
+
+		const double seconds = secondsSince(start);
+		printf("[index]: scanned %d files in %d directories in %.2f s (%.0f files/s, %.0f directories/s)\n",
+			progress.filesFound.load(), progress.directoriesScanned.load(), seconds,
+			seconds > 0.0 ? progress.filesFound.load() / seconds : 0.0,
+			seconds > 0.0 ? progress.directoriesScanned.load() / seconds : 0.0);
+	}
+
+	if (bAnalyze)
+	{
+		const auto analyzeStart = std::chrono::steady_clock::now();
+
+		AudioAnalyzer analyzer;
+		analyzer.Start(threadCount);
+
+		const AnalysisProgress& progress = analyzer.GetProgress();
+		while (!progress.bDone)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+			printf("[index]: analyzed %d/%d sounds\n", progress.filesAnalyzed.load(), progress.filesQueued.load());
+		}
+		analyzer.Stop();
+
+		const double seconds = secondsSince(analyzeStart);
+		printf("[index]: analyzed %d sounds in %.2f s (%.1f/s), %d failed\n",
+			progress.filesAnalyzed.load(), seconds, seconds > 0.0 ? progress.filesAnalyzed.load() / seconds : 0.0,
+			progress.filesFailed.load());
+	}
+
+	db::Checkpoint();
+
+	int64_t mtime = 0;
+	size_t size = 0;
+	AssetScanner::GetFileStats(db::GetPath(), mtime, size);
+	printf("[index]: wrote %s (%.1f mb) in %.2f s\n", db::GetPath(), size / (1024.0 * 1024.0), secondsSince(start));
+	return 0;
+}
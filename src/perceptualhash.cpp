@@ -0,0 +1,35 @@
+#include "perceptualhash.h"
+
+#include <vector>
+
+#include "previewbuilder.h"
+
+static const int HASH_COLUMNS = 9;  // 8 differences per row
+static const int HASH_ROWS = 8;
+
+uint64_t ComputePerceptualHash(const unsigned char* pixels, int width, int height)
+{
+	std::vector<unsigned char> cells;
+	DownscaleImage(pixels, width, height, HASH_COLUMNS, HASH_ROWS, cells);
+
+	// rec. 601 luma, scaled by 256. icons are mostly alpha, blending keeps their silhouette
+	int luminance[HASH_COLUMNS * HASH_ROWS];
+	for (int i = 0; i < HASH_COLUMNS * HASH_ROWS; i++)
+	{
+		const unsigned char* cell = &cells[i * 4];
+		const int luma = cell[0] * 77 + cell[1] * 150 + cell[2] * 29;
+		luminance[i] = (luma * cell[3] + 128 * 256 * (255 - cell[3])) / 255;
+	}
+
+	uint64_t hash = 0;
+	for (int y = 0; y < HASH_ROWS; y++)
+	{
+		for (int x = 0; x < HASH_COLUMNS - 1; x++)
+		{
+			const int left = luminance[y * HASH_COLUMNS + x];
+			const int right = luminance[y * HASH_COLUMNS + x + 1];
+			hash = (hash << 1) | (left < right ? 1 : 0);
+		}
+	}
+	return hash;
+}
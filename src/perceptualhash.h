@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 64 bit difference hash (dhash) of rgba pixels: the image is box filtered to 9x8 luminance,
+// transparency blended over mid gray, and every bit says whether a cell is darker than its right
+// neighbour. survives rescaling, recompression and most recolouring since only the direction of
+// the gradients counts. a flat image hashes to 0
+uint64_t ComputePerceptualHash(const unsigned char* pixels, int width, int height);
+
+// number of differing bits, 0 for identical looking images. up to ~10 is usually a variant
+static inline int GetHashDistance(uint64_t a, uint64_t b)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt64(a ^ b);
+#else
+	return __builtin_popcountll(a ^ b);
+#endif
+}
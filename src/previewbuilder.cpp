@@ -0,0 +1,375 @@
+#include "previewbuilder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void FitImageSize(int width, int height, int maxSize, int& outWidth, int& outHeight)
+{
+	const float scale = std::min(1.0f, (float)maxSize / (float)std::max(width, height));
+	outWidth = std::max(1, (int)(width * scale + 0.5f));
+	outHeight = std::max(1, (int)(height * scale + 0.5f));
+}
+
+void DownscaleImage(const unsigned char* pixels, int width, int height,
+	int targetWidth, int targetHeight, std::vector<unsigned char>& outPixels)
+{
+	outPixels.resize((size_t)targetWidth * targetHeight * 4);
+
+	for (int y = 0; y < targetHeight; y++)
+	{
+		const int sourceY0 = (int)((int64_t)y * height / targetHeight);
+		const int sourceY1 = std::max(sourceY0 + 1, (int)((int64_t)(y + 1) * height / targetHeight));
+
+		for (int x = 0; x < targetWidth; x++)
+		{
+			const int sourceX0 = (int)((int64_t)x * width / targetWidth);
+			const int sourceX1 = std::max(sourceX0 + 1, (int)((int64_t)(x + 1) * width / targetWidth));
+
+			uint64_t r = 0, g = 0, b = 0, a = 0;
+			for (int sourceY = sourceY0; sourceY < sourceY1; sourceY++)
+			{
+				const unsigned char* source = pixels + ((size_t)sourceY * width + sourceX0) * 4;
+				for (int sourceX = sourceX0; sourceX < sourceX1; sourceX++, source += 4)
+				{
+					r += source[0] * source[3];
+					g += source[1] * source[3];
+					b += source[2] * source[3];
+					a += source[3];
+				}
+			}
+
+			const uint64_t count = (uint64_t)(sourceX1 - sourceX0) * (sourceY1 - sourceY0);
+			unsigned char* target = &outPixels[((size_t)y * targetWidth + x) * 4];
+			target[0] = a ? (unsigned char)(r / a) : 0;
+			target[1] = a ? (unsigned char)(g / a) : 0;
+			target[2] = a ? (unsigned char)(b / a) : 0;
+			target[3] = (unsigned char)(a / count);
+		}
+	}
+}
+
+size_t GetPreviewLevelSize(PreviewFormat format, int width, int height)
+{
+	const size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case PreviewFormat::BC1: return blocks * 8;
+	case PreviewFormat::BC3: return blocks * 16;
+	default: return (size_t)width * height * 4;
+	}
+}
+
+static void AppendLevel(const std::vector<unsigned char>& pixels, int width, int height, PreviewFormat format, std::vector<unsigned char>& data)
+{
+	const size_t offset = data.size();
+	data.resize(offset + GetPreviewLevelSize(format, width, height));
+
+	switch (format)
+	{
+	case PreviewFormat::BC1: CompressBC1(pixels.data(), width, height, &data[offset]); break;
+	case PreviewFormat::BC3: CompressBC3(pixels.data(), width, height, &data[offset]); break;
+	default: memcpy(&data[offset], pixels.data(), pixels.size()); break;
+	}
+}
+
+void BuildPreview(const unsigned char* pixels, int width, int height, int maxSize, bool bCompress, db::Preview& outPreview)
+{
+	int levelWidth, levelHeight;
+	FitImageSize(width, height, maxSize, levelWidth, levelHeight);
+
+	std::vector<unsigned char> level;
+	DownscaleImage(pixels, width, height, levelWidth, levelHeight, level);
+
+	PreviewFormat format = PreviewFormat::RGBA8;
+	if (bCompress)
+	{
+		bool bOpaque = true;
+		for (size_t i = 3; i < level.size() && bOpaque; i += 4)
+		{
+			bOpaque = level[i] == 255;
+		}
+		format = bOpaque ? PreviewFormat::BC1 : PreviewFormat::BC3;
+	}
+
+	outPreview.format = (int)format;
+	outPreview.width = levelWidth;
+	outPreview.height = levelHeight;
+	outPreview.levels = 0;
+	outPreview.data.clear();
+
+	// every level is filtered from the one above it
+	std::vector<unsigned char> nextLevel;
+	while (true)
+	{
+		AppendLevel(level, levelWidth, levelHeight, format, outPreview.data);
+		outPreview.levels++;
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+
+		const int nextWidth = std::max(1, levelWidth / 2);
+		const int nextHeight = std::max(1, levelHeight / 2);
+		DownscaleImage(level.data(), levelWidth, levelHeight, nextWidth, nextHeight, nextLevel);
+		level.swap(nextLevel);
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+}
+
+// 4x4 block at (blockX, blockY), pixels past the edge repeat the last row/column
+static void FetchBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char outBlock[64])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		const int sourceY = std::min(blockY * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			const int sourceX = std::min(blockX * 4 + x, width - 1);
+			memcpy(&outBlock[(y * 4 + x) * 4], &pixels[((size_t)sourceY * width + sourceX) * 4], 4);
+		}
+	}
+}
+
+static uint16_t PackColor565(const float color[3])
+{
+	const int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+	const int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+	const int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColor565(uint16_t packed, int outColor[3])
+{
+	const int r = (packed >> 11) & 31;
+	const int g = (packed >> 5) & 63;
+	const int b = packed & 31;
+	outColor[0] = (r << 3) | (r >> 2);
+	outColor[1] = (g << 2) | (g >> 4);
+	outColor[2] = (b << 3) | (b >> 2);
+}
+
+// endpoints along the block's principal axis, always in four color mode
+static void EncodeColorBlock(const unsigned char block[64], unsigned char out[8])
+{
+	float mean[3] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++) mean[c] += block[i * 4 + c];
+	}
+	for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+	float covariance[6] = {};  // rr rg rb gg gb bb
+	for (int i = 0; i < 16; i++)
+	{
+		const float r = block[i * 4 + 0] - mean[0];
+		const float g = block[i * 4 + 1] - mean[1];
+		const float b = block[i * 4 + 2] - mean[2];
+		covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+		covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+	}
+
+	// seeded with the covariance row of largest magnitude. a fixed seed like (1,1,1) is orthogonal to
+	// the axis of e.g. a red/green edge, the iteration then never leaves it and the block goes flat
+	const float rows[3][3] = {
+		{ covariance[0], covariance[1], covariance[2] },
+		{ covariance[1], covariance[3], covariance[4] },
+		{ covariance[2], covariance[4], covariance[5] },
+	};
+	float axis[3] = {};
+	float seedLength = 0.0f;
+	for (int row = 0; row < 3; row++)
+	{
+		const float length = sqrtf(rows[row][0] * rows[row][0] + rows[row][1] * rows[row][1] + rows[row][2] * rows[row][2]);
+		if (length > seedLength)
+		{
+			seedLength = length;
+			for (int c = 0; c < 3; c++) axis[c] = rows[row][c] / length;
+		}
+	}
+
+	// no variance at all, any axis will do. the bounding box diagonal is as good as any
+	if (seedLength < 1e-6f)
+	{
+		unsigned char lo[3] = { 255, 255, 255 }, hi[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				lo[c] = std::min(lo[c], block[i * 4 + c]);
+				hi[c] = std::max(hi[c], block[i * 4 + c]);
+			}
+		}
+		const float x = (float)(hi[0] - lo[0]), y = (float)(hi[1] - lo[1]), z = (float)(hi[2] - lo[2]);
+		const float length = sqrtf(x * x + y * y + z * z);
+		if (length > 0.0f)
+		{
+			axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+		}
+	}
+
+	// a few power iterations are plenty for a 3x3 matrix
+	for (int iteration = 0; iteration < 4; iteration++)
+	{
+		const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		const float length = sqrtf(x * x + y * y + z * z);
+		if (length < 1e-6f)
+		{
+			break;
+		}
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+
+	float minProjection = 1e9f, maxProjection = -1e9f;
+	for (int i = 0; i < 16; i++)
+	{
+		const float projection =
+			(block[i * 4 + 0] - mean[0]) * axis[0] +
+			(block[i * 4 + 1] - mean[1]) * axis[1] +
+			(block[i * 4 + 2] - mean[2]) * axis[2];
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	// inset a little, the extremes are rarely worth a palette entry of their own
+	const float inset = (maxProjection - minProjection) / 16.0f;
+	minProjection += inset;
+	maxProjection -= inset;
+
+	float endpoint0[3], endpoint1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		endpoint0[c] = mean[c] + axis[c] * maxProjection;
+		endpoint1[c] = mean[c] + axis[c] * minProjection;
+	}
+
+	uint16_t color0 = PackColor565(endpoint0);
+	uint16_t color1 = PackColor565(endpoint1);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackColor565(color0, palette[0]);
+		UnpackColor565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			int bestDistance = 0x7fffffff;
+			for (int p = 0; p < 4; p++)
+			{
+				const int dr = block[i * 4 + 0] - palette[p][0];
+				const int dg = block[i * 4 + 1] - palette[p][1];
+				const int db = block[i * 4 + 2] - palette[p][2];
+				const int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = p;
+				}
+			}
+			indices |= (uint32_t)bestIndex << (i * 2);
+		}
+	}
+
+	out[0] = (unsigned char)(color0 & 0xff);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xff);
+	out[3] = (unsigned char)(color1 >> 8);
+	out[4] = (unsigned char)(indices & 0xff);
+	out[5] = (unsigned char)((indices >> 8) & 0xff);
+	out[6] = (unsigned char)((indices >> 16) & 0xff);
+	out[7] = (unsigned char)(indices >> 24);
+}
+
+// min/max endpoints with the six interpolated steps in between
+static void EncodeAlphaBlock(const unsigned char block[64], unsigned char out[8])
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+		alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		int palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int step = 1; step < 7; step++)
+		{
+			palette[step + 1] = ((7 - step) * alpha0 + step * alpha1) / 7;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			const int alpha = block[i * 4 + 3];
+			int bestIndex = 0;
+			int bestDistance = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				const int distance = abs(alpha - palette[p]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = p;
+				}
+			}
+			indices |= (uint64_t)bestIndex << (i * 3);
+		}
+	}
+
+	out[0] = (unsigned char)alpha0;
+	out[1] = (unsigned char)alpha1;
+	for (int i = 0; i < 6; i++)
+	{
+		out[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xff);
+	}
+}
+
+void CompressBC1(const unsigned char* pixels, int width, int height, unsigned char* outBlocks)
+{
+	unsigned char block[64];
+	for (int blockY = 0; blockY < (height + 3) / 4; blockY++)
+	{
+		for (int blockX = 0; blockX < (width + 3) / 4; blockX++)
+		{
+			FetchBlock(pixels, width, height, blockX, blockY, block);
+			EncodeColorBlock(block, outBlocks);
+			outBlocks += 8;
+		}
+	}
+}
+
+void CompressBC3(const unsigned char* pixels, int width, int height, unsigned char* outBlocks)
+{
+	unsigned char block[64];
+	for (int blockY = 0; blockY < (height + 3) / 4; blockY++)
+	{
+		for (int blockX = 0; blockX < (width + 3) / 4; blockX++)
+		{
+			FetchBlock(pixels, width, height, blockX, blockY, block);
+			EncodeAlphaBlock(block, outBlocks);
+			EncodeColorBlock(block, outBlocks + 8);
+			outBlocks += 16;
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include "db.h"
+
+// pixel layout of a db::Preview
+enum class PreviewFormat : int
+{
+	RGBA8 = 0,
+	BC1 = 1,  // opaque images, 8 bytes per 4x4 block
+	BC3 = 2   // images with alpha, 16 bytes per 4x4 block
+};
+
+// fits width x height into maxSize keeping the aspect ratio, never upscales
+void FitImageSize(int width, int height, int maxSize, int& outWidth, int& outHeight);
+
+// box filters rgba pixels to the target size, colors are weighted by alpha
+// so transparent pixels don't bleed their (usually black) color
+void DownscaleImage(const unsigned char* pixels, int width, int height,
+	int targetWidth, int targetHeight, std::vector<unsigned char>& outPixels);
+
+// bytes of one mip level
+size_t GetPreviewLevelSize(PreviewFormat format, int width, int height);
+
+// downscales to fit maxSize and builds the full mip chain down to 1x1, levels are stored back to back.
+// bCompress picks bc1 for opaque and bc3 for translucent images
+void BuildPreview(const unsigned char* pixels, int width, int height, int maxSize, bool bCompress, db::Preview& outPreview);
+
+// block compression of a whole rgba image, partial blocks on the edges repeat the last row/column
+void CompressBC1(const unsigned char* pixels, int width, int height, unsigned char* outBlocks);
+void CompressBC3(const unsigned char* pixels, int width, int height, unsigned char* outBlocks);
@@ -0,0 +1,457 @@
+#include "scanner.h"
+#include "audioprobe.h"
+#include "imageprobe.h"
+#include "jobsystem.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <unordered_set>
+
+// files per db batch, small enough for the first results to show up quickly
+static const size_t SCAN_BATCH_SIZE = 512;
+// batches in flight between scanner jobs and the db writer
+static const size_t SCAN_QUEUE_CAPACITY = 64;
+
+static size_t ChangeCount(const db::ScanChanges& changes)
+{
+	return changes.upserts.size() + changes.removedFileIds.size() +
+		changes.removedDirectories.size() + changes.directories.size();
+}
+
+AssetScanner::AssetScanner()
+	: changeQueue(SCAN_QUEUE_CAPACITY)
+{
+}
+
+AssetScanner::~AssetScanner()
+{
+	Stop();
+}
+
+const char* AssetScanner::GetFileType(const char* ext)
+{
+	if (strcmp(ext, ".png") == 0 ||
+		strcmp(ext, ".jpg") == 0)
+	{
+		return db::TEXTURE_FILE_TYPE;
+	}
+	else if (
+		strcmp(ext, ".ogg") == 0 ||
+		strcmp(ext, ".mp3") == 0 ||
+		strcmp(ext, ".wav") == 0)
+	{
+		return db::AUDIO_FILE_TYPE;
+	}
+	return nullptr;
+}
+
+std::string AssetScanner::GetExtension(const std::string& name)
+{
+	const size_t dot = name.find('.');
+	return dot != std::string::npos ? name.substr(dot) : std::string();
+}
+
+bool AssetScanner::GetModifiedTime(const char* path, int64_t& outMtime)
+{
+	size_t size;
+	return GetFileStats(path, outMtime, size);
+}
+
+bool AssetScanner::GetFileStats(const char* path, int64_t& outMtime, size_t& outSize)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0) return false;
+#else
+	struct stat info;
+	if (stat(path, &info) != 0) return false;
+#endif
+	outMtime = (int64_t)info.st_mtime;
+	outSize = (size_t)info.st_size;
+	return true;
+}
+
+bool AssetScanner::ReadHeader(db::File& file)
+{
+	if (file.type == db::TEXTURE_FILE_TYPE)
+	{
+		ImageHeader header;
+		if (!ProbeImageFile(file.path.c_str(), header))
+		{
+			file.codec = db::UNKNOWN_CODEC;
+			return false;
+		}
+
+		file.width = header.width;
+		file.height = header.height;
+		file.components = header.components;
+		file.codec = header.codec;
+		return true;
+	}
+
+	if (file.type != db::AUDIO_FILE_TYPE)
+	{
+		return false;
+	}
+
+	AudioHeader header;
+	if (!ProbeAudioFile(file.path.c_str(), header))
+	{
+		file.codec = db::UNKNOWN_CODEC;
+		return false;
+	}
+
+	file.durationMs = header.durationMs;
+	file.sampleRate = header.sampleRate;
+	file.channels = header.channels;
+	file.codec = header.codec;
+	return true;
+}
+
+void AssetScanner::Start(const std::vector<std::string>& roots, unsigned threadCount)
+{
+	if (bRunning)
+	{
+		printf("[scanner]: already running\n");
+		return;
+	}
+
+	bRunning = true;
+	bCancel = false;
+	progress.directoriesQueued = 0;
+	progress.directoriesScanned = 0;
+	progress.directoriesSkipped = 0;
+	progress.filesFound = 0;
+	progress.filesWritten = 0;
+	progress.filesRemoved = 0;
+	progress.filesProbed = 0;
+	progress.bDone = false;
+	changeQueue.Reset();
+
+	jobs = std::make_unique<JobSystem>(threadCount);
+	writerThread = std::thread(&AssetScanner::WriterLoop, this);
+
+	// loading the fingerprints is a full table read, keep it off the caller's thread too.
+	// closes the queue once every directory job is done so the writer can drain and exit
+	joinThread = std::thread([this, roots] {
+		LoadKnownState();
+
+		for (const auto& root : roots)
+		{
+			progress.directoriesQueued++;
+			jobs->Submit([this, root] { ScanDirectory(root, ""); });
+		}
+
+		jobs->WaitIdle();
+		changeQueue.Close();
+		});
+}
+
+void AssetScanner::Stop()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bCancel = true;
+	joinThread.join();
+	writerThread.join();
+	jobs.reset();
+	knownDirectories.clear();
+	bRunning = false;
+}
+
+void AssetScanner::LoadKnownState()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	knownDirectories.clear();
+
+	for (auto& directory : db::GetDirectories())
+	{
+		auto& known = knownDirectories[directory.path];
+		known.mtime = directory.mtime;
+		known.bFingerprinted = true;
+
+		if (!directory.parent.empty())
+		{
+			knownDirectories[directory.parent].children.push_back(directory.path);
+		}
+	}
+
+	const auto fingerprints = db::GetFileFingerprints();
+	for (const auto& fingerprint : fingerprints)
+	{
+		knownDirectories[fingerprint.directory].files[fingerprint.name] =
+			KnownFile{ fingerprint.id, fingerprint.mtime, fingerprint.size, fingerprint.bProbed };
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("[scanner]: loaded %d known files in %d directories (%lld ms)\n",
+		(int)fingerprints.size(), (int)knownDirectories.size(), (long long)elapsed.count());
+}
+
+void AssetScanner::ScanDirectory(std::string path, std::string parent)
+{
+	if (bCancel)
+	{
+		return;
+	}
+
+	const auto knownIt = knownDirectories.find(path);
+	const KnownDirectory* known = knownIt != knownDirectories.end() ? &knownIt->second : nullptr;
+
+	db::ScanChanges changes;
+
+	int64_t directoryMtime = 0;
+	if (!GetModifiedTime(path.c_str(), directoryMtime))
+	{
+		// a root that went away, subdirectories are handled by their parent's diff
+		if (known)
+		{
+			changes.removedDirectories.push_back(path);
+			FlushChanges(changes);
+		}
+		progress.directoriesScanned++;
+		return;
+	}
+
+	// same entries as last time, the listing doesn't need to be diffed. files rewritten in place
+	// don't touch their directory's mtime though, so every known file still gets a stat.
+	// files from a db that predates header parsing are probed here too
+	if (known && known->bFingerprinted && known->mtime == directoryMtime)
+	{
+		for (const auto& child : known->children)
+		{
+			progress.directoriesQueued++;
+			jobs->Submit([this, child, path] { ScanDirectory(child, path); });
+		}
+
+		for (const auto& knownFile : known->files)
+		{
+			if (bCancel)
+			{
+				break;
+			}
+
+			db::File file;
+			file.name = knownFile.first;
+			file.path = path + "/" + knownFile.first;
+			file.directory = path;
+			if (!GetFileStats(file.path.c_str(), file.mtime, file.size))
+			{
+				// deleted since the directory was stat'ed, its next listing removes it
+				continue;
+			}
+			progress.filesFound++;
+
+			if (file.mtime == knownFile.second.mtime && file.size == knownFile.second.size && knownFile.second.bProbed)
+			{
+				continue;
+			}
+
+			file.ext = GetExtension(file.name);
+			const char* type = GetFileType(file.ext.c_str());
+			if (!type)
+			{
+				continue;
+			}
+			file.type = type;
+			if (ReadHeader(file))
+			{
+				progress.filesProbed++;
+			}
+			changes.upserts.push_back(std::move(file));
+
+			if (ChangeCount(changes) >= SCAN_BATCH_SIZE)
+			{
+				FlushChanges(changes);
+			}
+		}
+		FlushChanges(changes);
+
+		progress.directoriesSkipped++;
+		progress.directoriesScanned++;
+		return;
+	}
+
+	cf_dir_t dir;
+	if (!cf_dir_open(&dir, path.c_str()))
+	{
+		printf("[scanner]: failed to open directory [%s]\n", path.c_str());
+		progress.directoriesScanned++;
+		return;
+	}
+
+	std::unordered_set<std::string> seenFiles;
+	std::unordered_set<std::string> seenDirectories;
+
+	while (dir.has_next && !bCancel)
+	{
+		cf_file_t rawfile;
+		cf_read_file(&dir, &rawfile);
+
+		if (rawfile.is_dir && rawfile.name[0] != '.')
+		{
+			// one job per subdirectory, idle workers steal these
+			std::string subdir = path + "/" + rawfile.name;
+			seenDirectories.insert(subdir);
+			progress.directoriesQueued++;
+			jobs->Submit([this, subdir, path] { ScanDirectory(subdir, path); });
+		}
+		else if (rawfile.is_reg)
+		{
+			const char* type = GetFileType(rawfile.ext);
+			if (type)
+			{
+				db::File file(rawfile);
+				file.type = type;
+				GetModifiedTime(file.path.c_str(), file.mtime);
+				seenFiles.insert(file.name);
+				progress.filesFound++;
+
+				const KnownFile* knownFile = nullptr;
+				if (known)
+				{
+					const auto fileIt = known->files.find(file.name);
+					if (fileIt != known->files.end()) knownFile = &fileIt->second;
+				}
+
+				if (knownFile && knownFile->mtime == file.mtime && knownFile->size == file.size && knownFile->bProbed)
+				{
+					// unchanged
+				}
+				else
+				{
+					// new, changed or never probed
+					if (ReadHeader(file))
+					{
+						progress.filesProbed++;
+					}
+					changes.upserts.push_back(std::move(file));
+				}
+
+				if (ChangeCount(changes) >= SCAN_BATCH_SIZE)
+				{
+					FlushChanges(changes);
+				}
+			}
+		}
+
+		cf_dir_next(&dir);
+	}
+	cf_dir_close(&dir);
+
+	// a partial listing must neither delete entries nor record a fingerprint
+	if (!bCancel)
+	{
+		if (known)
+		{
+			for (const auto& knownFile : known->files)
+			{
+				if (seenFiles.find(knownFile.first) == seenFiles.end())
+				{
+					changes.removedFileIds.push_back(knownFile.second.id);
+				}
+			}
+
+			for (const auto& child : known->children)
+			{
+				if (seenDirectories.find(child) == seenDirectories.end())
+				{
+					changes.removedDirectories.push_back(child);
+				}
+			}
+		}
+
+		// register subdirectories right away, otherwise a child whose scan gets cancelled
+		// would be unreachable behind this directory's matching fingerprint next time
+		for (const auto& subdir : seenDirectories)
+		{
+			const auto subdirIt = knownDirectories.find(subdir);
+			if (subdirIt == knownDirectories.end() || !subdirIt->second.bFingerprinted)
+			{
+				db::Directory placeholder;
+				placeholder.path = subdir;
+				placeholder.parent = path;
+				placeholder.mtime = -1;
+				changes.directories.push_back(std::move(placeholder));
+			}
+		}
+
+		db::Directory directory;
+		directory.path = path;
+		directory.parent = parent;
+		directory.mtime = directoryMtime;
+		changes.directories.push_back(std::move(directory));
+	}
+
+	FlushChanges(changes);
+	progress.directoriesScanned++;
+}
+
+void AssetScanner::FlushChanges(db::ScanChanges& changes)
+{
+	if (changes.empty())
+	{
+		return;
+	}
+
+	changeQueue.Push(std::move(changes));
+	changes = db::ScanChanges();
+}
+
+void AssetScanner::WriterLoop()
+{
+	// merge small per directory batches so we don't pay a transaction per tiny folder
+	db::ScanChanges pending;
+	db::ScanChanges changes;
+
+	const auto append = [](auto& to, auto& from)
+	{
+		to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	db::BulkWriter writer;
+
+	const auto commit = [this, &pending, &writer]
+	{
+		if (pending.empty()) return;
+		writer.ApplyScanChanges(pending);
+		progress.filesWritten += (int)pending.upserts.size();
+		progress.filesRemoved += (int)pending.removedFileIds.size();
+
+		// directory only batches don't change what the browser shows
+		if (!pending.upserts.empty() || !pending.removedFileIds.empty() || !pending.removedDirectories.empty())
+		{
+			bDirty = true;
+		}
+		pending = db::ScanChanges();
+	};
+
+	while (changeQueue.Pop(changes))
+	{
+		append(pending.upserts, changes.upserts);
+		append(pending.removedFileIds, changes.removedFileIds);
+		append(pending.removedDirectories, changes.removedDirectories);
+		append(pending.directories, changes.directories);
+
+		if (ChangeCount(pending) >= SCAN_BATCH_SIZE || changeQueue.Size() == 0)
+		{
+			commit();
+		}
+	}
+	commit();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const int written = progress.filesWritten.load();
+
+	progress.bDone = true;
+	printf("[scanner]: done in %.2fs. %d directories (%d unchanged), %d files written (%.0f rows/s), %d removed, %d headers read\n",
+		seconds, progress.directoriesScanned.load(), progress.directoriesSkipped.load(),
+		written, seconds > 0.0 ? written / seconds : 0.0, progress.filesRemoved.load(), progress.filesProbed.load());
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "db.h"
+#include "boundedqueue.h"
+
+class JobSystem;
+
+struct ScanProgress
+{
+	std::atomic<int> directoriesQueued{ 0 };
+	std::atomic<int> directoriesScanned{ 0 };
+	std::atomic<int> directoriesSkipped{ 0 };  // fingerprint matched, listing not diffed
+	std::atomic<int> filesFound{ 0 };
+	std::atomic<int> filesWritten{ 0 };        // inserted or updated
+	std::atomic<int> filesRemoved{ 0 };
+	std::atomic<int> filesProbed{ 0 };         // audio and image headers parsed
+	std::atomic<bool> bDone{ false };
+};
+
+// walks the asset roots in the background, one job per directory, and streams
+// db::ScanChanges to a single writer thread through a bounded queue.
+// rescans are incremental: the known file and directory fingerprints are loaded once up front,
+// unchanged directories are skipped and only new, changed and deleted entries reach the db.
+// new and changed files get their header parsed on the directory job, so duration, rate and
+// channels of sounds and the size of images are in the db (and searchable) without ever decoding them.
+class AssetScanner
+{
+public:
+	AssetScanner();
+	~AssetScanner();
+
+	// threadCount 0 -> hardware concurrency
+	void Start(const std::vector<std::string>& roots, unsigned threadCount = 0);
+
+	// cancels outstanding directory jobs and flushes what was already found
+	void Stop();
+
+	bool IsRunning() const { return bRunning; }
+	const ScanProgress& GetProgress() const { return progress; }
+
+	// true once after new files were committed to the db since the last call
+	bool ConsumeDirty() { return bDirty.exchange(false); }
+
+	// returns the db type string for a supported extension, null otherwise
+	static const char* GetFileType(const char* ext);
+
+	// from the first dot on, the way cute_files fills cf_file_t::ext. empty without a dot
+	static std::string GetExtension(const std::string& name);
+
+	// last write time in seconds, false if the path doesn't exist
+	static bool GetModifiedTime(const char* path, int64_t& outMtime);
+	static bool GetFileStats(const char* path, int64_t& outMtime, size_t& outSize);
+
+	// fills the header columns of a sound or image from its file, marks it probed even if the
+	// header couldn't be read. false for other types and unreadable headers
+	static bool ReadHeader(db::File& file);
+
+private:
+	struct KnownFile
+	{
+		int id;
+		int64_t mtime;
+		size_t size;
+		bool bProbed;
+	};
+
+	struct KnownDirectory
+	{
+		int64_t mtime = 0;
+		bool bFingerprinted = false;  // false for directories only known through their files
+		std::vector<std::string> children;
+		std::unordered_map<std::string, KnownFile> files;  // by name
+	};
+
+	void LoadKnownState();
+	void ScanDirectory(std::string path, std::string parent);
+	void FlushChanges(db::ScanChanges& changes);
+	void WriterLoop();
+
+	std::unique_ptr<JobSystem> jobs;
+	BoundedQueue<db::ScanChanges> changeQueue;
+	std::thread writerThread;
+	std::thread joinThread;
+
+	// read only while directory jobs are running
+	std::unordered_map<std::string, KnownDirectory> knownDirectories;
+
+	ScanProgress progress;
+	std::atomic<bool> bDirty{ false };
+	std::atomic<bool> bCancel{ false };
+	bool bRunning = false;
+};
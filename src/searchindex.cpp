@@ -0,0 +1,810 @@
+#include "searchindex.h"
+#include "stringsearch.h"
+#include "jobsystem.h"
+#include "perceptualhash.h"
+#include "audiofingerprint.h"
+#include "scanner.h"
+
+#define FTS_FUZZY_MATCH_IMPLEMENTATION
+#include "fuzzy_match.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+AssetType GetAssetType(const char* dbType)
+{
+	if (strcmp(dbType, db::TEXTURE_FILE_TYPE) == 0) return AssetType::Texture;
+	if (strcmp(dbType, db::AUDIO_FILE_TYPE) == 0) return AssetType::Audio;
+	return AssetType::Unknown;
+}
+
+static const char* GetDbType(AssetType type)
+{
+	switch (type)
+	{
+	case AssetType::Texture: return db::TEXTURE_FILE_TYPE;
+	case AssetType::Audio: return db::AUDIO_FILE_TYPE;
+	default: return "";
+	}
+}
+
+std::shared_ptr<SearchIndex> SearchIndex::LoadFromDb()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	auto index = std::make_shared<SearchIndex>();
+	db::VisitFiles([&index](const db::FileView& file)
+		{
+			index->Add(file);
+		});
+	index->ScaleFingerprints();
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("[search]: indexed %u files in %lld ms (%s)\n",
+		index->GetRowCount(), (long long)elapsed.count(), strsearch::GetKernelName());
+
+	return index;
+}
+
+void SearchIndex::ToLower(const char* in, std::string& out)
+{
+	out.clear();
+	for (const char* c = in; *c; c++)
+	{
+		out += (*c >= 'A' && *c <= 'Z') ? (char)(*c - 'A' + 'a') : *c;
+	}
+}
+
+void SearchIndex::Add(const db::FileView& file)
+{
+	const char* name = file.name;
+	const char* path = file.path;
+
+	const size_t nameLength = strlen(name) + 1;
+	names.insert(names.end(), name, name + nameLength);
+	for (size_t i = 0; i < nameLength; i++)
+	{
+		const char c = name[i];
+		lowerNames.push_back((c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c);
+	}
+	nameOffsets.push_back((uint32_t)names.size());
+
+	const size_t pathLength = strlen(path) + 1;
+	paths.insert(paths.end(), path, path + pathLength);
+	pathOffsets.push_back((uint32_t)paths.size());
+
+	ids.push_back(file.id);
+	types.push_back(GetAssetType(file.type));
+	sizes.push_back(file.size);
+	mtimes.push_back(file.mtime);
+
+	durationsMs.push_back(file.durationMs);
+	sampleRates.push_back(file.sampleRate);
+	channelCounts.push_back((uint8_t)std::min(file.channels, 255));
+
+	widths.push_back((uint32_t)std::max(file.width, 0));
+	heights.push_back((uint32_t)std::max(file.height, 0));
+	componentCounts.push_back((uint8_t)std::min(std::max(file.components, 0), 255));
+
+	if (file.perceptualHash != 0)
+	{
+		perceptualHashes.push_back(file.perceptualHash);
+		hashedRows.push_back((uint32_t)ids.size() - 1);
+	}
+
+	if (file.fingerprint)
+	{
+		const size_t offset = fingerprints.size();
+		fingerprints.resize(offset + db::AUDIO_FINGERPRINT_SIZE);
+		memcpy(&fingerprints[offset], file.fingerprint, db::AUDIO_FINGERPRINT_SIZE * sizeof(float));
+		for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i++)
+		{
+			fingerprints[offset + i] *= fingerprintScales[i];
+		}
+		fingerprintRows.push_back((uint32_t)ids.size() - 1);
+	}
+
+	const auto codecIt = std::find(codecNames.begin(), codecNames.end(), file.codec);
+	codecIds.push_back((uint8_t)(codecIt - codecNames.begin()));
+	if (codecIt == codecNames.end())
+	{
+		codecNames.push_back(file.codec);
+	}
+}
+
+void SearchIndex::FilterAudioFormat(const db::AudioFormatFilter& filter, std::vector<uint32_t>& inOutRows) const
+{
+	if (filter.IsEmpty())
+	{
+		return;
+	}
+
+	inOutRows.erase(std::remove_if(inOutRows.begin(), inOutRows.end(), [this, &filter](uint32_t row)
+		{
+			return !filter.Matches(channelCounts[row], sampleRates[row], durationsMs[row]);
+		}), inOutRows.end());
+}
+
+bool SearchIndex::ParseAudioFormatToken(const char* token, db::AudioFormatFilter& filter)
+{
+	std::string lower;
+	ToLower(token, lower);
+
+	if (lower == "mono")
+	{
+		filter.channels = 1;
+		return true;
+	}
+	if (lower == "stereo")
+	{
+		filter.channels = 2;
+		return true;
+	}
+
+	// durations: <2s, <=2s, >500ms, >=1.5s
+	if (lower[0] == '<' || lower[0] == '>')
+	{
+		const bool bLess = lower[0] == '<';
+		const bool bInclusive = lower.size() > 1 && lower[1] == '=';
+		const char* number = lower.c_str() + (bInclusive ? 2 : 1);
+
+		char* unit = nullptr;
+		const double value = strtod(number, &unit);
+		if (unit == number)
+		{
+			return false;
+		}
+
+		double milliseconds;
+		if (strcmp(unit, "ms") == 0) milliseconds = value;
+		else if (strcmp(unit, "s") == 0 || *unit == '\0') milliseconds = value * 1000.0;
+		else if (strcmp(unit, "m") == 0 || strcmp(unit, "min") == 0) milliseconds = value * 60000.0;
+		else return false;
+
+		// the filter is [min, max), nudge inclusive bounds by a millisecond
+		const int64_t bound = (int64_t)(milliseconds + 0.5);
+		if (bLess) filter.maxDurationMs = bInclusive ? bound + 1 : bound;
+		else filter.minDurationMs = bInclusive ? bound : bound + 1;
+		return true;
+	}
+
+	// channel counts and sample rates: 6ch, 48k, 44.1khz, 22050hz
+	char* unit = nullptr;
+	const double value = strtod(lower.c_str(), &unit);
+	if (unit == lower.c_str() || value <= 0.0)
+	{
+		return false;
+	}
+
+	if (strcmp(unit, "ch") == 0 && value <= 64.0)
+	{
+		filter.channels = (int)value;
+		return true;
+	}
+
+	// 44.1k, 22.05k. out of range values like "2k" are more likely part of a name
+	int sampleRate = 0;
+	if (strcmp(unit, "k") == 0 || strcmp(unit, "khz") == 0) sampleRate = (int)(value * 1000.0 + 0.5);
+	else if (strcmp(unit, "hz") == 0) sampleRate = (int)(value + 0.5);
+
+	if (sampleRate >= 8000 && sampleRate <= 384000)
+	{
+		filter.sampleRate = sampleRate;
+		return true;
+	}
+	return false;
+}
+
+void SearchIndex::FilterImageSize(const db::ImageSizeFilter& filter, std::vector<uint32_t>& inOutRows) const
+{
+	if (filter.IsEmpty())
+	{
+		return;
+	}
+
+	inOutRows.erase(std::remove_if(inOutRows.begin(), inOutRows.end(), [this, &filter](uint32_t row)
+		{
+			return !filter.Matches((int)widths[row], (int)heights[row], componentCounts[row]);
+		}), inOutRows.end());
+}
+
+void SearchIndex::SortByImageSize(std::vector<uint32_t>& inOutRows) const
+{
+	std::stable_sort(inOutRows.begin(), inOutRows.end(), [this](uint32_t a, uint32_t b)
+		{
+			const uint64_t pixelsA = (uint64_t)widths[a] * heights[a];
+			const uint64_t pixelsB = (uint64_t)widths[b] * heights[b];
+			return pixelsA < pixelsB || (pixelsA == pixelsB && widths[a] < widths[b]);
+		});
+}
+
+bool SearchIndex::GetPerceptualHash(uint32_t row, uint64_t& outHash) const
+{
+	const auto it = std::lower_bound(hashedRows.begin(), hashedRows.end(), row);
+	if (it == hashedRows.end() || *it != row)
+	{
+		return false;
+	}
+	outHash = perceptualHashes[it - hashedRows.begin()];
+	return true;
+}
+
+// keys have the distance in the high bits, so sorting them orders by distance, then index
+static inline void CollectSimilarHashes(const uint64_t* hashes, size_t count, uint64_t hash, int maxDistance, std::vector<uint64_t>& outKeys)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const int distance = GetHashDistance(hashes[i], hash);
+		if (distance <= maxDistance)
+		{
+			outKeys.push_back(((uint64_t)distance << 32) | i);
+		}
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// the build targets baseline x86-64, where the popcount is a libgcc call. this copy gets the
+// instruction and is picked at runtime, about 5x faster over a million hashes
+__attribute__((target("popcnt")))
+static void CollectSimilarHashesPopcnt(const uint64_t* hashes, size_t count, uint64_t hash, int maxDistance, std::vector<uint64_t>& outKeys)
+{
+	CollectSimilarHashes(hashes, count, hash, maxDistance, outKeys);
+}
+#endif
+
+void SearchIndex::FindSimilarImages(uint64_t hash, int maxDistance, size_t maxResults, const RowFilter& filter, std::vector<uint32_t>& outRows) const
+{
+	std::vector<uint64_t> matches;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	static const bool bHasPopcnt = __builtin_cpu_supports("popcnt");
+	if (bHasPopcnt) CollectSimilarHashesPopcnt(perceptualHashes.data(), perceptualHashes.size(), hash, maxDistance, matches);
+	else
+#endif
+	CollectSimilarHashes(perceptualHashes.data(), perceptualHashes.size(), hash, maxDistance, matches);
+
+	// only what is within distance reaches the filter, usually a small fraction of the hashes
+	if (filter)
+	{
+		matches.erase(std::remove_if(matches.begin(), matches.end(), [this, &filter](uint64_t key)
+			{
+				return !filter(hashedRows[(uint32_t)key]);
+			}), matches.end());
+	}
+
+	const size_t kept = std::min(matches.size(), maxResults);
+	std::partial_sort(matches.begin(), matches.begin() + kept, matches.end());
+
+	outRows.clear();
+	outRows.reserve(kept);
+	for (size_t i = 0; i < kept; i++)
+	{
+		outRows.push_back(hashedRows[(uint32_t)matches[i]]);
+	}
+}
+
+void SearchIndex::ScaleFingerprints()
+{
+	const size_t count = fingerprintRows.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	// 1 / standard deviation per dimension, makes the distance a standardized one
+	for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i++)
+	{
+		double sum = 0.0;
+		double sumSquares = 0.0;
+		for (size_t row = 0; row < count; row++)
+		{
+			const double value = fingerprints[row * db::AUDIO_FINGERPRINT_SIZE + i] / fingerprintScales[i];
+			sum += value;
+			sumSquares += value * value;
+		}
+		const double mean = sum / count;
+		const double deviation = sqrt(std::max(0.0, sumSquares / count - mean * mean));
+		const float scale = deviation > 1e-6 ? (float)(1.0 / deviation) : 1.0f;
+
+		for (size_t row = 0; row < count; row++)
+		{
+			float& value = fingerprints[row * db::AUDIO_FINGERPRINT_SIZE + i];
+			value = value / fingerprintScales[i] * scale;
+		}
+		fingerprintScales[i] = scale;
+	}
+}
+
+bool SearchIndex::GetAudioFingerprint(uint32_t row, std::vector<float>& outFingerprint) const
+{
+	const auto it = std::lower_bound(fingerprintRows.begin(), fingerprintRows.end(), row);
+	if (it == fingerprintRows.end() || *it != row)
+	{
+		return false;
+	}
+
+	const float* scaled = &fingerprints[(it - fingerprintRows.begin()) * db::AUDIO_FINGERPRINT_SIZE];
+	outFingerprint.resize(db::AUDIO_FINGERPRINT_SIZE);
+	for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i++)
+	{
+		outFingerprint[i] = scaled[i] / fingerprintScales[i];
+	}
+	return true;
+}
+
+void SearchIndex::FindSimilarSounds(const std::vector<float>& fingerprint, size_t maxResults, const RowFilter& filter, std::vector<uint32_t>& outRows) const
+{
+	outRows.clear();
+	if (fingerprint.size() != (size_t)db::AUDIO_FINGERPRINT_SIZE)
+	{
+		return;
+	}
+
+	float query[db::AUDIO_FINGERPRINT_SIZE];
+	for (int i = 0; i < db::AUDIO_FINGERPRINT_SIZE; i++)
+	{
+		query[i] = fingerprint[i] * fingerprintScales[i];
+	}
+
+	const size_t count = fingerprintRows.size();
+	std::vector<std::pair<float, uint32_t>> distances;
+	distances.reserve(filter ? 0 : count);
+	const float* candidate = fingerprints.data();
+	for (size_t i = 0; i < count; i++, candidate += db::AUDIO_FINGERPRINT_SIZE)
+	{
+		if (filter && !filter(fingerprintRows[i]))
+		{
+			continue;
+		}
+		distances.emplace_back(GetFingerprintDistance(query, candidate), fingerprintRows[i]);
+	}
+
+	const size_t kept = std::min(distances.size(), maxResults);
+	std::partial_sort(distances.begin(), distances.begin() + kept, distances.end());
+
+	outRows.reserve(kept);
+	for (size_t i = 0; i < kept; i++)
+	{
+		outRows.push_back(distances[i].second);
+	}
+}
+
+static void ReplaceAll(std::string& text, const char* from, const char* to)
+{
+	const size_t fromLength = strlen(from);
+	for (size_t position = text.find(from); position != std::string::npos; position = text.find(from, position + 1))
+	{
+		text.replace(position, fromLength, to);
+	}
+}
+
+bool SearchIndex::ParseImageSizeToken(const char* token, db::ImageSizeFilter& filter)
+{
+	std::string lower;
+	ToLower(token, lower);
+
+	if (lower == "gray" || lower == "grey")
+	{
+		filter.components = 1;
+		return true;
+	}
+	if (lower == "rgb")
+	{
+		filter.components = 3;
+		return true;
+	}
+	if (lower == "rgba")
+	{
+		filter.components = 4;
+		return true;
+	}
+
+	// the way people type it when they paste: "≤64×64"
+	ReplaceAll(lower, "\xE2\x89\xA4", "<=");
+	ReplaceAll(lower, "\xE2\x89\xA5", ">=");
+	ReplaceAll(lower, "\xC3\x97", "x");
+
+	// <64x64, <=64x64, >512, >=1024x512, or an exact 64x64
+	char comparison = 0;
+	bool bInclusive = true;
+	const char* text = lower.c_str();
+	if (*text == '<' || *text == '>')
+	{
+		comparison = *text++;
+		bInclusive = *text == '=';
+		if (bInclusive) text++;
+	}
+
+	if (*text < '0' || *text > '9')
+	{
+		return false;
+	}
+
+	char* end = nullptr;
+	const long width = strtol(text, &end, 10);
+	long height = width;
+	if (*end == 'x')
+	{
+		const char* heightText = end + 1;
+		if (*heightText < '0' || *heightText > '9')
+		{
+			return false;
+		}
+		height = strtol(heightText, &end, 10);
+	}
+	else if (comparison == 0)
+	{
+		// a bare number is more likely part of a name
+		return false;
+	}
+
+	if (*end != '\0' || width <= 0 || height <= 0 || width > (1 << 24) || height > (1 << 24))
+	{
+		return false;
+	}
+
+	const int offset = bInclusive ? 0 : 1;
+	if (comparison == '<' && (width - offset <= 0 || height - offset <= 0))
+	{
+		// "<1" would leave no bound at all
+		return false;
+	}
+
+	if (comparison == '<')
+	{
+		filter.maxWidth = (int)width - offset;
+		filter.maxHeight = (int)height - offset;
+	}
+	else if (comparison == '>')
+	{
+		filter.minWidth = (int)width + offset;
+		filter.minHeight = (int)height + offset;
+	}
+	else
+	{
+		filter.minWidth = filter.maxWidth = (int)width;
+		filter.minHeight = filter.maxHeight = (int)height;
+	}
+	return true;
+}
+
+db::File SearchIndex::GetFile(uint32_t row) const
+{
+	db::File file;
+	file.id = ids[row];
+	file.name = GetName(row);
+	file.path = GetPath(row);
+	file.type = GetDbType(types[row]);
+	file.size = sizes[row];
+	file.mtime = mtimes[row];
+	file.durationMs = durationsMs[row];
+	file.sampleRate = sampleRates[row];
+	file.channels = channelCounts[row];
+	file.codec = codecNames[codecIds[row]];
+	file.width = (int)widths[row];
+	file.height = (int)heights[row];
+	file.components = componentCounts[row];
+
+	file.ext = AssetScanner::GetExtension(file.name);
+
+	const size_t slash = file.path.rfind('/');
+	if (slash != std::string::npos)
+	{
+		file.directory = file.path.substr(0, slash);
+	}
+	return file;
+}
+
+bool SearchIndex::RowContains(uint32_t row, const std::string& token) const
+{
+	const uint32_t begin = nameOffsets[row];
+	const uint32_t length = nameOffsets[row + 1] - begin - 1;
+	return strsearch::FindFirst(&lowerNames[begin], length, token.c_str(), token.size()) >= 0;
+}
+
+void SearchIndex::SearchToken(const std::string& token, AssetType type, std::vector<uint32_t>& outRows) const
+{
+	struct Context
+	{
+		const SearchIndex* index;
+		AssetType type;
+		std::vector<uint32_t>* rows;
+		uint32_t row;
+	};
+	Context context{ this, type, &outRows, 0 };
+
+	// hits come in arena order, so the owning row only ever moves forward.
+	// after a hit the scan resumes at the next name
+	strsearch::FindAll(lowerNames.data(), lowerNames.size(), token.c_str(), token.size(),
+		[](size_t position, void* userData) -> size_t
+		{
+			Context& context = *(Context*)userData;
+			const auto& offsets = context.index->nameOffsets;
+			while (offsets[context.row + 1] <= position)
+			{
+				context.row++;
+			}
+
+			if (context.index->types[context.row] == context.type)
+			{
+				context.rows->push_back(context.row);
+			}
+			return offsets[context.row + 1];
+		},
+		&context);
+}
+
+void SearchIndex::Search(AssetType type, char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows) const
+{
+	std::vector<std::string> lowerTokens;
+	for (int i = 0; i < tokenCount; i++)
+	{
+		std::string token;
+		ToLower(tokens[i], token);
+		if (!token.empty()) lowerTokens.push_back(std::move(token));
+	}
+
+	const size_t begin = outRows.size();
+
+	if (lowerTokens.empty())
+	{
+		for (uint32_t row = 0; row < GetRowCount(); row++)
+		{
+			if (types[row] == type) outRows.push_back(row);
+		}
+		return;
+	}
+
+	if (bMatchAll)
+	{
+		// scan the arena for the longest token (fewest false candidates),
+		// then check the remaining tokens on the surviving names only
+		std::sort(lowerTokens.begin(), lowerTokens.end(),
+			[](const std::string& a, const std::string& b) { return a.size() > b.size(); });
+
+		SearchToken(lowerTokens[0], type, outRows);
+
+		for (size_t t = 1; t < lowerTokens.size() && outRows.size() > begin; t++)
+		{
+			const auto end = std::remove_if(outRows.begin() + begin, outRows.end(),
+				[this, &lowerTokens, t](uint32_t row) { return !RowContains(row, lowerTokens[t]); });
+			outRows.erase(end, outRows.end());
+		}
+	}
+	else
+	{
+		for (const auto& token : lowerTokens)
+		{
+			SearchToken(token, type, outRows);
+		}
+
+		// every token scan is sorted on its own, merge and dedupe
+		std::sort(outRows.begin() + begin, outRows.end());
+		outRows.erase(std::unique(outRows.begin() + begin, outRows.end()), outRows.end());
+	}
+}
+
+void SearchIndex::Refine(const std::vector<uint32_t>& candidates, char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows) const
+{
+	std::vector<std::string> lowerTokens;
+	for (int i = 0; i < tokenCount; i++)
+	{
+		std::string token;
+		ToLower(tokens[i], token);
+		if (!token.empty()) lowerTokens.push_back(std::move(token));
+	}
+
+	for (uint32_t row : candidates)
+	{
+		bool bMatch = bMatchAll;
+		for (const auto& token : lowerTokens)
+		{
+			if (RowContains(row, token) != bMatchAll)
+			{
+				bMatch = !bMatchAll;
+				break;
+			}
+		}
+
+		if (bMatch || lowerTokens.empty())
+		{
+			outRows.push_back(row);
+		}
+	}
+}
+
+bool IncrementalSearch::IsRefinementOf(const std::vector<std::string>& newTokens, bool bMatchAll) const
+{
+	const auto contains = [](const std::string& token, const std::string& part)
+	{
+		return token.find(part) != std::string::npos;
+	};
+
+	if (bMatchAll)
+	{
+		// every old token still has to match: each is covered by some new token that contains it
+		for (const auto& oldToken : lastTokens)
+		{
+			bool bCovered = false;
+			for (const auto& newToken : newTokens)
+			{
+				if (contains(newToken, oldToken)) { bCovered = true; break; }
+			}
+			if (!bCovered) return false;
+		}
+		return true;
+	}
+
+	// any: every new token must imply one of the old ones
+	if (lastTokens.empty()) return false;
+	for (const auto& newToken : newTokens)
+	{
+		bool bImplied = false;
+		for (const auto& oldToken : lastTokens)
+		{
+			if (contains(newToken, oldToken)) { bImplied = true; break; }
+		}
+		if (!bImplied) return false;
+	}
+	return !newTokens.empty();
+}
+
+void IncrementalSearch::Search(const std::shared_ptr<const SearchIndex>& index, AssetType type,
+	char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows)
+{
+	std::vector<std::string> lowerTokens;
+	for (int i = 0; i < tokenCount; i++)
+	{
+		std::string token;
+		SearchIndex::ToLower(tokens[i], token);
+		if (!token.empty()) lowerTokens.push_back(std::move(token));
+	}
+
+	// re-checking row by row only beats the arena scan while the previous hits are a small part of it
+	const bool bRefine =
+		index == lastIndex &&
+		type == lastType &&
+		bMatchAll == bLastMatchAll &&
+		lastRows.size() < index->GetRowCount() / 4 &&
+		IsRefinementOf(lowerTokens, bMatchAll);
+
+	outRows.clear();
+	if (bRefine)
+	{
+		index->Refine(lastRows, tokens, tokenCount, bMatchAll, outRows);
+	}
+	else
+	{
+		index->Search(type, tokens, tokenCount, bMatchAll, outRows);
+	}
+
+	lastIndex = index;
+	lastType = type;
+	bLastMatchAll = bMatchAll;
+	lastTokens = std::move(lowerTokens);
+	lastRows = outRows;
+}
+
+void IncrementalSearch::Reset()
+{
+	lastIndex.reset();
+	lastTokens.clear();
+	lastRows.clear();
+}
+
+static bool IsSubsequence(const std::string& pattern, const char* str, size_t length)
+{
+	const char* end = str + length;
+	for (char c : pattern)
+	{
+		const char* found = (const char*)memchr(str, c, end - str);
+		if (!found) return false;
+		str = found + 1;
+	}
+	return true;
+}
+
+bool SearchIndex::FuzzySearch(AssetType type, const char* pattern, size_t maxResults, const RowFilter& filter,
+	const std::atomic<bool>* bCancel, std::vector<uint32_t>& outRows) const
+{
+	struct Hit
+	{
+		int score;
+		uint32_t row;
+	};
+
+	// strict ordering so results don't shuffle between equal scores
+	const auto better = [](const Hit& a, const Hit& b)
+	{
+		return a.score > b.score || (a.score == b.score && a.row < b.row);
+	};
+
+	std::string lowerPattern;
+	ToLower(pattern, lowerPattern);
+
+	JobSystem& jobs = JobSystem::GetShared();
+	const uint32_t rowCount = GetRowCount();
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(rowCount / 4096 + 1, jobs.GetThreadCount() * 4));
+
+	// every chunk keeps its own bounded heap, worst hit on top
+	std::vector<std::vector<Hit>> chunkHits(chunkCount);
+	std::atomic<bool> bCancelled{ false };
+
+	jobs.ParallelFor(chunkCount, [&](size_t chunk)
+		{
+			const uint32_t begin = (uint32_t)(rowCount * chunk / chunkCount);
+			const uint32_t end = (uint32_t)(rowCount * (chunk + 1) / chunkCount);
+			auto& heap = chunkHits[chunk];
+			heap.reserve(maxResults);
+
+			for (uint32_t row = begin; row < end; row++)
+			{
+				if ((row & 1023) == 0 && bCancel && bCancel->load(std::memory_order_relaxed))
+				{
+					bCancelled = true;
+					return;
+				}
+
+				if (types[row] != type)
+				{
+					continue;
+				}
+
+				// the subsequence test is a few memchr calls on the lowercase arena,
+				// only run the exhaustive scoring on real candidates
+				if (!IsSubsequence(lowerPattern, &lowerNames[nameOffsets[row]], nameOffsets[row + 1] - nameOffsets[row] - 1))
+				{
+					continue;
+				}
+
+				// filtered before ranking, so a narrow filter still gets the best of what it keeps
+				if (filter && !filter(row))
+				{
+					continue;
+				}
+
+				int score;
+				if (!fts::fuzzy_match(pattern, GetName(row), score))
+				{
+					continue;
+				}
+
+				const Hit hit{ score, row };
+				if (heap.size() < maxResults)
+				{
+					heap.push_back(hit);
+					std::push_heap(heap.begin(), heap.end(), better);
+				}
+				else if (better(hit, heap.front()))
+				{
+					std::pop_heap(heap.begin(), heap.end(), better);
+					heap.back() = hit;
+					std::push_heap(heap.begin(), heap.end(), better);
+				}
+			}
+		});
+
+	if (bCancelled)
+	{
+		return false;
+	}
+
+	std::vector<Hit> hits;
+	for (const auto& heap : chunkHits)
+	{
+		hits.insert(hits.end(), heap.begin(), heap.end());
+	}
+
+	const size_t keep = std::min(maxResults, hits.size());
+	std::partial_sort(hits.begin(), hits.begin() + keep, hits.end(), better);
+
+	outRows.reserve(outRows.size() + keep);
+	for (size_t i = 0; i < keep; i++)
+	{
+		outRows.push_back(hits[i].row);
+	}
+	return true;
+}
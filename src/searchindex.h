@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+enum class AssetType : uint8_t
+{
+	Texture,
+	Audio,
+	Unknown
+};
+
+AssetType GetAssetType(const char* dbType);
+
+// true keeps the row, an empty filter keeps every row. ranked searches call it from the job system's threads
+using RowFilter = std::function<bool(uint32_t row)>;
+
+// resident copy of the files table laid out for searching. names live in one contiguous
+// arena (plus a lowercase copy the matcher scans), every other column is a flat array indexed
+// by row. searches return row indices into the index instead of copied db::File objects.
+// immutable once built, share it through std::shared_ptr<const SearchIndex> and rebuild on change.
+class SearchIndex
+{
+public:
+	// one pass over the files table
+	static std::shared_ptr<SearchIndex> LoadFromDb();
+
+	void Add(const db::FileView& file);
+
+	// appends the rows of the given type whose name contains every (bMatchAll) or any of the
+	// tokens, case insensitive. no tokens matches every row of that type. rows come out sorted
+	void Search(AssetType type, char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows) const;
+
+	// keeps the candidates that contain every (bMatchAll) or any of the tokens, candidate order is preserved
+	void Refine(const std::vector<uint32_t>& candidates, char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows) const;
+
+	// ranks every row of the given type that passes filter with fts::fuzzy_match across the shared job system
+	// and keeps the best maxResults, best first. returns false (and no rows) if bCancel was raised meanwhile
+	bool FuzzySearch(AssetType type, const char* pattern, size_t maxResults, const RowFilter& filter,
+		const std::atomic<bool>* bCancel, std::vector<uint32_t>& outRows) const;
+
+	uint32_t GetRowCount() const { return (uint32_t)ids.size(); }
+	int GetId(uint32_t row) const { return ids[row]; }
+	const char* GetName(uint32_t row) const { return &names[nameOffsets[row]]; }
+	const char* GetPath(uint32_t row) const { return &paths[pathOffsets[row]]; }
+	AssetType GetType(uint32_t row) const { return types[row]; }
+	size_t GetSize(uint32_t row) const { return sizes[row]; }
+	int64_t GetMtime(uint32_t row) const { return mtimes[row]; }
+	int64_t GetDurationMs(uint32_t row) const { return durationsMs[row]; }
+	int GetSampleRate(uint32_t row) const { return sampleRates[row]; }
+	int GetChannels(uint32_t row) const { return channelCounts[row]; }
+	const char* GetCodec(uint32_t row) const { return codecNames[codecIds[row]].c_str(); }
+	int GetWidth(uint32_t row) const { return widths[row]; }
+	int GetHeight(uint32_t row) const { return heights[row]; }
+	int GetComponents(uint32_t row) const { return componentCounts[row]; }
+
+	// drops the rows whose audio header doesn't match, order is preserved
+	void FilterAudioFormat(const db::AudioFormatFilter& filter, std::vector<uint32_t>& inOutRows) const;
+
+	// turns "mono", "stereo", "6ch", "48k", "44.1khz", "22050hz", "<2s", ">=500ms" into filter
+	// constraints. false if the token isn't one, it is then matched against names
+	static bool ParseAudioFormatToken(const char* token, db::AudioFormatFilter& filter);
+
+	// drops the rows whose image size doesn't match, order is preserved
+	void FilterImageSize(const db::ImageSizeFilter& filter, std::vector<uint32_t>& inOutRows) const;
+
+	// smallest images first (by pixel count, then width), stable for equal sizes
+	void SortByImageSize(std::vector<uint32_t>& inOutRows) const;
+
+	// turns "64x64", "<=64x64", ">=1024", "gray", "rgb", "rgba" into filter constraints.
+	// a single number bounds both sides. false if the token isn't one
+	static bool ParseImageSizeToken(const char* token, db::ImageSizeFilter& filter);
+
+	// false if the row isn't an image with a perceptual hash
+	bool GetPerceptualHash(uint32_t row, uint64_t& outHash) const;
+
+	// rows of the images whose perceptual hash is within maxDistance bits and that pass filter, closest first
+	// (then by row), at most maxResults. a linear popcount scan over the packed hashes, no tree to keep up to date
+	void FindSimilarImages(uint64_t hash, int maxDistance, size_t maxResults, const RowFilter& filter, std::vector<uint32_t>& outRows) const;
+
+	// false if the row isn't a sound with a fingerprint
+	bool GetAudioFingerprint(uint32_t row, std::vector<float>& outFingerprint) const;
+
+	// rows of the maxResults sounds passing filter that are closest to the fingerprint, closest first. every
+	// dimension is weighted by its spread over the whole library, so no single coefficient dominates
+	void FindSimilarSounds(const std::vector<float>& fingerprint, size_t maxResults, const RowFilter& filter, std::vector<uint32_t>& outRows) const;
+
+	// materializes a single row, e.g. for the selected item
+	db::File GetFile(uint32_t row) const;
+
+	// lowercase the way the matcher does, ascii only like sqlite's LIKE
+	static void ToLower(const char* in, std::string& out);
+
+private:
+	void SearchToken(const std::string& token, AssetType type, std::vector<uint32_t>& outRows) const;
+	bool RowContains(uint32_t row, const std::string& token) const;
+	void ScaleFingerprints();
+
+	// nul terminated names, lowerNames shares the offsets
+	std::vector<char> names;
+	std::vector<char> lowerNames;
+	std::vector<uint32_t> nameOffsets{ 0 };  // row count + 1 entries
+
+	std::vector<char> paths;
+	std::vector<uint32_t> pathOffsets{ 0 };
+
+	std::vector<int> ids;
+	std::vector<AssetType> types;
+	std::vector<size_t> sizes;
+	std::vector<int64_t> mtimes;
+
+	// audio header columns, zero for other types
+	std::vector<int64_t> durationsMs;
+	std::vector<int> sampleRates;
+	std::vector<uint8_t> channelCounts;
+	std::vector<uint8_t> codecIds;  // into codecNames, there are only a handful
+	std::vector<std::string> codecNames{ "" };
+
+	// image header columns, zero for other types
+	std::vector<uint32_t> widths;
+	std::vector<uint32_t> heights;
+	std::vector<uint8_t> componentCounts;
+
+	// perceptual hashes back to back, only for the images that have one. hashedRows is ascending
+	std::vector<uint64_t> perceptualHashes;
+	std::vector<uint32_t> hashedRows;
+
+	// audio fingerprints back to back (db::AUDIO_FINGERPRINT_SIZE floats each), already multiplied by
+	// fingerprintScales. fingerprintRows is ascending
+	std::vector<float> fingerprints;
+	std::vector<uint32_t> fingerprintRows;
+	std::vector<float> fingerprintScales = std::vector<float>(db::AUDIO_FINGERPRINT_SIZE, 1.0f);
+};
+
+// remembers the last query and its hits. when the next query can only narrow them down
+// ("lo" -> "loo" -> "loot", or an extra token in match all) only the previous hits are
+// re-checked, anything else (deleted characters, removed tokens, new index) runs a full search
+class IncrementalSearch
+{
+public:
+	void Search(const std::shared_ptr<const SearchIndex>& index, AssetType type,
+		char** tokens, int tokenCount, bool bMatchAll, std::vector<uint32_t>& outRows);
+
+	void Reset();
+
+private:
+	bool IsRefinementOf(const std::vector<std::string>& newTokens, bool bMatchAll) const;
+
+	std::shared_ptr<const SearchIndex> lastIndex;
+	AssetType lastType = AssetType::Unknown;
+	bool bLastMatchAll = true;
+	std::vector<std::string> lastTokens;  // lowercase
+	std::vector<uint32_t> lastRows;
+};
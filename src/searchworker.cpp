@@ -0,0 +1,213 @@
+#include "searchworker.h"
+
+#include <algorithm>
+#include <chrono>
+
+// ranked mode only shows the best matches
+static const size_t FUZZY_MAX_RESULTS = 500;
+static const size_t SIMILAR_MAX_RESULTS = 500;
+
+// the format, size and tag filters of a request, for a single row
+static bool MatchesFilters(const SearchRequest& request, const SearchIndex& index, uint32_t row)
+{
+	return (request.audioFilter.IsEmpty() ||
+			request.audioFilter.Matches(index.GetChannels(row), index.GetSampleRate(row), index.GetDurationMs(row))) &&
+		(request.imageFilter.IsEmpty() ||
+			request.imageFilter.Matches(index.GetWidth(row), index.GetHeight(row), index.GetComponents(row))) &&
+		(!request.tagFilter || request.tagFilter->Matches(index.GetId(row)));
+}
+
+SearchWorker::SearchWorker()
+{
+	thread = std::thread(&SearchWorker::WorkerLoop, this);
+}
+
+SearchWorker::~SearchWorker()
+{
+	Stop();
+}
+
+void SearchWorker::Stop()
+{
+	if (!thread.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bQuit = true;
+		bCancelCurrent = true;
+	}
+	wakeCondition.notify_one();
+	thread.join();
+}
+
+uint32_t SearchWorker::Submit(SearchRequest request)
+{
+	uint32_t generation;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		generation = ++latestGeneration;
+		pendingRequest = std::move(request);
+		pendingGeneration = generation;
+		bHasRequest = true;
+
+		// whatever is running now is stale
+		bCancelCurrent = true;
+	}
+	wakeCondition.notify_one();
+	return generation;
+}
+
+bool SearchWorker::Poll(SearchResult& outResult)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!bHasResult)
+	{
+		return false;
+	}
+
+	bHasResult = false;
+	if (finishedResult.generation != latestGeneration)
+	{
+		return false;
+	}
+
+	outResult = std::move(finishedResult);
+	return true;
+}
+
+void SearchWorker::WorkerLoop()
+{
+	while (true)
+	{
+		SearchRequest request;
+		uint32_t generation;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [this] { return bQuit || bHasRequest; });
+			if (bQuit)
+			{
+				return;
+			}
+
+			request = std::move(pendingRequest);
+			generation = pendingGeneration;
+			bHasRequest = false;
+			bCancelCurrent = false;
+			bBusy = true;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<char*> tokens;
+		for (auto& token : request.tokens)
+		{
+			tokens.push_back(&token[0]);
+		}
+
+		SearchResult result;
+		result.generation = generation;
+		result.index = request.index;
+		result.type = request.type;
+
+		// ranked modes apply the filters (tags included) before they pick their best matches,
+		// filtering those afterwards could leave nothing of a narrow filter
+		const SearchIndex& index = *request.index;
+		const bool bFuzzy = !request.bSimilar && request.bFuzzy && !tokens.empty();
+		const bool bRanked = request.bSimilar || bFuzzy;
+		RowFilter rowFilter;
+		if (!request.audioFilter.IsEmpty() || !request.imageFilter.IsEmpty() || request.tagFilter)
+		{
+			rowFilter = [&request, &index](uint32_t row) { return MatchesFilters(request, index, row); };
+		}
+
+		bool bCompleted = true;
+		if (request.bSimilar)
+		{
+			// the name tokens narrow the candidates down like the other filters, before the closest are picked
+			RowFilter similarFilter = rowFilter;
+			std::vector<uint32_t> nameRows;
+			if (!tokens.empty())
+			{
+				incrementalSearch.Search(request.index, request.type, tokens.data(), (int)tokens.size(), request.bMatchAll, nameRows);
+				similarFilter = [&rowFilter, &nameRows](uint32_t row)
+				{
+					return std::binary_search(nameRows.begin(), nameRows.end(), row) && (!rowFilter || rowFilter(row));
+				};
+			}
+
+			if (request.type == AssetType::Audio)
+			{
+				index.FindSimilarSounds(request.similarFingerprint, SIMILAR_MAX_RESULTS, similarFilter, result.rows);
+			}
+			else
+			{
+				index.FindSimilarImages(request.similarHash, request.maxHashDistance, SIMILAR_MAX_RESULTS, similarFilter, result.rows);
+			}
+		}
+		else if (bFuzzy)
+		{
+			// fuzzy patterns ignore word boundaries
+			std::string pattern;
+			for (const auto& token : request.tokens)
+			{
+				pattern += token;
+			}
+			bCompleted = index.FuzzySearch(request.type, pattern.c_str(), FUZZY_MAX_RESULTS, rowFilter, &bCancelCurrent, result.rows);
+		}
+		else
+		{
+			incrementalSearch.Search(request.index, request.type, tokens.data(), (int)tokens.size(), request.bMatchAll, result.rows);
+		}
+
+		if (bCompleted)
+		{
+			if (!bRanked)
+			{
+				index.FilterAudioFormat(request.audioFilter, result.rows);
+				index.FilterImageSize(request.imageFilter, result.rows);
+				if (request.tagFilter)
+				{
+					const TagFilter& tagFilter = *request.tagFilter;
+					result.rows.erase(std::remove_if(result.rows.begin(), result.rows.end(), [&](uint32_t row)
+						{
+							return !tagFilter.Matches(index.GetId(row));
+						}), result.rows.end());
+				}
+			}
+			// ranked results keep their ranking
+			if (request.bSortByImageSize && !bRanked)
+			{
+				request.index->SortByImageSize(result.rows);
+			}
+		}
+
+		// a linear pass over the results, better here than on the ui thread
+		result.selectedFileId = request.selectedFileId;
+		if (bCompleted && request.selectedFileId >= 0)
+		{
+			for (size_t i = 0; i < result.rows.size(); i++)
+			{
+				if (index.GetId(result.rows[i]) == request.selectedFileId)
+				{
+					result.selectedIndex = (int)i;
+					break;
+				}
+			}
+		}
+
+		result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (bCompleted && generation == latestGeneration)
+			{
+				finishedResult = std::move(result);
+				bHasResult = true;
+			}
+			bBusy = false;
+		}
+	}
+}
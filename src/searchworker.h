@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "searchindex.h"
+#include "tagindex.h"
+
+struct SearchRequest
+{
+	std::shared_ptr<const SearchIndex> index;
+	AssetType type = AssetType::Texture;
+	std::vector<std::string> tokens;
+	bool bMatchAll = true;
+	bool bFuzzy = false;
+	db::AudioFormatFilter audioFilter;  // applied to the name matches
+	db::ImageSizeFilter imageFilter;
+	bool bSortByImageSize = false;
+	std::shared_ptr<const TagFilter> tagFilter;  // null keeps every file
+
+	// "find similar": images within maxHashDistance of the hash, or the sounds closest to the
+	// fingerprint, closest first. the tokens and filters only narrow them down
+	bool bSimilar = false;
+	uint64_t similarHash = 0;
+	int maxHashDistance = 0;
+	std::vector<float> similarFingerprint;
+
+	// file the ui has selected, the worker finds its position in the results. -1 for none
+	int selectedFileId = -1;
+};
+
+struct SearchResult
+{
+	uint32_t generation = 0;
+	std::shared_ptr<const SearchIndex> index;  // rows are only meaningful against this index
+	AssetType type = AssetType::Texture;
+	std::vector<uint32_t> rows;
+	int selectedFileId = -1;  // of the request
+	int selectedIndex = -1;   // into rows, -1 if that file isn't in them
+	double milliseconds = 0.0;
+};
+
+// runs searches on its own thread so a slow query never stalls a frame.
+// every submit bumps a generation counter: requests that weren't picked up yet are replaced,
+// a running fuzzy search is cancelled and results of older generations are dropped
+class SearchWorker
+{
+public:
+	SearchWorker();
+	~SearchWorker();
+
+	// returns the generation of the request
+	uint32_t Submit(SearchRequest request);
+
+	// hands out the result of the latest submit once, false while it is still running
+	bool Poll(SearchResult& outResult);
+
+	bool IsBusy() const { return bBusy; }
+
+	// cancels the running search and joins the thread, before the shared job system goes away
+	void Stop();
+
+private:
+	void WorkerLoop();
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+
+	SearchRequest pendingRequest;
+	uint32_t pendingGeneration = 0;
+	bool bHasRequest = false;
+
+	SearchResult finishedResult;
+	bool bHasResult = false;
+
+	std::atomic<uint32_t> latestGeneration{ 0 };
+	std::atomic<bool> bCancelCurrent{ false };
+	std::atomic<bool> bBusy{ false };
+	bool bQuit = false;
+
+	// worker thread only
+	IncrementalSearch incrementalSearch;
+};
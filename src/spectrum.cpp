@@ -0,0 +1,208 @@
+#include "spectrum.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// lowest band edge, below that is rumble nobody previews
+static const float SPECTRUM_MIN_HZ = 20.0f;
+// how fast bars fall back once the level drops
+static const float SPECTRUM_FALL_DB_PER_SECOND = 60.0f;
+
+static const double PI = 3.14159265358979323846;
+
+RealFft::RealFft(int size)
+	: size(size), half(size / 2)
+{
+	int bits = 0;
+	while ((1 << bits) < half) bits++;
+
+	bitReverse.resize(half);
+	for (int i = 0; i < half; i++)
+	{
+		int reversed = 0;
+		for (int bit = 0; bit < bits; bit++)
+		{
+			reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+		}
+		bitReverse[i] = reversed;
+	}
+
+	// stage by stage, the stage with h butterflies per group reads its h twiddles from offset h - 1
+	twiddleRe.resize(half);
+	twiddleIm.resize(half);
+	for (int halfLength = 1; halfLength < half; halfLength *= 2)
+	{
+		for (int j = 0; j < halfLength; j++)
+		{
+			twiddleRe[halfLength - 1 + j] = (float)cos(-PI * j / halfLength);
+			twiddleIm[halfLength - 1 + j] = (float)sin(-PI * j / halfLength);
+		}
+	}
+
+	splitRe.resize(half + 1);
+	splitIm.resize(half + 1);
+	for (int k = 0; k <= half; k++)
+	{
+		splitRe[k] = (float)cos(-2.0 * PI * k / size);
+		splitIm[k] = (float)sin(-2.0 * PI * k / size);
+	}
+
+	re.resize(half);
+	im.resize(half);
+}
+
+void RealFft::Transform()
+{
+	float* const real = re.data();
+	float* const imag = im.data();
+
+	// the first stage has a single twiddle of 1, no multiplies needed
+	for (int a = 0; a < half; a += 2)
+	{
+		const float tr = real[a + 1];
+		const float ti = imag[a + 1];
+		real[a + 1] = real[a] - tr;
+		imag[a + 1] = imag[a] - ti;
+		real[a] += tr;
+		imag[a] += ti;
+	}
+
+	for (int length = 4; length <= half; length *= 2)
+	{
+		const int halfLength = length / 2;
+		const float* const stageRe = twiddleRe.data() + halfLength - 1;
+		const float* const stageIm = twiddleIm.data() + halfLength - 1;
+		for (int start = 0; start < half; start += length)
+		{
+			float* const lowRe = real + start;
+			float* const lowIm = imag + start;
+			float* const highRe = lowRe + halfLength;
+			float* const highIm = lowIm + halfLength;
+			for (int j = 0; j < halfLength; j++)
+			{
+				const float wr = stageRe[j];
+				const float wi = stageIm[j];
+
+				const float tr = highRe[j] * wr - highIm[j] * wi;
+				const float ti = highRe[j] * wi + highIm[j] * wr;
+				highRe[j] = lowRe[j] - tr;
+				highIm[j] = lowIm[j] - ti;
+				lowRe[j] += tr;
+				lowIm[j] += ti;
+			}
+		}
+	}
+}
+
+void RealFft::PowerSpectrum(const float* input, float* outPower)
+{
+	// even samples as real, odd as imaginary, already in bit reversed order
+	for (int n = 0; n < half; n++)
+	{
+		const int index = bitReverse[n];
+		re[index] = input[2 * n];
+		im[index] = input[2 * n + 1];
+	}
+
+	Transform();
+
+	// untangle the even and odd halves: X[k] = E[k] + e^(-2 pi i k / size) O[k]
+	for (int k = 0; k <= half; k++)
+	{
+		const int a = k == half ? 0 : k;
+		const int b = k == 0 ? 0 : half - k;
+
+		const float evenRe = 0.5f * (re[a] + re[b]);
+		const float evenIm = 0.5f * (im[a] - im[b]);
+		const float oddRe = 0.5f * (im[a] + im[b]);
+		const float oddIm = -0.5f * (re[a] - re[b]);
+
+		const float xr = evenRe + splitRe[k] * oddRe - splitIm[k] * oddIm;
+		const float xi = evenIm + splitRe[k] * oddIm + splitIm[k] * oddRe;
+		outPower[k] = xr * xr + xi * xi;
+	}
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+	: fft(FFT_SIZE)
+{
+	window.resize(FFT_SIZE);
+	windowGain = 0.0f;
+	for (int i = 0; i < FFT_SIZE; i++)
+	{
+		window[i] = (float)(0.5 - 0.5 * cos(2.0 * PI * i / (FFT_SIZE - 1)));
+		windowGain += window[i];
+	}
+
+	history.assign(FFT_SIZE, 0.0f);
+	windowed.resize(FFT_SIZE);
+	power.resize(FFT_SIZE / 2 + 1);
+	bands.assign(BAND_COUNT, FLOOR_DB);
+}
+
+void SpectrumAnalyzer::Push(const float* samples, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (count >= (size_t)FFT_SIZE)
+	{
+		memcpy(history.data(), samples + count - FFT_SIZE, FFT_SIZE * sizeof(float));
+	}
+	else
+	{
+		memmove(history.data(), history.data() + count, (FFT_SIZE - count) * sizeof(float));
+		memcpy(history.data() + FFT_SIZE - count, samples, count * sizeof(float));
+	}
+	bHasNewSamples = true;
+}
+
+void SpectrumAnalyzer::Update(uint32_t sampleRate, float deltaSeconds)
+{
+	const float fall = SPECTRUM_FALL_DB_PER_SECOND * deltaSeconds;
+	if (!bHasNewSamples || sampleRate == 0)
+	{
+		for (float& band : bands)
+		{
+			band = std::max(FLOOR_DB, band - fall);
+		}
+		return;
+	}
+	bHasNewSamples = false;
+
+	for (int i = 0; i < FFT_SIZE; i++)
+	{
+		windowed[i] = history[i] * window[i];
+	}
+	fft.PowerSpectrum(windowed.data(), power.data());
+
+	// equal width on a log axis, every band gets at least the bin its lower edge falls in
+	const float nyquist = sampleRate * 0.5f;
+	const float ratio = powf(nyquist / SPECTRUM_MIN_HZ, 1.0f / BAND_COUNT);
+	const float binsPerHz = (float)FFT_SIZE / sampleRate;
+	const int lastBin = FFT_SIZE / 2;
+
+	float lowHz = SPECTRUM_MIN_HZ;
+	for (int band = 0; band < BAND_COUNT; band++)
+	{
+		const float highHz = lowHz * ratio;
+		const int begin = std::min(lastBin, (int)(lowHz * binsPerHz));
+		const int end = std::min(lastBin + 1, std::max(begin + 1, (int)(highHz * binsPerHz)));
+
+		float peak = 0.0f;
+		for (int bin = begin; bin < end; bin++)
+		{
+			peak = std::max(peak, power[bin]);
+		}
+
+		// a full scale sine reads 0 dB
+		const float amplitude = 2.0f * sqrtf(peak) / windowGain;
+		const float level = amplitude > 0.0f ? std::max(FLOOR_DB, 20.0f * log10f(amplitude)) : FLOOR_DB;
+		bands[band] = std::max(level, bands[band] - fall);
+
+		lowHz = highHz;
+	}
+}
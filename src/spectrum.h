@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// radix-2 fft of real input. a size n transform runs as an n/2 complex transform on the
+// even/odd samples packed as re/im plus one split pass. twiddles and the bit reversal
+// permutation are computed once in the constructor
+class RealFft
+{
+public:
+	// size must be a power of two, at least 4
+	explicit RealFft(int size);
+
+	int GetSize() const { return size; }
+
+	// squared magnitude of bins 0..size/2
+	void PowerSpectrum(const float* input, float* outPower);
+
+private:
+	void Transform();
+
+	int size;
+	int half;
+	std::vector<int> bitReverse;
+	std::vector<float> twiddleRe;  // contiguous per stage so the butterflies vectorize
+	std::vector<float> twiddleIm;
+	std::vector<float> splitRe;    // e^(-2 pi i k / size), k <= half
+	std::vector<float> splitIm;
+	std::vector<float> re;
+	std::vector<float> im;
+};
+
+// turns the most recent samples of the playing sound into a hann windowed spectrum, folded into
+// log spaced bands for drawing, and keeps the same window around for an oscilloscope.
+// main thread only, fed with whatever the audio callback published since the last frame
+class SpectrumAnalyzer
+{
+public:
+	static const int FFT_SIZE = 4096;
+	static const int BAND_COUNT = 64;
+	// bands start at this level and fall back to it when the sound stops
+	static constexpr float FLOOR_DB = -90.0f;
+
+	SpectrumAnalyzer();
+
+	// appends new mono samples, only the last FFT_SIZE are kept
+	void Push(const float* samples, size_t count);
+
+	// recomputes the bands if samples came in, otherwise lets them fall
+	void Update(uint32_t sampleRate, float deltaSeconds);
+
+	const float* GetBands() const { return bands.data(); }
+	// oldest first
+	const float* GetSamples() const { return history.data(); }
+
+private:
+	RealFft fft;
+	std::vector<float> window;
+	float windowGain = 1.0f;
+	std::vector<float> history;
+	std::vector<float> windowed;
+	std::vector<float> power;
+	std::vector<float> bands;
+	bool bHasNewSamples = false;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+// wait free single producer / single consumer ring buffer of trivially copyable items.
+// storage is allocated once up front, Push and Pop only copy and publish an index, so the
+// producer can be a real time thread. a full ring drops what doesn't fit instead of waiting.
+template <typename T>
+class SpscRing
+{
+public:
+	// rounded up to a power of two
+	explicit SpscRing(size_t minCapacity)
+	{
+		size_t capacity = 1;
+		while (capacity < minCapacity) capacity *= 2;
+		items.resize(capacity);
+		mask = capacity - 1;
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// producer thread only, returns how many items were written
+	size_t Push(const T* source, size_t count)
+	{
+		const size_t head = writeIndex.load(std::memory_order_relaxed);
+		const size_t tail = readIndex.load(std::memory_order_acquire);
+		const size_t free = items.size() - (head - tail);
+		if (count > free) count = free;
+
+		const size_t start = head & mask;
+		const size_t first = count < items.size() - start ? count : items.size() - start;
+		memcpy(items.data() + start, source, first * sizeof(T));
+		memcpy(items.data(), source + first, (count - first) * sizeof(T));
+
+		writeIndex.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	// consumer thread only, returns how many items were read
+	size_t Pop(T* destination, size_t maxCount)
+	{
+		const size_t tail = readIndex.load(std::memory_order_relaxed);
+		const size_t head = writeIndex.load(std::memory_order_acquire);
+		size_t count = head - tail;
+		if (count > maxCount) count = maxCount;
+
+		const size_t start = tail & mask;
+		const size_t first = count < items.size() - start ? count : items.size() - start;
+		memcpy(destination, items.data() + start, first * sizeof(T));
+		memcpy(destination + first, items.data(), (count - first) * sizeof(T));
+
+		readIndex.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t GetCapacity() const { return items.size(); }
+
+private:
+	std::vector<T> items;
+	size_t mask = 0;
+
+	// on separate cache lines, each is written by one side and polled by the other
+	alignas(64) std::atomic<size_t> writeIndex{ 0 };
+	alignas(64) std::atomic<size_t> readIndex{ 0 };
+};
@@ -0,0 +1,213 @@
+#include "stringsearch.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STRSEARCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// gcc/clang need the target attribute to emit avx2 outside of -mavx2, msvc doesn't
+#if defined(STRSEARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define STRSEARCH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define STRSEARCH_TARGET_AVX2
+#endif
+
+namespace strsearch {
+
+	using Kernel = void(*)(const char*, size_t, const char*, size_t, MatchCallback, void*);
+
+	static inline int CountTrailingZeros(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (int)index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// checks every position from start, used on its own and for the tail the simd kernels can't load
+	static void FindAllScalar(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData, size_t start)
+	{
+		if (needleLength > haystackLength)
+		{
+			return;
+		}
+
+		const size_t last = haystackLength - needleLength;
+		size_t i = start;
+		while (i <= last)
+		{
+			const void* first = memchr(haystack + i, needle[0], last - i + 1);
+			if (!first)
+			{
+				return;
+			}
+
+			i = (size_t)((const char*)first - haystack);
+			if (memcmp(haystack + i + 1, needle + 1, needleLength - 1) == 0)
+			{
+				i = onMatch(i, userData);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+#ifndef STRSEARCH_X86
+
+	static void FindAllScalarKernel(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData)
+	{
+		FindAllScalar(haystack, haystackLength, needle, needleLength, onMatch, userData, 0);
+	}
+
+#else
+
+	// compares the first and last needle byte against a whole block of candidate positions at once,
+	// only positions where both match get a full memcmp (see "simd-friendly algorithms for substring searching", mula)
+	static void FindAllSse2(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData)
+	{
+		const __m128i first = _mm_set1_epi8(needle[0]);
+		const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+
+		size_t i = 0;
+		while (i + needleLength - 1 + 16 <= haystackLength)
+		{
+			const __m128i blockFirst = _mm_loadu_si128((const __m128i*)(haystack + i));
+			const __m128i blockLast = _mm_loadu_si128((const __m128i*)(haystack + i + needleLength - 1));
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(
+				_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+
+			size_t next = i + 16;
+			while (mask != 0)
+			{
+				const size_t position = i + CountTrailingZeros(mask);
+				if (needleLength <= 2 || memcmp(haystack + position + 1, needle + 1, needleLength - 2) == 0)
+				{
+					next = onMatch(position, userData);
+					break;
+				}
+				mask &= mask - 1;
+			}
+
+			if (next >= haystackLength) return;
+			i = next;
+		}
+
+		FindAllScalar(haystack, haystackLength, needle, needleLength, onMatch, userData, i);
+	}
+
+	STRSEARCH_TARGET_AVX2
+	static void FindAllAvx2(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData)
+	{
+		const __m256i first = _mm256_set1_epi8(needle[0]);
+		const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+
+		size_t i = 0;
+		while (i + needleLength - 1 + 32 <= haystackLength)
+		{
+			const __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(haystack + i));
+			const __m256i blockLast = _mm256_loadu_si256((const __m256i*)(haystack + i + needleLength - 1));
+			unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+				_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+
+			size_t next = i + 32;
+			while (mask != 0)
+			{
+				const size_t position = i + CountTrailingZeros(mask);
+				if (needleLength <= 2 || memcmp(haystack + position + 1, needle + 1, needleLength - 2) == 0)
+				{
+					next = onMatch(position, userData);
+					break;
+				}
+				mask &= mask - 1;
+			}
+
+			if (next >= haystackLength) return;
+			i = next;
+		}
+
+		FindAllScalar(haystack, haystackLength, needle, needleLength, onMatch, userData, i);
+	}
+
+	static bool HasAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		const bool bOsxsave = (info[2] & (1 << 27)) != 0;
+		const bool bAvx = (info[2] & (1 << 28)) != 0;
+		if (!bOsxsave || !bAvx || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+#endif
+
+	struct Dispatch
+	{
+		Kernel kernel;
+		const char* name;
+	};
+
+	static Dispatch SelectKernel()
+	{
+#ifdef STRSEARCH_X86
+		if (HasAvx2()) return { FindAllAvx2, "avx2" };
+		return { FindAllSse2, "sse2" };
+#else
+		return { FindAllScalarKernel, "scalar" };
+#endif
+	}
+
+	static const Dispatch& GetDispatch()
+	{
+		static const Dispatch dispatch = SelectKernel();
+		return dispatch;
+	}
+
+	void FindAll(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData)
+	{
+		if (needleLength == 0 || needleLength > haystackLength)
+		{
+			return;
+		}
+		GetDispatch().kernel(haystack, haystackLength, needle, needleLength, onMatch, userData);
+	}
+
+	ptrdiff_t FindFirst(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+	{
+		ptrdiff_t result = -1;
+		FindAll(haystack, haystackLength, needle, needleLength,
+			[](size_t position, void* userData) -> size_t
+			{
+				*(ptrdiff_t*)userData = (ptrdiff_t)position;
+				return (size_t)-1;
+			},
+			&result);
+		return result;
+	}
+
+	const char* GetKernelName()
+	{
+		return GetDispatch().name;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+// substring search over a haystack that may contain many nul separated strings.
+// calls onMatch(position) for a match and continues from the position it returns,
+// which lets callers skip the rest of a string after its first hit. a return value past
+// the haystack ends the search.
+// picks the widest kernel the cpu supports: avx2, sse2, scalar.
+namespace strsearch {
+
+	using MatchCallback = size_t(*)(size_t position, void* userData);
+
+	void FindAll(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength,
+		MatchCallback onMatch, void* userData);
+
+	// first match or -1
+	ptrdiff_t FindFirst(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength);
+
+	const char* GetKernelName();
+}
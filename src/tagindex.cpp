@@ -0,0 +1,398 @@
+#include "tagindex.h"
+#include "db.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+
+// pending write batches, a producer only waits if the db falls this far behind
+static const size_t TAG_WRITE_QUEUE_CAPACITY = 64;
+
+static std::string ToLowerName(const std::string& name)
+{
+	std::string lower = name;
+	for (char& c : lower)
+	{
+		if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+	}
+	return lower;
+}
+
+static std::vector<uint32_t> ToUnsigned(const std::vector<int>& fileIds)
+{
+	std::vector<uint32_t> ids;
+	ids.reserve(fileIds.size());
+	for (int id : fileIds)
+	{
+		if (id >= 0) ids.push_back((uint32_t)id);
+	}
+	return ids;
+}
+
+TagIndex::TagIndex()
+	: writeQueue(TAG_WRITE_QUEUE_CAPACITY)
+{
+	writerThread = std::thread(&TagIndex::WriterLoop, this);
+}
+
+TagIndex::~TagIndex()
+{
+	// drains what is still queued, tags must not get lost on exit
+	writeQueue.Close();
+	writerThread.join();
+}
+
+void TagIndex::WriterLoop()
+{
+	// creating a tag is a write that may wait behind the scanner, it happens here and not on the main thread
+	std::unordered_map<std::string, int> tagIds;
+
+	PendingWrite write;
+	while (writeQueue.Pop(write))
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		auto it = tagIds.find(write.tagName);
+		if (it == tagIds.end())
+		{
+			const int id = db::GetOrCreateTag(write.tagName);
+			if (id < 0)
+			{
+				printf("[tags]: dropped %d files of [%s], the tag couldn't be created\n", (int)write.fileIds.size(), write.tagName.c_str());
+				continue;
+			}
+			it = tagIds.emplace(write.tagName, id).first;
+		}
+
+		if (write.bRemove) db::UntagFiles(it->second, write.fileIds);
+		else db::TagFiles(it->second, write.fileIds);
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		printf("[tags]: %s %d files in %lld ms\n", write.bRemove ? "untagged" : "tagged",
+			(int)write.fileIds.size(), (long long)elapsed.count());
+	}
+}
+
+void TagIndex::LoadFromDb()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	tags.clear();
+	tagsByName.clear();
+	for (const db::Tag& tag : db::GetTags())
+	{
+		tagsByName[ToLowerName(tag.name)] = tags.size();
+		tags.push_back(TagEntry{ tag.id, ToLowerName(tag.name), IdBitmap() });
+	}
+
+	std::unordered_map<int, size_t> tagsById;
+	for (size_t i = 0; i < tags.size(); i++)
+	{
+		tagsById[tags[i].id] = i;
+	}
+
+	// rows come grouped by tag, collect one tag's files and add them in one go
+	size_t assignments = 0;
+	int currentTagId = -1;
+	std::vector<uint32_t> fileIds;
+	const auto flush = [&]()
+	{
+		const auto it = tagsById.find(currentTagId);
+		if (it != tagsById.end())
+		{
+			tags[it->second].files.AddMany(fileIds);
+		}
+		fileIds.clear();
+	};
+
+	db::VisitFileTags([&](int tagId, int fileId)
+		{
+			if (tagId != currentTagId)
+			{
+				flush();
+				currentTagId = tagId;
+			}
+			fileIds.push_back((uint32_t)fileId);
+			assignments++;
+		});
+	flush();
+
+	size_t bytes = 0;
+	for (const TagEntry& tag : tags)
+	{
+		bytes += tag.files.GetMemoryBytes();
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("[tags]: loaded %d tags, %d assignments in %lld ms (%d kb)\n",
+		(int)tags.size(), (int)assignments, (long long)elapsed.count(), (int)(bytes / 1024));
+}
+
+const TagIndex::TagEntry* TagIndex::FindTag(const std::string& lowerName) const
+{
+	const auto it = tagsByName.find(lowerName);
+	return it != tagsByName.end() ? &tags[it->second] : nullptr;
+}
+
+bool TagIndex::Tag(const std::string& name, const std::vector<int>& fileIds)
+{
+	// the expression parser splits on these and reads and/or/not as operators, such a tag could never be queried
+	const std::string lowerName = ToLowerName(name);
+	if (lowerName.empty() || lowerName.find_first_of(" \t()&|!") != std::string::npos || lowerName[0] == '-' ||
+		lowerName == "and" || lowerName == "or" || lowerName == "not")
+	{
+		printf("[tags]: [%s] isn't a valid tag name\n", name.c_str());
+		return false;
+	}
+
+	auto it = tagsByName.find(lowerName);
+	if (it == tagsByName.end())
+	{
+		it = tagsByName.emplace(lowerName, tags.size()).first;
+		tags.push_back(TagEntry{ -1, lowerName, IdBitmap() });
+	}
+
+	TagEntry& tag = tags[it->second];
+	tag.files.AddMany(ToUnsigned(fileIds));
+	writeQueue.Push(PendingWrite{ tag.name, fileIds, false });
+	return true;
+}
+
+void TagIndex::Untag(const std::string& name, const std::vector<int>& fileIds)
+{
+	const auto it = tagsByName.find(ToLowerName(name));
+	if (it == tagsByName.end())
+	{
+		return;
+	}
+
+	TagEntry& tag = tags[it->second];
+	tag.files.RemoveMany(ToUnsigned(fileIds));
+	writeQueue.Push(PendingWrite{ tag.name, fileIds, true });
+}
+
+void TagIndex::GetFileTags(int fileId, std::vector<std::string>& outNames) const
+{
+	outNames.clear();
+	for (const TagEntry& tag : tags)
+	{
+		if (tag.files.Contains((uint32_t)fileId))
+		{
+			outNames.push_back(tag.name);
+		}
+	}
+	std::sort(outNames.begin(), outNames.end());
+}
+
+namespace {
+
+	// a set or its complement. not only flips the flag, and/or turn complements into
+	// differences (de morgan), so no operation ever needs the set of all files
+	struct Operand
+	{
+		IdBitmap ids;
+		bool bComplement = false;
+	};
+
+	Operand AndOperands(const Operand& a, const Operand& b)
+	{
+		Operand result;
+		if (!a.bComplement && !b.bComplement) result.ids = IdBitmap::And(a.ids, b.ids);
+		else if (!a.bComplement) result.ids = IdBitmap::AndNot(a.ids, b.ids);
+		else if (!b.bComplement) result.ids = IdBitmap::AndNot(b.ids, a.ids);
+		else
+		{
+			result.ids = IdBitmap::Or(a.ids, b.ids);
+			result.bComplement = true;
+		}
+		return result;
+	}
+
+	Operand OrOperands(const Operand& a, const Operand& b)
+	{
+		Operand result;
+		result.bComplement = a.bComplement || b.bComplement;
+		if (!a.bComplement && !b.bComplement) result.ids = IdBitmap::Or(a.ids, b.ids);
+		else if (!a.bComplement) result.ids = IdBitmap::AndNot(b.ids, a.ids);
+		else if (!b.bComplement) result.ids = IdBitmap::AndNot(a.ids, b.ids);
+		else result.ids = IdBitmap::And(a.ids, b.ids);
+		return result;
+	}
+
+	enum class TokenKind
+	{
+		Name,
+		And,
+		Or,
+		Not,
+		Open,
+		Close,
+		End
+	};
+
+	// recursive descent over the expression, one token of lookahead
+	class ExpressionParser
+	{
+	public:
+		using Lookup = std::function<const IdBitmap*(const std::string&)>;
+
+		ExpressionParser(const char* expression, const Lookup& lookup)
+			: text(expression), lookup(lookup)
+		{
+			Advance();
+		}
+
+		bool Parse(Operand& outResult, std::string& outError)
+		{
+			if (kind == TokenKind::End)
+			{
+				outError = "empty expression";
+				return false;
+			}
+
+			outResult = ParseOr();
+			if (!bFailed && kind != TokenKind::End)
+			{
+				Fail(kind == TokenKind::Close ? "unmatched )" : "unexpected term");
+			}
+
+			outError = error;
+			return !bFailed;
+		}
+
+	private:
+		void Advance()
+		{
+			while (*text == ' ' || *text == '\t') text++;
+
+			name.clear();
+			const char c = *text;
+			if (c == '\0') { kind = TokenKind::End; return; }
+			if (c == '(') { kind = TokenKind::Open; text++; return; }
+			if (c == ')') { kind = TokenKind::Close; text++; return; }
+			if (c == '!' || c == '-') { kind = TokenKind::Not; text++; return; }
+			if (c == '&' || c == '|')
+			{
+				kind = c == '&' ? TokenKind::And : TokenKind::Or;
+				text++;
+				if (*text == c) text++;  // && and ||
+				return;
+			}
+
+			while (*text && *text != ' ' && *text != '\t' && *text != '(' && *text != ')' &&
+				*text != '&' && *text != '|' && *text != '!')
+			{
+				const char letter = *text++;
+				name += (letter >= 'A' && letter <= 'Z') ? (char)(letter - 'A' + 'a') : letter;
+			}
+
+			if (name == "and") kind = TokenKind::And;
+			else if (name == "or") kind = TokenKind::Or;
+			else if (name == "not") kind = TokenKind::Not;
+			else kind = TokenKind::Name;
+		}
+
+		void Fail(const char* message)
+		{
+			if (!bFailed)
+			{
+				bFailed = true;
+				error = message;
+			}
+		}
+
+		Operand ParseOr()
+		{
+			Operand result = ParseAnd();
+			while (!bFailed && kind == TokenKind::Or)
+			{
+				Advance();
+				result = OrOperands(result, ParseAnd());
+			}
+			return result;
+		}
+
+		Operand ParseAnd()
+		{
+			Operand result = ParseUnary();
+			while (!bFailed)
+			{
+				if (kind == TokenKind::And)
+				{
+					Advance();
+				}
+				else if (kind != TokenKind::Name && kind != TokenKind::Not && kind != TokenKind::Open)
+				{
+					break;
+				}
+				result = AndOperands(result, ParseUnary());
+			}
+			return result;
+		}
+
+		Operand ParseUnary()
+		{
+			Operand result;
+			switch (kind)
+			{
+			case TokenKind::Not:
+				Advance();
+				result = ParseUnary();
+				result.bComplement = !result.bComplement;
+				break;
+
+			case TokenKind::Open:
+				Advance();
+				result = ParseOr();
+				if (kind != TokenKind::Close)
+				{
+					Fail("missing )");
+					break;
+				}
+				Advance();
+				break;
+
+			case TokenKind::Name:
+				if (const IdBitmap* files = lookup(name))
+				{
+					result.ids = *files;
+				}
+				Advance();
+				break;
+
+			default:
+				Fail("expected a tag");
+				break;
+			}
+			return result;
+		}
+
+		const char* text;
+		const Lookup& lookup;
+		TokenKind kind = TokenKind::End;
+		std::string name;
+		std::string error;
+		bool bFailed = false;
+	};
+}
+
+bool TagIndex::Evaluate(const char* expression, TagFilter& outFilter, std::string& outError) const
+{
+	const ExpressionParser::Lookup lookup = [this](const std::string& lowerName) -> const IdBitmap*
+	{
+		const TagEntry* tag = FindTag(lowerName);
+		return tag ? &tag->files : nullptr;
+	};
+
+	Operand result;
+	ExpressionParser parser(expression, lookup);
+	if (!parser.Parse(result, outError))
+	{
+		return false;
+	}
+
+	outFilter.ids = std::move(result.ids);
+	outFilter.bExclude = result.bComplement;
+	return true;
+}
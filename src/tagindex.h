@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "boundedqueue.h"
+#include "idbitmap.h"
+
+// what a tag expression leaves of the files
+struct TagFilter
+{
+	IdBitmap ids;
+	bool bExclude = false;  // the files NOT in ids, e.g. for "not wip"
+
+	bool Matches(int fileId) const { return ids.Contains((uint32_t)fileId) != bExclude; }
+};
+
+// every tag's files as a compressed bitmap, loaded once from fileTags and kept up to date in
+// memory as files are tagged. tag expressions are answered with bitmap operations only,
+// db writes go to a background thread in submission order. main thread only.
+class TagIndex
+{
+public:
+	TagIndex();
+	~TagIndex();
+
+	TagIndex(const TagIndex&) = delete;
+	TagIndex& operator=(const TagIndex&) = delete;
+
+	// one pass over fileTags
+	void LoadFromDb();
+
+	// names are case insensitive. the bitmap changes right away, the rows (and a new tag) are written behind.
+	// false for names an expression couldn't refer to, e.g. "and" or ones with spaces
+	bool Tag(const std::string& name, const std::vector<int>& fileIds);
+	void Untag(const std::string& name, const std::vector<int>& fileIds);
+
+	// sorted by name
+	void GetFileTags(int fileId, std::vector<std::string>& outNames) const;
+
+	size_t GetTagCount() const { return tags.size(); }
+	const std::string& GetTagName(size_t index) const { return tags[index].name; }
+	size_t GetTagFileCount(size_t index) const { return tags[index].files.GetCardinality(); }
+
+	// "ui and (sfx or music) and not wip". and/or/not also as &, |, ! (or a leading -), adjacent
+	// terms are and-ed, not binds tighter than and, and tighter than or. unknown tags match nothing.
+	// false with a message on syntax errors
+	bool Evaluate(const char* expression, TagFilter& outFilter, std::string& outError) const;
+
+private:
+	struct TagEntry
+	{
+		int id;  // -1 for tags created this session, only the writer thread learns their id
+		std::string name;
+		IdBitmap files;
+	};
+
+	// by name, a tag created on the main thread only gets its row on the writer thread
+	struct PendingWrite
+	{
+		std::string tagName;
+		std::vector<int> fileIds;
+		bool bRemove;
+	};
+
+	// null if there is no such tag
+	const TagEntry* FindTag(const std::string& lowerName) const;
+	void WriterLoop();
+
+	std::vector<TagEntry> tags;
+	std::unordered_map<std::string, size_t> tagsByName;  // lowercase name -> index into tags
+
+	BoundedQueue<PendingWrite> writeQueue;
+	std::thread writerThread;
+};
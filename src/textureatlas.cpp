@@ -0,0 +1,141 @@
+#include "textureatlas.h"
+
+#include <string.h>
+
+// texels of border around every cell
+static const int BORDER = 1;
+
+TextureAtlas::TextureAtlas(int cellSize, int pageSize, int maxPages)
+	: cellSize(cellSize)
+	, cellStride(cellSize + BORDER * 2)
+	, pageSize(pageSize)
+	, cellsPerRow(pageSize / (cellSize + BORDER * 2))
+	, maxPages(maxPages)
+{
+}
+
+bool TextureAtlas::AddPage()
+{
+	if ((int)pages.size() >= maxPages)
+	{
+		return false;
+	}
+
+	Page page;
+	glGenTextures(1, &page.textureId);
+	glBindTexture(GL_TEXTURE_2D, page.textureId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pageSize, pageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	// hand out cells in order, back of the vector is the next one
+	const int cellCount = GetCellsPerPage();
+	page.freeCells.reserve(cellCount);
+	for (int cell = cellCount - 1; cell >= 0; cell--)
+	{
+		page.freeCells.push_back(cell);
+	}
+
+	pages.push_back(std::move(page));
+	return true;
+}
+
+bool TextureAtlas::Allocate(Slot& outSlot)
+{
+	for (int pageIndex = 0; pageIndex < (int)pages.size(); pageIndex++)
+	{
+		Page& page = pages[pageIndex];
+		if (!page.freeCells.empty())
+		{
+			outSlot.page = pageIndex;
+			outSlot.cell = page.freeCells.back();
+			page.freeCells.pop_back();
+			usedCount++;
+			return true;
+		}
+	}
+
+	if (!AddPage())
+	{
+		return false;
+	}
+
+	Page& page = pages.back();
+	outSlot.page = (int)pages.size() - 1;
+	outSlot.cell = page.freeCells.back();
+	page.freeCells.pop_back();
+	usedCount++;
+	return true;
+}
+
+void TextureAtlas::Free(const Slot& slot)
+{
+	if (!slot.IsValid())
+	{
+		return;
+	}
+
+	pages[slot.page].freeCells.push_back(slot.cell);
+	usedCount--;
+}
+
+bool TextureAtlas::Upload(const Slot& slot, const unsigned char* pixels, int width, int height)
+{
+	if (width <= 0 || height <= 0 || width > cellSize || height > cellSize)
+	{
+		return false;
+	}
+
+	// extrude the edges into the border
+	const int paddedWidth = width + BORDER * 2;
+	const int paddedHeight = height + BORDER * 2;
+	borderScratch.resize((size_t)paddedWidth * paddedHeight * 4);
+
+	for (int y = 0; y < paddedHeight; y++)
+	{
+		int sourceY = y - BORDER;
+		if (sourceY < 0) sourceY = 0;
+		if (sourceY >= height) sourceY = height - 1;
+
+		unsigned char* target = &borderScratch[(size_t)y * paddedWidth * 4];
+		const unsigned char* source = pixels + (size_t)sourceY * width * 4;
+
+		memcpy(target, source, 4);
+		memcpy(target + BORDER * 4, source, (size_t)width * 4);
+		memcpy(target + (size_t)(width + BORDER) * 4, source + (size_t)(width - 1) * 4, 4);
+	}
+
+	const int cellX = (slot.cell % cellsPerRow) * cellStride;
+	const int cellY = (slot.cell / cellsPerRow) * cellStride;
+
+	glBindTexture(GL_TEXTURE_2D, pages[slot.page].textureId);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+	glTexSubImage2D(GL_TEXTURE_2D, 0, cellX, cellY, paddedWidth, paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, borderScratch.data());
+	return true;
+}
+
+void TextureAtlas::GetUvs(const Slot& slot, int width, int height, float& outU0, float& outV0, float& outU1, float& outV1) const
+{
+	const float texel = 1.0f / (float)pageSize;
+	const int x = (slot.cell % cellsPerRow) * cellStride + BORDER;
+	const int y = (slot.cell / cellsPerRow) * cellStride + BORDER;
+
+	outU0 = x * texel;
+	outV0 = y * texel;
+	outU1 = (x + width) * texel;
+	outV1 = (y + height) * texel;
+}
+
+void TextureAtlas::Clear()
+{
+	for (auto& page : pages)
+	{
+		glDeleteTextures(1, &page.textureId);
+	}
+	pages.clear();
+	usedCount = 0;
+}
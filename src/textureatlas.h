@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// packs many small rgba images into a few large gl textures so they can be drawn with one
+// texture bind per page. every image gets a fixed size cell, which makes the packer a free list:
+// a freed cell is reused by the next allocation, no fragmentation to manage.
+// cells carry a one texel border copied from the image edge so linear filtering never picks up a neighbour.
+class TextureAtlas
+{
+public:
+	struct Slot
+	{
+		int page = -1;
+		int cell = -1;
+		bool IsValid() const { return page >= 0; }
+	};
+
+	// cellSize is the largest image a cell holds, pages are created on demand up to maxPages
+	TextureAtlas(int cellSize, int pageSize, int maxPages);
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	// false when every cell of every page is taken
+	bool Allocate(Slot& outSlot);
+	void Free(const Slot& slot);
+
+	// gl thread. false if the image doesn't fit a cell
+	bool Upload(const Slot& slot, const unsigned char* pixels, int width, int height);
+
+	// texture and normalized rect of an image of the given size uploaded into slot
+	GLuint GetTexture(const Slot& slot) const { return pages[slot.page].textureId; }
+	void GetUvs(const Slot& slot, int width, int height, float& outU0, float& outV0, float& outU1, float& outV1) const;
+
+	int GetCellsPerPage() const { return cellsPerRow * cellsPerRow; }
+	int GetCapacity() const { return GetCellsPerPage() * maxPages; }
+	int GetUsedCount() const { return usedCount; }
+	int GetPageCount() const { return (int)pages.size(); }
+
+	// deletes every page, call while the gl context is still alive
+	void Clear();
+
+private:
+	struct Page
+	{
+		GLuint textureId = 0;
+		std::vector<int> freeCells;
+	};
+
+	bool AddPage();
+
+	int cellSize;
+	int cellStride;  // cell plus border
+	int pageSize;
+	int cellsPerRow;
+	int maxPages;
+	int usedCount = 0;
+	std::vector<Page> pages;
+	std::vector<unsigned char> borderScratch;
+};
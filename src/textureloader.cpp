@@ -0,0 +1,380 @@
+#include "textureloader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stb_image.h"
+
+#include "jobsystem.h"
+#include "previewbuilder.h"
+#include "scanner.h"
+
+// s3tc formats, not part of core gl
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace
+{
+	bool HasGlExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension && strcmp(extension, name) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct ReadContext
+	{
+		FILE* file;
+		const std::atomic<bool>* bCancelled;
+	};
+
+	// stb reads through these so a cancelled decode stops at the next read instead of finishing the image
+	int ReadCallback(void* user, char* data, int size)
+	{
+		ReadContext* context = (ReadContext*)user;
+		if (*context->bCancelled)
+		{
+			return 0;
+		}
+		return (int)fread(data, 1, size, context->file);
+	}
+
+	void SkipCallback(void* user, int n)
+	{
+		ReadContext* context = (ReadContext*)user;
+		fseek(context->file, n, SEEK_CUR);
+	}
+
+	int EofCallback(void* user)
+	{
+		ReadContext* context = (ReadContext*)user;
+		return *context->bCancelled || feof(context->file);
+	}
+}
+
+unsigned char* DecodeImageFile(const std::string& path, const std::atomic<bool>* bCancelled,
+	int* outWidth, int* outHeight, const char** outFailureReason)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		*outFailureReason = "can't open file";
+		return nullptr;
+	}
+
+	ReadContext context{ file, bCancelled };
+	stbi_io_callbacks callbacks{ ReadCallback, SkipCallback, EofCallback };
+	unsigned char* pixels = stbi_load_from_callbacks(&callbacks, &context, outWidth, outHeight, NULL, 4);
+	fclose(file);
+
+	if (!pixels)
+	{
+		*outFailureReason = stbi_failure_reason();
+	}
+	return pixels;
+}
+
+TextureLoader::TextureLoader(size_t cacheBudgetBytes)
+{
+	stats.budgetBytes = cacheBudgetBytes;
+}
+
+TextureLoader::~TextureLoader()
+{
+	// decode jobs point back at this loader
+	CancelAll();
+	WaitForDecodes();
+}
+
+uint64_t TextureLoader::HashPath(const std::string& path)
+{
+	// fnv-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : path)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+size_t TextureLoader::GetTextureBytes(const db::Preview& preview)
+{
+	return preview.data.size();
+}
+
+const TexturePreview& TextureLoader::Request(const std::string& path)
+{
+	const uint64_t key = HashPath(path);
+
+	// the item view asks every frame, only a new selection counts for the stats and the lru
+	const bool bNewSelection = !bHasLastRequest || key != lastRequestedKey;
+	if (bNewSelection && bHasLastRequest)
+	{
+		// the user moved past the previous selection. a failed entry holds no memory the budget would
+		// ever reclaim, dropping it lets the file be retried the next time it is selected
+		auto previous = entries.find(lastRequestedKey);
+		if (previous != entries.end() && previous->second.preview.state != TextureState::Ready)
+		{
+			if (previous->second.job) previous->second.job->bCancelled = true;
+			Erase(previous);
+		}
+	}
+	lastRequestedKey = key;
+	bHasLastRequest = true;
+
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		if (bNewSelection)
+		{
+			stats.hits++;
+			lru.splice(lru.begin(), lru, it->second.lruIt);
+		}
+		return it->second.preview;
+	}
+
+	stats.misses++;
+
+	Entry& entry = entries[key];
+	lru.push_front(key);
+	entry.lruIt = lru.begin();
+	entry.job = std::make_shared<DecodeJob>();
+	entry.job->key = key;
+	entry.job->path = path;
+	// the gl context is current here, no need for a separate init
+	if (!bCheckedCompressionSupport)
+	{
+		bCompressionSupported = HasGlExtension("GL_EXT_texture_compression_s3tc");
+		bCheckedCompressionSupport = true;
+		printf("[textures]: s3tc compression %s\n", bCompressionSupported ? "supported" : "unsupported, previews stay rgba");
+	}
+	entry.job->bCompress = bCompressionEnabled && bCompressionSupported;
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		decodesInFlight++;
+	}
+	std::shared_ptr<DecodeJob> job = entry.job;
+	JobSystem::GetShared().Submit([this, job]() { Decode(job); });
+
+	return entry.preview;
+}
+
+void TextureLoader::SetCacheBudget(size_t bytes)
+{
+	stats.budgetBytes = bytes;
+	EvictToBudget(lastRequestedKey);
+}
+
+void TextureLoader::Erase(std::unordered_map<uint64_t, Entry>::iterator it)
+{
+	Entry& entry = it->second;
+	if (entry.preview.textureId != 0)
+	{
+		glDeleteTextures(1, &entry.preview.textureId);
+		stats.residentBytes -= entry.bytes;
+		stats.residentCount--;
+	}
+	lru.erase(entry.lruIt);
+	entries.erase(it);
+}
+
+void TextureLoader::EvictToBudget(uint64_t keepKey)
+{
+	// walk from the least recently used end, loading and failed entries hold no memory
+	auto lruIt = lru.end();
+	while (stats.residentBytes > stats.budgetBytes && lruIt != lru.begin())
+	{
+		--lruIt;
+		const uint64_t key = *lruIt;
+		auto it = entries.find(key);
+		if (key == keepKey || it->second.bytes == 0)
+		{
+			continue;
+		}
+
+		// erase invalidates the list iterator, step past it first
+		lruIt = std::next(lruIt);
+		Erase(it);
+		stats.evictions++;
+	}
+}
+
+void TextureLoader::Decode(std::shared_ptr<DecodeJob> job)
+{
+	if (!job->bCancelled)
+	{
+		DecodedImage image;
+		image.job = job;
+
+		// a preview built for this version of the file, in the format we'd build now
+		int64_t mtime = 0;
+		const bool bHasMtime = AssetScanner::GetModifiedTime(job->path.c_str(), mtime);
+		const bool bCached = bHasMtime &&
+			db::GetPreview(job->key, mtime, image.preview) &&
+			(image.preview.format != (int)PreviewFormat::RGBA8) == job->bCompress;
+
+		if (!bCached)
+		{
+			image.preview = db::Preview();
+
+			int width = 0;
+			int height = 0;
+			unsigned char* pixels = DecodeImageFile(job->path, &job->bCancelled, &width, &height, &image.failureReason);
+			if (pixels)
+			{
+				// a cancelled jpeg decode still returns pixels, zero filled past where it stopped. don't build or store those
+				if (!job->bCancelled)
+				{
+					BuildPreview(pixels, width, height, PREVIEW_SIZE, job->bCompress, image.preview);
+					if (bHasMtime)
+					{
+						db::PutPreview(job->key, mtime, image.preview);
+					}
+				}
+				stbi_image_free(pixels);
+			}
+		}
+
+		if (!job->bCancelled)
+		{
+			decodedQueue.Push(std::move(image));
+		}
+	}
+
+	// notify under the lock, the loader may be destroyed as soon as the count hits zero
+	std::lock_guard<std::mutex> lock(decodeMutex);
+	decodesInFlight--;
+	decodeCondition.notify_all();
+}
+
+void TextureLoader::Update(size_t uploadBudgetBytes)
+{
+	decodedQueue.PopAll(pendingUploads);
+
+	size_t uploadedBytes = 0;
+	while (!pendingUploads.empty() && (uploadedBytes == 0 || uploadedBytes < uploadBudgetBytes))
+	{
+		DecodedImage image = std::move(pendingUploads.front());
+		pendingUploads.pop_front();
+
+		// dropped or requested again since the decode started
+		auto it = entries.find(image.job->key);
+		if (it == entries.end() || it->second.job != image.job)
+		{
+			continue;
+		}
+
+		Entry& entry = it->second;
+		entry.job.reset();
+
+		const char* pathCstr = image.job->path.c_str();
+		const db::Preview& preview = image.preview;
+		if (preview.levels == 0)
+		{
+			printf("failed to load image: [%s] (%s)\n", pathCstr, image.failureReason);
+			entry.preview.state = TextureState::Failed;
+			continue;
+		}
+
+		// Create a OpenGL texture identifier
+		GLuint imageTexture;
+		glGenTextures(1, &imageTexture);
+		glBindTexture(GL_TEXTURE_2D, imageTexture);
+
+		// Setup filtering parameters for display, trilinear so minified previews don't alias
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, preview.levels - 1);
+
+		// Upload every mip level
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+		const PreviewFormat format = (PreviewFormat)preview.format;
+		const unsigned char* levelData = preview.data.data();
+		int levelWidth = preview.width;
+		int levelHeight = preview.height;
+		for (int level = 0; level < preview.levels; level++)
+		{
+			const size_t levelSize = GetPreviewLevelSize(format, levelWidth, levelHeight);
+			if (format == PreviewFormat::RGBA8)
+			{
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, levelData);
+			}
+			else
+			{
+				const GLenum internalFormat = format == PreviewFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0, (GLsizei)levelSize, levelData);
+			}
+
+			levelData += levelSize;
+			levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+			levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+		}
+
+		entry.preview.textureId = imageTexture;
+		entry.preview.width = preview.width;
+		entry.preview.height = preview.height;
+		entry.preview.state = TextureState::Ready;
+		entry.bytes = GetTextureBytes(preview);
+		uploadedBytes += entry.bytes;
+
+		stats.residentBytes += entry.bytes;
+		stats.residentCount++;
+		EvictToBudget(image.job->key);
+
+		printf("loaded image: [%s]\n", pathCstr);
+	}
+}
+
+void TextureLoader::Clear()
+{
+	CancelAll();
+	WaitForDecodes();
+
+	decodedQueue.PopAll(pendingUploads);
+	pendingUploads.clear();
+
+	for (auto& it : entries)
+	{
+		if (it.second.preview.textureId != 0)
+		{
+			glDeleteTextures(1, &it.second.preview.textureId);
+		}
+	}
+	entries.clear();
+	lru.clear();
+	bHasLastRequest = false;
+	stats.residentBytes = 0;
+	stats.residentCount = 0;
+}
+
+void TextureLoader::CancelAll()
+{
+	for (auto& it : entries)
+	{
+		if (it.second.job) it.second.job->bCancelled = true;
+	}
+}
+
+void TextureLoader::WaitForDecodes()
+{
+	std::unique_lock<std::mutex> lock(decodeMutex);
+	decodeCondition.wait(lock, [this] { return decodesInFlight == 0; });
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "db.h"
+#include "mpscqueue.h"
+
+enum class TextureState
+{
+	Loading,
+	Ready,
+	Failed
+};
+
+struct TexturePreview
+{
+	int width = 0;
+	int height = 0;
+	GLuint textureId = 0;
+	TextureState state = TextureState::Loading;
+};
+
+// decodes an image file to rgba on the calling thread. raising bCancelled makes stb stop at its
+// next read. returns null and sets outFailureReason on failure, free with stbi_image_free
+unsigned char* DecodeImageFile(const std::string& path, const std::atomic<bool>* bCancelled,
+	int* outWidth, int* outHeight, const char** outFailureReason);
+
+struct TextureCacheStats
+{
+	uint64_t hits = 0;       // selections that found their texture resident (or already loading)
+	uint64_t misses = 0;     // selections that had to decode
+	uint64_t evictions = 0;
+	size_t residentBytes = 0;
+	size_t budgetBytes = 0;
+	int residentCount = 0;
+};
+
+// decodes images on the shared job system and uploads them on the gl thread.
+// the worker shrinks the image to preview size and builds its mip chain (block compressed
+// when the gpu supports it), the result is cached in the previews table for the file's mtime.
+// previews come back through a lock free queue and Update() uploads them within a per frame
+// byte budget, so a big image never stalls a frame on decode.
+// uploaded textures are kept in an lru cache bounded by a byte budget.
+class TextureLoader
+{
+public:
+	// about a 2k rgba image per frame, one image always goes through so nothing starves
+	static const size_t DEFAULT_UPLOAD_BUDGET = 16 * 1024 * 1024;
+	static const size_t DEFAULT_CACHE_BUDGET = 256 * 1024 * 1024;
+	// largest side of level 0, the item view draws previews at 300 px
+	static const int PREVIEW_SIZE = 512;
+
+	explicit TextureLoader(size_t cacheBudgetBytes = DEFAULT_CACHE_BUDGET);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// main thread. starts decoding the first time a path is requested, the entry stays
+	// in Loading until Update() uploaded it. requesting another path cancels the decode
+	// of the previous one if it hasn't finished yet
+	const TexturePreview& Request(const std::string& path);
+
+	// main thread, once per frame
+	void Update(size_t uploadBudgetBytes = DEFAULT_UPLOAD_BUDGET);
+
+	// main thread, evicts right away if the cache is over the new budget
+	void SetCacheBudget(size_t bytes);
+
+	// main thread. bc1/bc3 previews, only takes effect if the gpu supports s3tc.
+	// applies to previews requested from now on
+	void SetCompression(bool bEnabled) { bCompressionEnabled = bEnabled; }
+	bool IsCompressionEnabled() const { return bCompressionEnabled; }
+	bool IsCompressionSupported() const { return bCompressionSupported; }
+
+	const TextureCacheStats& GetStats() const { return stats; }
+
+	// deletes every texture, call while the gl context is still alive
+	void Clear();
+
+	// entries are keyed by path hash, so the cache doesn't keep a copy of every path
+	static uint64_t HashPath(const std::string& path);
+
+	// gpu memory of a preview, every mip level included
+	static size_t GetTextureBytes(const db::Preview& preview);
+
+private:
+	struct DecodeJob
+	{
+		uint64_t key = 0;
+		std::string path;
+		bool bCompress = false;
+		std::atomic<bool> bCancelled{ false };
+	};
+
+	struct DecodedImage
+	{
+		std::shared_ptr<DecodeJob> job;
+		db::Preview preview;  // no levels if decoding failed
+		const char* failureReason = nullptr;
+	};
+
+	struct Entry
+	{
+		TexturePreview preview;
+		std::shared_ptr<DecodeJob> job;  // set while decoding
+		size_t bytes = 0;
+		std::list<uint64_t>::iterator lruIt;
+	};
+
+	void Decode(std::shared_ptr<DecodeJob> job);
+	void Erase(std::unordered_map<uint64_t, Entry>::iterator it);
+	void EvictToBudget(uint64_t keepKey);
+	void CancelAll();
+	void WaitForDecodes();
+
+	std::unordered_map<uint64_t, Entry> entries;
+	std::list<uint64_t> lru;  // most recently requested first
+	uint64_t lastRequestedKey = 0;
+	bool bHasLastRequest = false;
+	TextureCacheStats stats;
+
+	bool bCompressionEnabled = true;
+	bool bCompressionSupported = false;
+	bool bCheckedCompressionSupport = false;
+
+	MpscQueue<DecodedImage> decodedQueue;
+	std::deque<DecodedImage> pendingUploads;  // main thread only
+
+	std::mutex decodeMutex;
+	std::condition_variable decodeCondition;
+	int decodesInFlight = 0;
+};
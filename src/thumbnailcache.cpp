@@ -0,0 +1,237 @@
+#include "thumbnailcache.h"
+
+#include <stdio.h>
+
+#include "stb_image.h"
+
+#include "jobsystem.h"
+#include "previewbuilder.h"
+
+ThumbnailCache::ThumbnailCache(int maxAtlasPages)
+	: atlas(THUMBNAIL_SIZE, ATLAS_PAGE_SIZE, maxAtlasPages)
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+	// load jobs point back at this cache
+	for (auto& it : entries)
+	{
+		if (it.second.job) it.second.job->bCancelled = true;
+	}
+	WaitForLoads();
+}
+
+const ThumbnailSlot& ThumbnailCache::Request(int fileId, int64_t mtime, const char* path)
+{
+	auto it = entries.find(fileId);
+	if (it != entries.end() && it->second.job == nullptr && it->second.slot.state != TextureState::Loading)
+	{
+		// still showing a thumbnail of an older version of the file
+		if (it->second.mtime != mtime)
+		{
+			Erase(it);
+			it = entries.end();
+		}
+	}
+
+	if (it != entries.end())
+	{
+		Entry& entry = it->second;
+		entry.lastRequestFrame = frame;
+		lru.splice(lru.begin(), lru, entry.lruIt);
+		return entry.slot;
+	}
+
+	Entry& entry = entries[fileId];
+	entry.mtime = mtime;
+	entry.lastRequestFrame = frame;
+	lru.push_front(fileId);
+	entry.lruIt = lru.begin();
+
+	entry.job = std::make_shared<LoadJob>();
+	entry.job->fileId = fileId;
+	entry.job->mtime = mtime;
+	entry.job->path = path;
+
+	{
+		std::lock_guard<std::mutex> lock(loadMutex);
+		loadsInFlight++;
+	}
+	std::shared_ptr<LoadJob> job = entry.job;
+	JobSystem::GetShared().Submit([this, job]() { Load(job); });
+
+	return entry.slot;
+}
+
+void ThumbnailCache::Load(std::shared_ptr<LoadJob> job)
+{
+	if (!job->bCancelled)
+	{
+		LoadedThumbnail loaded;
+		loaded.job = job;
+
+		// cached thumbnails are a single small row read, only the first view of a file decodes the source
+		if (!db::GetThumbnail(job->fileId, job->mtime, loaded.thumbnail))
+		{
+			int width = 0;
+			int height = 0;
+			const char* failureReason = nullptr;
+			unsigned char* pixels = DecodeImageFile(job->path, &job->bCancelled, &width, &height, &failureReason);
+			if (pixels)
+			{
+				// a jpeg cut short by the cancel still decodes, zero filled past the point it stopped.
+				// only a decode that ran to the end is stored
+				if (!job->bCancelled)
+				{
+					Downscale(pixels, width, height, THUMBNAIL_SIZE, loaded.thumbnail);
+					db::PutThumbnail(job->fileId, job->mtime, loaded.thumbnail);
+				}
+				stbi_image_free(pixels);
+			}
+			else if (!job->bCancelled)
+			{
+				// remembered as an empty thumbnail, the next session doesn't decode it again
+				printf("[thumbnails]: failed to load [%s] (%s)\n", job->path.c_str(), failureReason);
+				db::PutThumbnail(job->fileId, job->mtime, loaded.thumbnail);
+			}
+		}
+
+		if (!job->bCancelled)
+		{
+			loadedQueue.Push(std::move(loaded));
+		}
+	}
+
+	// notify under the lock, the cache may be destroyed as soon as the count hits zero
+	std::lock_guard<std::mutex> lock(loadMutex);
+	loadsInFlight--;
+	loadCondition.notify_all();
+}
+
+void ThumbnailCache::Update(int maxUploads)
+{
+	// cells that weren't drawn last frame scrolled out of view, don't load them.
+	// failed entries hold no atlas slot EvictOne could reclaim, they go as soon as they are off screen.
+	// showing them again is a single row read of the stored failure
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		auto next = std::next(it);
+		if (it->second.lastRequestFrame != frame)
+		{
+			if (it->second.job)
+			{
+				it->second.job->bCancelled = true;
+				Erase(it);
+			}
+			else if (it->second.slot.state == TextureState::Failed)
+			{
+				Erase(it);
+			}
+		}
+		it = next;
+	}
+
+	loadedQueue.PopAll(pendingUploads);
+
+	int uploads = 0;
+	while (!pendingUploads.empty() && uploads < maxUploads)
+	{
+		LoadedThumbnail loaded = std::move(pendingUploads.front());
+		pendingUploads.pop_front();
+
+		auto it = entries.find(loaded.job->fileId);
+		if (it == entries.end() || it->second.job != loaded.job)
+		{
+			continue;
+		}
+
+		Entry& entry = it->second;
+		entry.job.reset();
+
+		const db::Thumbnail& thumbnail = loaded.thumbnail;
+		if (thumbnail.pixels.empty())
+		{
+			entry.slot.state = TextureState::Failed;
+			continue;
+		}
+
+		// a full atlas makes room by dropping the least recently requested thumbnail
+		if (!atlas.Allocate(entry.atlasSlot) && !(EvictOne() && atlas.Allocate(entry.atlasSlot)))
+		{
+			// everything resident is on screen, try again next frame
+			entry.job = loaded.job;
+			pendingUploads.push_front(std::move(loaded));
+			break;
+		}
+
+		if (!atlas.Upload(entry.atlasSlot, thumbnail.pixels.data(), thumbnail.width, thumbnail.height))
+		{
+			atlas.Free(entry.atlasSlot);
+			entry.atlasSlot = TextureAtlas::Slot();
+			entry.slot.state = TextureState::Failed;
+			continue;
+		}
+
+		entry.slot.textureId = atlas.GetTexture(entry.atlasSlot);
+		atlas.GetUvs(entry.atlasSlot, thumbnail.width, thumbnail.height,
+			entry.slot.u0, entry.slot.v0, entry.slot.u1, entry.slot.v1);
+		entry.slot.width = thumbnail.width;
+		entry.slot.height = thumbnail.height;
+		entry.slot.state = TextureState::Ready;
+		uploads++;
+	}
+
+	frame++;
+}
+
+void ThumbnailCache::Clear()
+{
+	for (auto& it : entries)
+	{
+		if (it.second.job) it.second.job->bCancelled = true;
+	}
+	WaitForLoads();
+
+	loadedQueue.PopAll(pendingUploads);
+	pendingUploads.clear();
+
+	atlas.Clear();
+	entries.clear();
+	lru.clear();
+}
+
+void ThumbnailCache::Downscale(const unsigned char* pixels, int width, int height, int maxSize, db::Thumbnail& outThumbnail)
+{
+	FitImageSize(width, height, maxSize, outThumbnail.width, outThumbnail.height);
+	DownscaleImage(pixels, width, height, outThumbnail.width, outThumbnail.height, outThumbnail.pixels);
+}
+
+void ThumbnailCache::Erase(std::unordered_map<int, Entry>::iterator it)
+{
+	Entry& entry = it->second;
+	atlas.Free(entry.atlasSlot);
+	lru.erase(entry.lruIt);
+	entries.erase(it);
+}
+
+bool ThumbnailCache::EvictOne()
+{
+	// from the least recently requested end, never what is on screen right now
+	for (auto lruIt = lru.rbegin(); lruIt != lru.rend(); ++lruIt)
+	{
+		auto it = entries.find(*lruIt);
+		if (it->second.lastRequestFrame != frame && it->second.atlasSlot.IsValid())
+		{
+			Erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThumbnailCache::WaitForLoads()
+{
+	std::unique_lock<std::mutex> lock(loadMutex);
+	loadCondition.wait(lock, [this] { return loadsInFlight == 0; });
+}
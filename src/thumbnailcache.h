@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "db.h"
+#include "mpscqueue.h"
+#include "textureatlas.h"
+#include "textureloader.h"
+
+struct ThumbnailSlot
+{
+	int width = 0;
+	int height = 0;
+	GLuint textureId = 0;  // atlas page, shared with other thumbnails
+	float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+	TextureState state = TextureState::Loading;
+};
+
+// small previews for the grid view. a thumbnail is read from the thumbnails table when one
+// exists for the file's mtime, otherwise the source is decoded and downscaled once on the shared
+// job system and written back. loads for cells that scrolled out of view are cancelled and the
+// resident thumbnails live in a few atlas pages, a full atlas evicts the least recently requested one.
+class ThumbnailCache
+{
+public:
+	static const int THUMBNAIL_SIZE = 64;
+	static const int ATLAS_PAGE_SIZE = 2048;
+	static const int DEFAULT_ATLAS_PAGES = 4;  // 3844 thumbnails, 64 mb
+	static const int DEFAULT_UPLOADS_PER_FRAME = 64;
+
+	explicit ThumbnailCache(int maxAtlasPages = DEFAULT_ATLAS_PAGES);
+	~ThumbnailCache();
+
+	ThumbnailCache(const ThumbnailCache&) = delete;
+	ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+	// main thread, call for every visible cell every frame.
+	// a cell that isn't requested for a frame has its pending load cancelled
+	const ThumbnailSlot& Request(int fileId, int64_t mtime, const char* path);
+
+	// main thread, once per frame before the cells are drawn
+	void Update(int maxUploads = DEFAULT_UPLOADS_PER_FRAME);
+
+	// deletes every texture, call while the gl context is still alive
+	void Clear();
+
+	// fits rgba pixels into maxSize, keeping the aspect ratio. never upscales
+	static void Downscale(const unsigned char* pixels, int width, int height, int maxSize, db::Thumbnail& outThumbnail);
+
+private:
+	struct LoadJob
+	{
+		int fileId = -1;
+		int64_t mtime = 0;
+		std::string path;
+		std::atomic<bool> bCancelled{ false };
+	};
+
+	struct LoadedThumbnail
+	{
+		std::shared_ptr<LoadJob> job;
+		db::Thumbnail thumbnail;  // empty if loading failed
+	};
+
+	struct Entry
+	{
+		ThumbnailSlot slot;
+		std::shared_ptr<LoadJob> job;  // set while loading
+		int64_t mtime = 0;
+		uint64_t lastRequestFrame = 0;
+		std::list<int>::iterator lruIt;
+		TextureAtlas::Slot atlasSlot;
+	};
+
+	void Load(std::shared_ptr<LoadJob> job);
+	void Erase(std::unordered_map<int, Entry>::iterator it);
+	bool EvictOne();
+	void WaitForLoads();
+
+	std::unordered_map<int, Entry> entries;  // keyed by file id
+	std::list<int> lru;  // most recently requested first
+	TextureAtlas atlas;
+	uint64_t frame = 1;
+
+	MpscQueue<LoadedThumbnail> loadedQueue;
+	std::deque<LoadedThumbnail> pendingUploads;  // main thread only
+
+	std::mutex loadMutex;
+	std::condition_variable loadCondition;
+	int loadsInFlight = 0;
+};
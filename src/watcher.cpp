@@ -0,0 +1,383 @@
+#include "watcher.h"
+#include "scanner.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+#ifdef __linux__
+
+// a burst is flushed once no event arrived for this long...
+static const int WATCH_QUIET_MS = 150;
+// ...or when it has been going on for this long
+static const int WATCH_MAX_DELAY_MS = 1000;
+
+static const uint32_t WATCH_MASK =
+	IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+bool FileWatcher::Start(const std::vector<std::string>& roots)
+{
+	if (bRunning)
+	{
+		return true;
+	}
+
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0)
+	{
+		printf("[watcher]: inotify_init1 failed: %s\n", strerror(errno));
+		return false;
+	}
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	// registering the watches means a syscall per directory, that happens on the watcher thread
+	bRunning = true;
+	bStopping = false;
+	thread = std::thread(&FileWatcher::WatcherLoop, this, roots);
+	return true;
+}
+
+void FileWatcher::AddWatches(const std::vector<std::string>& roots)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// the scanner already recorded every directory below the roots
+	std::unordered_set<std::string> rootSet(roots.begin(), roots.end());
+	for (const auto& directory : db::GetDirectories())
+	{
+		if (bStopping)
+		{
+			return;
+		}
+		AddWatch(directory.path);
+		rootSet.erase(directory.path);
+	}
+	for (const auto& root : rootSet)
+	{
+		AddWatchRecursive(root);
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("[watcher]: watching %d directories (%lld ms)\n", (int)watchedPaths.size(), (long long)elapsed.count());
+}
+
+void FileWatcher::Stop()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bStopping = true;
+	const uint64_t one = 1;
+	if (write(wakeFd, &one, sizeof(one)) < 0)
+	{
+		printf("[watcher]: failed to wake watcher thread\n");
+	}
+	thread.join();
+
+	close(inotifyFd);
+	close(wakeFd);
+	inotifyFd = -1;
+	wakeFd = -1;
+	watchedPaths.clear();
+	bRunning = false;
+}
+
+void FileWatcher::AddWatch(const std::string& path)
+{
+	const int wd = inotify_add_watch(inotifyFd, path.c_str(), WATCH_MASK);
+	if (wd < 0)
+	{
+		if (errno == ENOSPC)
+		{
+			printf("[watcher]: out of inotify watches, raise fs.inotify.max_user_watches\n");
+		}
+		return;
+	}
+	watchedPaths[wd] = path;
+}
+
+void FileWatcher::AddWatchRecursive(const std::string& path)
+{
+	if (bStopping)
+	{
+		return;
+	}
+	AddWatch(path);
+
+	cf_dir_t dir;
+	if (!cf_dir_open(&dir, path.c_str()))
+	{
+		return;
+	}
+
+	while (dir.has_next)
+	{
+		cf_file_t rawfile;
+		cf_read_file(&dir, &rawfile);
+
+		if (rawfile.is_dir && rawfile.name[0] != '.')
+		{
+			AddWatchRecursive(path + "/" + rawfile.name);
+		}
+		else if (rawfile.is_reg && AssetScanner::GetFileType(rawfile.ext))
+		{
+			// files created before the watch existed
+			dirtyFiles.insert(rawfile.path);
+		}
+
+		cf_dir_next(&dir);
+	}
+	cf_dir_close(&dir);
+}
+
+void FileWatcher::WatcherLoop(std::vector<std::string> roots)
+{
+	using clock = std::chrono::steady_clock;
+
+	// events that arrive meanwhile wait in the inotify queue
+	AddWatches(roots);
+
+	// one connection with its statements prepared for as long as the watcher runs, flushes only begin a transaction
+	db::BulkWriter writer;
+
+	clock::time_point burstStart;
+	clock::time_point lastEvent;
+	bool bBurst = false;
+
+	while (true)
+	{
+		int timeoutMs = -1;
+		if (bBurst)
+		{
+			const auto now = clock::now();
+			const int sinceLast = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - lastEvent).count();
+			const int sinceStart = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - burstStart).count();
+			timeoutMs = std::max(0, std::min(WATCH_QUIET_MS - sinceLast, WATCH_MAX_DELAY_MS - sinceStart));
+		}
+
+		pollfd fds[2] = {
+			{ inotifyFd, POLLIN, 0 },
+			{ wakeFd, POLLIN, 0 },
+		};
+		const int ready = poll(fds, 2, timeoutMs);
+		if (ready < 0 && errno != EINTR)
+		{
+			printf("[watcher]: poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			ReadEvents();
+
+			lastEvent = clock::now();
+			if (!bBurst)
+			{
+				bBurst = true;
+				burstStart = lastEvent;
+			}
+			continue;
+		}
+
+		// timed out, the burst is over (or has been going on for too long)
+		if (bBurst)
+		{
+			Flush(writer);
+			bBurst = false;
+		}
+	}
+
+	Flush(writer);
+}
+
+void FileWatcher::ReadEvents()
+{
+	alignas(inotify_event) char buffer[64 * 1024];
+
+	while (true)
+	{
+		const ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			return;
+		}
+
+		for (char* cursor = buffer; cursor < buffer + length;)
+		{
+			const inotify_event* event = (const inotify_event*)cursor;
+			cursor += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				printf("[watcher]: event queue overflowed, requesting rescan\n");
+				bRescanRequested = true;
+				continue;
+			}
+
+			if (event->mask & IN_IGNORED)
+			{
+				watchedPaths.erase(event->wd);
+				continue;
+			}
+
+			const auto it = watchedPaths.find(event->wd);
+			if (it == watchedPaths.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			const std::string path = it->second + "/" + event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->name[0] != '.')
+				{
+					dirtyDirectories.insert(path);
+				}
+			}
+			else
+			{
+				if (AssetScanner::GetFileType(AssetScanner::GetExtension(event->name).c_str()))
+				{
+					dirtyFiles.insert(path);
+				}
+			}
+		}
+	}
+}
+
+void FileWatcher::Flush(db::BulkWriter& writer)
+{
+	if (dirtyFiles.empty() && dirtyDirectories.empty())
+	{
+		return;
+	}
+
+	db::ScanChanges changes;
+
+	// gone directories drop their whole subtree and their watches. a directory moved inside the
+	// watched tree keeps its watch descriptor, so this has to happen before the new path is watched
+	for (const auto& path : dirtyDirectories)
+	{
+		int64_t mtime;
+		if (AssetScanner::GetModifiedTime(path.c_str(), mtime))
+		{
+			continue;
+		}
+
+		changes.removedDirectories.push_back(path);
+
+		const std::string prefix = path + "/";
+		for (auto it = watchedPaths.begin(); it != watchedPaths.end();)
+		{
+			if (it->second == path || it->second.compare(0, prefix.size(), prefix) == 0)
+			{
+				inotify_rm_watch(inotifyFd, it->first);
+				it = watchedPaths.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	// new directories get watched and walked
+	for (const auto& path : dirtyDirectories)
+	{
+		int64_t mtime;
+		if (AssetScanner::GetModifiedTime(path.c_str(), mtime))
+		{
+			AddWatchRecursive(path);
+		}
+	}
+
+	// existing paths are upserted by path, only the ones that went away need their id
+	std::vector<std::string> missingPaths;
+
+	for (const auto& path : dirtyFiles)
+	{
+		cf_file_t rawfile;
+		memset(&rawfile, 0, sizeof(rawfile));
+
+		const size_t slash = path.rfind('/');
+		const std::string name = slash != std::string::npos ? path.substr(slash + 1) : path;
+		const std::string ext = AssetScanner::GetExtension(name);
+		const char* type = AssetScanner::GetFileType(ext.c_str());
+
+		int64_t mtime;
+		size_t size;
+		if (!type || !AssetScanner::GetFileStats(path.c_str(), mtime, size))
+		{
+			missingPaths.push_back(path);
+			continue;
+		}
+
+		strncpy(rawfile.path, path.c_str(), sizeof(rawfile.path) - 1);
+		strncpy(rawfile.name, name.c_str(), sizeof(rawfile.name) - 1);
+		strncpy(rawfile.ext, ext.c_str(), sizeof(rawfile.ext) - 1);
+		rawfile.size = size;
+
+		db::File file(rawfile);
+		file.type = type;
+		file.mtime = mtime;
+		AssetScanner::ReadHeader(file);
+		changes.upserts.push_back(std::move(file));
+	}
+
+	for (const auto& entry : db::GetFileIds(missingPaths))
+	{
+		changes.removedFileIds.push_back(entry.second);
+	}
+
+	dirtyFiles.clear();
+	dirtyDirectories.clear();
+
+	if (!changes.empty())
+	{
+		writer.ApplyScanChanges(changes);
+		bDirty = true;
+
+		printf("[watcher]: %d upserted, %d removed, %d directories removed\n",
+			(int)changes.upserts.size(), (int)changes.removedFileIds.size(), (int)changes.removedDirectories.size());
+	}
+}
+
+#else
+
+bool FileWatcher::Start(const std::vector<std::string>& roots)
+{
+	(void)roots;
+	printf("[watcher]: live file watching is not supported on this platform\n");
+	return false;
+}
+
+void FileWatcher::Stop()
+{
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "db.h"
+
+// keeps the files table in sync with the scan roots while the app is open.
+// events are coalesced per path and applied in batches once the burst quiets down,
+// so a 10k file checkout turns into a handful of transactions instead of 10k.
+// inotify only for now, other platforms fall back to rescanning on startup.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	// watches every directory below roots, directories already known to the db are watched without a walk.
+	// the watches are registered on the watcher thread, returns right away
+	bool Start(const std::vector<std::string>& roots);
+	void Stop();
+
+	bool IsRunning() const { return bRunning; }
+
+	// true once after changes were committed to the db since the last call
+	bool ConsumeDirty() { return bDirty.exchange(false); }
+
+	// true once when events were dropped by the kernel and a full rescan is needed
+	bool ConsumeRescanRequest() { return bRescanRequested.exchange(false); }
+
+private:
+	void WatcherLoop(std::vector<std::string> roots);
+	void AddWatches(const std::vector<std::string>& roots);
+	void AddWatch(const std::string& path);
+	void AddWatchRecursive(const std::string& path);
+	void ReadEvents();
+	void Flush(db::BulkWriter& writer);
+
+	int inotifyFd = -1;
+	int wakeFd = -1;
+	std::thread thread;
+
+	// only touched by the watcher thread once running
+	std::unordered_map<int, std::string> watchedPaths;  // watch descriptor -> directory
+	std::unordered_set<std::string> dirtyFiles;        // created, written, moved or deleted
+	std::unordered_set<std::string> dirtyDirectories;  // created, moved or deleted
+
+	std::atomic<bool> bDirty{ false };
+	std::atomic<bool> bRescanRequested{ false };
+	std::atomic<bool> bStopping{ false };  // cuts the initial watch registration short
+	bool bRunning = false;
+};
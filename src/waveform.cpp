@@ -0,0 +1,314 @@
+#include "waveform.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <memory>
+
+#include "audiofingerprint.h"
+#include "miniaudio.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVEFORM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// frames per decoder read
+static const uint64_t ANALYSIS_CHUNK_FRAMES = 4096;
+
+void ReduceSamplesScalar(const float* samples, size_t count, float& inOutMin, float& inOutMax, double& inOutSumSquares)
+{
+	float minValue = inOutMin;
+	float maxValue = inOutMax;
+	float sumSquares = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		const float sample = samples[i];
+		minValue = std::min(minValue, sample);
+		maxValue = std::max(maxValue, sample);
+		sumSquares += sample * sample;
+	}
+
+	inOutMin = minValue;
+	inOutMax = maxValue;
+	inOutSumSquares += sumSquares;
+}
+
+#ifdef WAVEFORM_SSE2
+
+static inline float HorizontalMin(__m128 value)
+{
+	value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+	value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(value);
+}
+
+static inline float HorizontalMax(__m128 value)
+{
+	value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+	value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(value);
+}
+
+static inline float HorizontalSum(__m128 value)
+{
+	value = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+	value = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(value);
+}
+
+void ReduceSamples(const float* samples, size_t count, float& inOutMin, float& inOutMax, double& inOutSumSquares)
+{
+	size_t i = 0;
+	if (count >= 8)
+	{
+		// two sets of accumulators so consecutive loads don't wait on each other
+		__m128 min0 = _mm_set1_ps(inOutMin);
+		__m128 max0 = _mm_set1_ps(inOutMax);
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 min1 = min0;
+		__m128 max1 = max0;
+		__m128 sum1 = sum0;
+
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128 a = _mm_loadu_ps(samples + i);
+			const __m128 b = _mm_loadu_ps(samples + i + 4);
+			min0 = _mm_min_ps(min0, a);
+			max0 = _mm_max_ps(max0, a);
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(a, a));
+			min1 = _mm_min_ps(min1, b);
+			max1 = _mm_max_ps(max1, b);
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(b, b));
+		}
+
+		inOutMin = HorizontalMin(_mm_min_ps(min0, min1));
+		inOutMax = HorizontalMax(_mm_max_ps(max0, max1));
+		inOutSumSquares += HorizontalSum(_mm_add_ps(sum0, sum1));
+	}
+
+	ReduceSamplesScalar(samples + i, count - i, inOutMin, inOutMax, inOutSumSquares);
+}
+
+const char* GetReduceKernelName()
+{
+	return "sse2";
+}
+
+#else
+
+void ReduceSamples(const float* samples, size_t count, float& inOutMin, float& inOutMax, double& inOutSumSquares)
+{
+	ReduceSamplesScalar(samples, count, inOutMin, inOutMax, inOutSumSquares);
+}
+
+const char* GetReduceKernelName()
+{
+	return "scalar";
+}
+
+#endif
+
+static inline int8_t QuantizePeak(float value)
+{
+	return (int8_t)lroundf(std::min(1.0f, std::max(-1.0f, value)) * 127.0f);
+}
+
+static inline float ToDecibels(double amplitude)
+{
+	if (amplitude <= 0.0)
+	{
+		return SILENCE_DB;
+	}
+	return std::max(SILENCE_DB, (float)(20.0 * log10(amplitude)));
+}
+
+WaveformBuilder::WaveformBuilder(uint32_t channels)
+	: channels(channels), blockMin(FLT_MAX), blockMax(-FLT_MAX), totalMin(FLT_MAX), totalMax(-FLT_MAX)
+{
+	blockMins.reserve(2 * WAVEFORM_BUCKETS);
+	blockMaxs.reserve(2 * WAVEFORM_BUCKETS);
+}
+
+void WaveformBuilder::Add(const float* frames, size_t frameCount)
+{
+	while (frameCount > 0)
+	{
+		const uint64_t take = std::min((uint64_t)frameCount, framesPerBlock - framesInBlock);
+		ReduceSamples(frames, (size_t)take * channels, blockMin, blockMax, sumSquares);
+
+		frames += take * channels;
+		frameCount -= (size_t)take;
+		framesInBlock += take;
+		totalFrames += take;
+
+		if (framesInBlock == framesPerBlock)
+		{
+			PushBlock();
+		}
+	}
+}
+
+void WaveformBuilder::PushBlock()
+{
+	blockMins.push_back(blockMin);
+	blockMaxs.push_back(blockMax);
+	totalMin = std::min(totalMin, blockMin);
+	totalMax = std::max(totalMax, blockMax);
+
+	blockMin = FLT_MAX;
+	blockMax = -FLT_MAX;
+	framesInBlock = 0;
+
+	// twice the resolution we store, halve it
+	if (blockMins.size() == 2 * WAVEFORM_BUCKETS)
+	{
+		for (size_t i = 0; i < WAVEFORM_BUCKETS; i++)
+		{
+			blockMins[i] = std::min(blockMins[2 * i], blockMins[2 * i + 1]);
+			blockMaxs[i] = std::max(blockMaxs[2 * i], blockMaxs[2 * i + 1]);
+		}
+		blockMins.resize(WAVEFORM_BUCKETS);
+		blockMaxs.resize(WAVEFORM_BUCKETS);
+		framesPerBlock *= 2;
+	}
+}
+
+void WaveformBuilder::Finish(uint32_t sampleRate, db::Waveform& outWaveform)
+{
+	if (framesInBlock > 0)
+	{
+		PushBlock();
+	}
+
+	outWaveform.sampleRate = sampleRate;
+	outWaveform.channels = channels;
+	outWaveform.lengthFrames = totalFrames;
+
+	const uint64_t sampleCount = totalFrames * channels;
+	outWaveform.rmsDb = sampleCount > 0 ? ToDecibels(sqrt(sumSquares / (double)sampleCount)) : SILENCE_DB;
+	outWaveform.peakDb = totalFrames > 0 ? ToDecibels(std::max(fabsf(totalMin), fabsf(totalMax))) : SILENCE_DB;
+
+	outWaveform.baseBuckets = WAVEFORM_BUCKETS;
+	outWaveform.levels = 0;
+	size_t peakCount = 0;
+	for (int buckets = WAVEFORM_BUCKETS; buckets >= 1; buckets /= 2)
+	{
+		outWaveform.levels++;
+		peakCount += 2 * buckets;
+	}
+	outWaveform.peaks.assign(peakCount, 0);
+
+	// finest level, every bucket takes the blocks it overlaps. sounds shorter than the bucket count repeat frames
+	int8_t* level = outWaveform.peaks.data();
+	const size_t blockCount = blockMins.size();
+	if (blockCount > 0)
+	{
+		for (size_t bucket = 0; bucket < WAVEFORM_BUCKETS; bucket++)
+		{
+			const size_t begin = bucket * blockCount / WAVEFORM_BUCKETS;
+			const size_t end = std::max(begin + 1, (bucket + 1) * blockCount / WAVEFORM_BUCKETS);
+
+			float minValue = blockMins[begin];
+			float maxValue = blockMaxs[begin];
+			for (size_t block = begin + 1; block < end; block++)
+			{
+				minValue = std::min(minValue, blockMins[block]);
+				maxValue = std::max(maxValue, blockMaxs[block]);
+			}
+			level[2 * bucket] = QuantizePeak(minValue);
+			level[2 * bucket + 1] = QuantizePeak(maxValue);
+		}
+	}
+
+	// the rest of the pyramid from the quantized level above, min/max commute with quantization
+	for (int buckets = WAVEFORM_BUCKETS / 2; buckets >= 1; buckets /= 2)
+	{
+		int8_t* next = level + 4 * buckets;
+		for (int bucket = 0; bucket < buckets; bucket++)
+		{
+			next[2 * bucket] = std::min(level[4 * bucket], level[4 * bucket + 2]);
+			next[2 * bucket + 1] = std::max(level[4 * bucket + 1], level[4 * bucket + 3]);
+		}
+		level = next;
+	}
+}
+
+bool AnalyzeAudioFile(const std::string& path, const std::atomic<bool>* bCancelled, db::Waveform& outWaveform,
+	std::vector<float>* outFingerprint)
+{
+	// native format, nothing is gained by converting for a summary
+	ma_decoder decoder;
+	ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+	if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS)
+	{
+		return false;
+	}
+
+	const uint32_t channels = decoder.outputChannels;
+	const uint32_t sampleRate = decoder.outputSampleRate;
+	if (channels == 0)
+	{
+		ma_decoder_uninit(&decoder);
+		return false;
+	}
+
+	WaveformBuilder builder(channels);
+	std::unique_ptr<FingerprintBuilder> fingerprintBuilder;
+	if (outFingerprint)
+	{
+		fingerprintBuilder = std::make_unique<FingerprintBuilder>(channels, sampleRate);
+	}
+	std::vector<float> chunk((size_t)ANALYSIS_CHUNK_FRAMES * channels);
+
+	bool bComplete = true;
+	for (;;)
+	{
+		if (bCancelled && *bCancelled)
+		{
+			bComplete = false;
+			break;
+		}
+
+		const ma_uint64 framesRead = ma_decoder_read_pcm_frames(&decoder, chunk.data(), ANALYSIS_CHUNK_FRAMES);
+		builder.Add(chunk.data(), (size_t)framesRead);
+		if (fingerprintBuilder) fingerprintBuilder->Add(chunk.data(), (size_t)framesRead);
+		if (framesRead < ANALYSIS_CHUNK_FRAMES)
+		{
+			break;
+		}
+	}
+	ma_decoder_uninit(&decoder);
+
+	if (bComplete)
+	{
+		builder.Finish(sampleRate, outWaveform);
+		if (fingerprintBuilder) fingerprintBuilder->Finish(*outFingerprint);
+	}
+	return bComplete;
+}
+
+const int8_t* GetWaveformLevel(const db::Waveform& waveform, int minBuckets, int& outBuckets)
+{
+	outBuckets = 0;
+	if (waveform.levels == 0)
+	{
+		return nullptr;
+	}
+
+	const int8_t* level = waveform.peaks.data();
+	int buckets = waveform.baseBuckets;
+	for (int i = 1; i < waveform.levels; i++)
+	{
+		const int nextBuckets = std::max(1, buckets / 2);
+		if (nextBuckets < minBuckets)
+		{
+			break;
+		}
+		level += 2 * buckets;
+		buckets = nextBuckets;
+	}
+
+	outBuckets = buckets;
+	return level;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+// pairs in the finest level of a stored waveform, enough for a full width pane
+static const int WAVEFORM_BUCKETS = 2048;
+// what silence is stored as instead of -inf
+static const float SILENCE_DB = -120.0f;
+
+// folds interleaved float samples into a running min, max and sum of squares.
+// sse2 where available, scalar elsewhere
+void ReduceSamples(const float* samples, size_t count, float& inOutMin, float& inOutMax, double& inOutSumSquares);
+void ReduceSamplesScalar(const float* samples, size_t count, float& inOutMin, float& inOutMax, double& inOutSumSquares);
+
+const char* GetReduceKernelName();
+
+// streams decoded frames into a db::Waveform without knowing the length up front.
+// frames are folded into blocks, when there are twice as many blocks as buckets neighbours
+// are merged and the block size doubles, so memory stays constant for any length
+class WaveformBuilder
+{
+public:
+	explicit WaveformBuilder(uint32_t channels);
+
+	void Add(const float* frames, size_t frameCount);
+
+	void Finish(uint32_t sampleRate, db::Waveform& outWaveform);
+
+private:
+	void PushBlock();
+
+	uint32_t channels;
+	uint64_t framesPerBlock = 1;
+	uint64_t framesInBlock = 0;
+	uint64_t totalFrames = 0;
+
+	float blockMin = 0.0f;
+	float blockMax = 0.0f;
+	std::vector<float> blockMins;
+	std::vector<float> blockMaxs;
+
+	float totalMin = 0.0f;
+	float totalMax = 0.0f;
+	double sumSquares = 0.0;
+};
+
+// decodes the whole file at its native rate and channel count. false if it couldn't be decoded
+// or bCancelled was set meanwhile. the fingerprint is built in the same pass if asked for,
+// it stays empty for silent files
+bool AnalyzeAudioFile(const std::string& path, const std::atomic<bool>* bCancelled, db::Waveform& outWaveform,
+	std::vector<float>* outFingerprint = nullptr);
+
+// coarsest level that still has at least minBuckets min/max pairs, the finest one if none has.
+// null for a waveform without levels
+const int8_t* GetWaveformLevel(const db::Waveform& waveform, int minBuckets, int& outBuckets);